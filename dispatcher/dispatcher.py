@@ -17,27 +17,209 @@ SPDX-License-Identifier: Apache-2.0
 
 import logging
 import selectors
+import signal
 import socket
+import struct
 import sys
+import time
+from collections import deque
+from itertools import islice
 from threading import Lock
-from typing import Set
+from typing import Deque, Dict, List, Optional, Tuple
 
 logging.basicConfig(format="%(levelname)s| %(filename)s:%(lineno)s %(message)s")
 logger = logging.getLogger("File:Line# Debugger")
 logger.setLevel(logging.DEBUG)
 DISPATCHER_ADDR = ("127.0.0.1", 44444)
-BYTES_MSG_LENGTH: int = 32767
+# Every frame starts with the length of the serialized UMessage, the id of the sending uEntity and a routing header:
+# message type, priority, ttl and the lengths and micro-URI forms of source and sink.
+# Frames are routed on these bytes, the UMessage itself is never parsed.
+FRAME_HEADER = struct.Struct(">IIBBBBI24s24s")
+FRAME_LENGTH = struct.Struct(">I")
+# Control frames carry no UMessage, they add or remove the sink of the header as a route to the sending connection
+CONTROL_LISTEN: int = 0x80
+CONTROL_UNLISTEN: int = 0x81
+UMESSAGE_TYPE_PUBLISH: int = 1
+# Receive buffers are carved out of slabs of this size; larger frames get a dedicated slab
+SLAB_SIZE: int = 256 * 1024
+# Upper bound on the free slabs kept for reuse
+MAX_POOLED_SLABS: int = 64
+# Upper bound on the buffers gathered into one sendmsg call
+IOV_MAX: int = 1024
+# Sends of at least this many bytes use MSG_ZEROCOPY where the kernel supports it
+ZEROCOPY_THRESHOLD: int = 64 * 1024
+# Linux values, not all of them are exported by the socket module
+SO_ZEROCOPY: int = getattr(socket, "SO_ZEROCOPY", 60)
+MSG_ZEROCOPY: int = getattr(socket, "MSG_ZEROCOPY", 0x4000000)
+MSG_ERRQUEUE: int = getattr(socket, "MSG_ERRQUEUE", 0x2000)
+SO_EE_ORIGIN_ZEROCOPY: int = 5
+SO_EE_CODE_ZEROCOPY_COPIED: int = 1
+# struct sock_extended_err: errno, origin, type, code, pad, info, data
+SOCK_EXTENDED_ERR = struct.Struct("=IBBBBII")
+
+
+class DispatcherMetrics:
+    """
+    Counts the user-space cost of forwarding messages, so the per-message cost can be checked
+    to stay constant as fan-out grows.
+    """
+
+    def __init__(self):
+        self.messages: int = 0
+        # Messages without a route, which are flooded to every connection
+        self.messages_flooded: int = 0
+        self.bytes_received: int = 0
+        # Bytes moved between user-space buffers, i.e. partial frames carried over to a new slab
+        self.bytes_copied: int = 0
+        self.allocations: int = 0
+        self.zerocopy_sends: int = 0
+        # Zero-copy sends the kernel completed by copying after all, e.g. over loopback
+        self.zerocopy_copied: int = 0
+        self.cpu_seconds: float = 0.0
+
+    def snapshot(self) -> dict:
+        messages: int = max(self.messages, 1)
+        return {
+            "messages": self.messages,
+            "messages_flooded": self.messages_flooded,
+            "bytes_received": self.bytes_received,
+            "bytes_copied": self.bytes_copied,
+            "allocations": self.allocations,
+            "zerocopy_sends": self.zerocopy_sends,
+            "zerocopy_copied": self.zerocopy_copied,
+            "cpu_seconds": self.cpu_seconds,
+            "bytes_copied_per_message": self.bytes_copied / messages,
+            "allocations_per_message": self.allocations / messages,
+        }
+
+
+class Slab:
+    """
+    A receive buffer whose frames are forwarded by reference.
+    The slab is returned to its pool once the reading connection and every queued send release it.
+    """
+
+    __slots__ = ("buffer", "view", "refcount")
+
+    def __init__(self, size: int):
+        self.buffer = bytearray(size)
+        self.view = memoryview(self.buffer)
+        self.refcount: int = 0
+
+
+class SlabPool:
+    """
+    Recycles slabs of the Dispatcher thread; only that thread acquires and releases them.
+    """
+
+    def __init__(self, metrics: DispatcherMetrics):
+        self.metrics = metrics
+        self.free_slabs: List[Slab] = []
+
+    def acquire(self, size: int = SLAB_SIZE) -> Slab:
+        if size <= SLAB_SIZE and self.free_slabs:
+            slab = self.free_slabs.pop()
+        else:
+            slab = Slab(max(size, SLAB_SIZE))
+            self.metrics.allocations += 1
+        slab.refcount = 1
+        return slab
+
+    def release(self, slab: Slab):
+        slab.refcount -= 1
+        if slab.refcount == 0 and len(slab.buffer) == SLAB_SIZE and len(self.free_slabs) < MAX_POOLED_SLABS:
+            self.free_slabs.append(slab)
+
+
+class UpClientConnection:
+    """
+    Read and write state of one up-client socket.
+    Bytes [start, end) of the read slab are received but not yet forwarded.
+    Slabs handed to the kernel with MSG_ZEROCOPY stay referenced until the kernel reports
+    the completion of the send call's sequence number.
+    """
+
+    __slots__ = (
+        "socket",
+        "slab",
+        "start",
+        "end",
+        "write_queue",
+        "closed",
+        "zerocopy",
+        "zerocopy_seq",
+        "zerocopy_pending",
+    )
+
+    def __init__(self, up_client_socket: socket.socket, slab: Slab):
+        self.socket = up_client_socket
+        self.slab = slab
+        self.start: int = 0
+        self.end: int = 0
+        self.write_queue: Deque[Tuple[Slab, memoryview]] = deque()
+        self.closed: bool = False
+        self.zerocopy: bool = False
+        self.zerocopy_seq: int = 0
+        self.zerocopy_pending: Deque[Tuple[int, List[Slab]]] = deque()
+
+
+class RouteTable:
+    """
+    Maps the micro-URI form of the UUris that up-clients listen on to their connections.
+    A connection listening on a UUri without micro-URI form receives every frame, as it cannot be routed to.
+    """
+
+    def __init__(self):
+        # micro-URI -> {connection: number of listeners}
+        self.routes: Dict[bytes, Dict[UpClientConnection, int]] = {}
+        self.catch_all: Dict[UpClientConnection, int] = {}
+
+    def add(self, connection: UpClientConnection, uri: bytes):
+        listeners = self.routes.setdefault(uri, {}) if uri else self.catch_all
+        listeners[connection] = listeners.get(connection, 0) + 1
+
+    def remove(self, connection: UpClientConnection, uri: bytes):
+        listeners = self.routes.get(uri, {}) if uri else self.catch_all
+        count: int = listeners.get(connection, 0)
+        if count > 1:
+            listeners[connection] = count - 1
+            return
+        listeners.pop(connection, None)
+        if uri and not listeners:
+            self.routes.pop(uri, None)
+
+    def remove_connection(self, connection: UpClientConnection):
+        self.catch_all.pop(connection, None)
+        for uri, listeners in list(self.routes.items()):
+            listeners.pop(connection, None)
+            if not listeners:
+                del self.routes[uri]
+
+    def lookup(self, uri: bytes) -> Optional[List[UpClientConnection]]:
+        """
+        Returns the connections to send a frame for the given micro-URI to,
+        or None if no connection listens on it and the frame has to be flooded.
+        """
+        listeners = self.routes.get(uri) if uri else None
+        if not listeners:
+            return None
+        if not self.catch_all:
+            return list(listeners)
+        return list(listeners.keys() | self.catch_all.keys())
 
 
 class Dispatcher:
     """
     Dispatcher class handles incoming connections and forwards messages
-    to all connected up-clients.
+    to the up-clients listening on their topic or sink, or to all connected up-clients if nobody does.
     """
 
     def __init__(self):
         self.selector = selectors.DefaultSelector()
-        self.connected_sockets: Set[socket.socket] = set()
+        self.connections: Dict[socket.socket, UpClientConnection] = {}
+        self.metrics = DispatcherMetrics()
+        self.slab_pool = SlabPool(self.metrics)
+        self.route_table = RouteTable()
         self.lock = Lock()
         self.server = None
 
@@ -57,7 +239,7 @@ class Dispatcher:
         # Cleanup essentials
         self.dispatcher_exit = False
 
-    def _accept_client_conn(self, server: socket.socket):
+    def _accept_client_conn(self, server: socket.socket, _mask: int):
         """
         Callback function for accepting up-client connections.
 
@@ -65,78 +247,301 @@ class Dispatcher:
         """
 
         up_client_socket, _ = server.accept()
+        up_client_socket.setblocking(False)
         logger.info(f"accepted conn. {up_client_socket.getpeername()}")
 
+        connection = UpClientConnection(up_client_socket, self.slab_pool.acquire())
+        if sys.platform == "linux":
+            try:
+                up_client_socket.setsockopt(socket.SOL_SOCKET, SO_ZEROCOPY, 1)
+                connection.zerocopy = True
+            except OSError:
+                logger.info("MSG_ZEROCOPY not supported, large frames are copied into the socket")
+
         with self.lock:
-            self.connected_sockets.add(up_client_socket)
+            self.connections[up_client_socket] = connection
 
         # Register socket for receiving data
         self.selector.register(
             up_client_socket,
             selectors.EVENT_READ,
-            self._receive_from_up_client,
+            self._service_up_client,
         )
 
-    def _receive_from_up_client(self, up_client_socket: socket.socket):
+    def _service_up_client(self, up_client_socket: socket.socket, mask: int):
         """
-        Callback function for receiving data from up-client sockets.
+        Callback function for up-client sockets that are readable or have queued frames and became writable.
 
         :param up_client_socket: The client socket.
+        :param mask: The selector events that are ready.
         """
-        try:
-            recv_data: bytes = up_client_socket.recv(BYTES_MSG_LENGTH)
+        connection = self.connections.get(up_client_socket)
+        if connection is None:
+            return
+        if connection.zerocopy_pending:
+            self._reap_zerocopy_completions(connection)
+        if mask & selectors.EVENT_WRITE:
+            self._flush_write_queue(connection)
+        if mask & selectors.EVENT_READ and not connection.closed:
+            self._receive_from_up_client(connection)
 
-            if recv_data == b"":
-                self._close_connected_socket(up_client_socket)
-                return
+    def _receive_from_up_client(self, connection: UpClientConnection):
+        """
+        Receives data from an up-client directly into its slab and forwards every complete frame.
 
-            logger.info(f"received data: {recv_data}")
-            self._flood_to_sockets(recv_data)
+        :param connection: The up-client connection.
+        """
+        try:
+            self._reserve_read_space(connection)
+            received: int = connection.socket.recv_into(connection.slab.view[connection.end :])
+        except BlockingIOError:
+            return
         except Exception:
             logger.error("Received error while reading data from up-client")
-            self._close_connected_socket(up_client_socket)
+            self._close_connection(connection)
+            return
+
+        if received == 0:
+            self._close_connection(connection)
+            return
+
+        logger.debug(f"received {received} bytes")
+        connection.end += received
+        self.metrics.bytes_received += received
+        self._forward_complete_frames(connection)
+
+    def _reserve_read_space(self, connection: UpClientConnection):
+        """
+        Makes sure the next read fits into the connection's slab.
+        A partial frame is carried over to a new slab, sized for the whole frame if it is larger than a slab.
+
+        :param connection: The up-client connection.
+        """
+        slab: Slab = connection.slab
+        pending: int = connection.end - connection.start
+        if pending == 0 and slab.refcount == 1:
+            # No queued send references this slab, so it can be refilled from the start
+            connection.start = connection.end = 0
+            return
+
+        frame_length: int = 0
+        if pending >= FRAME_HEADER.size:
+            (umsg_length,) = FRAME_LENGTH.unpack_from(slab.buffer, connection.start)
+            frame_length = FRAME_HEADER.size + umsg_length
+        if connection.end < len(slab.buffer) and connection.start + frame_length <= len(slab.buffer):
+            return
+
+        new_slab: Slab = self.slab_pool.acquire(frame_length)
+        new_slab.view[:pending] = slab.view[connection.start : connection.end]
+        self.metrics.bytes_copied += pending
+        self.slab_pool.release(slab)
+        connection.slab = new_slab
+        connection.start, connection.end = 0, pending
+
+    def _forward_complete_frames(self, connection: UpClientConnection):
+        """
+        Queues a reference to every complete frame received so far on the up-clients it is routed to,
+        and applies the control frames of the connection to the route table.
+
+        :param connection: The up-client connection the frames were received from.
+        """
+        slab: Slab = connection.slab
+        # A failed send may close this connection and release its slab, so hold the slab until the loop is done
+        slab.refcount += 1
+        try:
+            while not connection.closed and connection.end - connection.start >= FRAME_HEADER.size:
+                umsg_length, _, message_type, _, source_length, sink_length, _, source, sink = FRAME_HEADER.unpack_from(
+                    slab.buffer, connection.start
+                )
+                frame_end: int = connection.start + FRAME_HEADER.size + umsg_length
+                if frame_end > connection.end:
+                    return
+                frame: memoryview = slab.view[connection.start : frame_end]
+                connection.start = frame_end
+
+                if message_type == CONTROL_LISTEN:
+                    self.route_table.add(connection, sink[:sink_length])
+                    continue
+                if message_type == CONTROL_UNLISTEN:
+                    self.route_table.remove(connection, sink[:sink_length])
+                    continue
+
+                self.metrics.messages += 1
+                # Publish messages are routed on their topic, requests and responses on their sink
+                route: bytes = source[:source_length] if message_type == UMESSAGE_TYPE_PUBLISH else sink[:sink_length]
+                receivers: Optional[List[UpClientConnection]] = self.route_table.lookup(route)
+                if receivers is None:
+                    self.metrics.messages_flooded += 1
+                    receivers = list(self.connections.values())
+                self._send_to_connections(receivers, slab, frame)
+        finally:
+            self.slab_pool.release(slab)
 
-    def _flood_to_sockets(self, data: bytes):
+    def _send_to_connections(self, receivers: List[UpClientConnection], slab: Slab, frame: memoryview):
         """
-        Flood data from a sender socket to all other connected sockets.
+        Queues a frame from a sender socket on the given connections without copying it.
 
-        :param data: The data to be sent.
+        :param receivers: The connections to send the frame to.
+        :param slab: The slab holding the frame.
+        :param frame: The frame to be sent.
         """
-        # for up_client_socket in self.connected_sockets.copy():  # copy() to avoid RuntimeError
-        for up_client_socket in self.connected_sockets:
+        for connection in receivers:
+            if connection.closed:
+                continue
+            slab.refcount += 1
+            connection.write_queue.append((slab, frame))
+            if len(connection.write_queue) == 1:
+                self._flush_write_queue(connection)
+
+    def _flush_write_queue(self, connection: UpClientConnection):
+        """
+        Sends as much of the queued frames as the socket accepts, gathering several frames per call.
+        Waits for the socket to become writable if frames remain.
+
+        :param connection: The up-client connection.
+        """
+        write_queue = connection.write_queue
+        while write_queue:
+            frames: List[memoryview] = [frame for _, frame in islice(write_queue, IOV_MAX)]
+            zerocopy: bool = connection.zerocopy and sum(len(frame) for frame in frames) >= ZEROCOPY_THRESHOLD
             try:
-                up_client_socket.sendall(data)
-            except ConnectionAbortedError as e:
-                logger.error(f"Error sending data to {up_client_socket.getpeername()}: {e}")
-                self._close_connected_socket(up_client_socket)
+                if zerocopy:
+                    sent: int = connection.socket.sendmsg(frames, [], MSG_ZEROCOPY)
+                elif hasattr(connection.socket, "sendmsg"):
+                    sent = connection.socket.sendmsg(frames)
+                else:
+                    sent = connection.socket.send(frames[0])
+            except BlockingIOError:
+                break
+            except OSError as e:
+                # A reset peer has no peer name anymore, so it is not logged
+                logger.error(f"Error sending data to up-client: {e}")
+                self._close_connection(connection)
+                return
+
+            if zerocopy:
+                self._hold_zerocopy_slabs(connection, sent)
+
+            while sent > 0:
+                slab, frame = write_queue[0]
+                if sent < len(frame):
+                    write_queue[0] = (slab, frame[sent:])
+                    break
+                sent -= len(frame)
+                write_queue.popleft()
+                self.slab_pool.release(slab)
+            else:
+                continue
+            # The socket took only part of the frames
+            break
+
+        events: int = selectors.EVENT_READ | (selectors.EVENT_WRITE if write_queue else 0)
+        key = self.selector.get_key(connection.socket)
+        if key.events != events:
+            self.selector.modify(connection.socket, events, self._service_up_client)
+
+    def _hold_zerocopy_slabs(self, connection: UpClientConnection, sent: int):
+        """
+        Keeps the slabs of the frames passed to a MSG_ZEROCOPY send referenced until the kernel completes it.
+
+        :param connection: The up-client connection.
+        :param sent: The number of bytes the send call accepted.
+        """
+        slabs: List[Slab] = []
+        for slab, frame in connection.write_queue:
+            if sent <= 0:
+                break
+            slab.refcount += 1
+            slabs.append(slab)
+            sent -= len(frame)
+        connection.zerocopy_pending.append((connection.zerocopy_seq, slabs))
+        connection.zerocopy_seq = (connection.zerocopy_seq + 1) & 0xFFFFFFFF
+        self.metrics.zerocopy_sends += 1
+
+    def _reap_zerocopy_completions(self, connection: UpClientConnection):
+        """
+        Reads the MSG_ZEROCOPY completion notifications from the socket error queue
+        and releases the slabs of every completed send.
+
+        :param connection: The up-client connection.
+        """
+        while connection.zerocopy_pending:
+            try:
+                _, ancdata, _, _ = connection.socket.recvmsg(0, socket.CMSG_SPACE(SOCK_EXTENDED_ERR.size), MSG_ERRQUEUE)
+            except (BlockingIOError, InterruptedError):
+                return
+            except OSError as e:
+                logger.error(f"Error reading zero-copy completions: {e}")
+                return
+            for _, _, cmsg_data in ancdata:
+                if len(cmsg_data) < SOCK_EXTENDED_ERR.size:
+                    continue
+                _, origin, _, code, _, first_seq, last_seq = SOCK_EXTENDED_ERR.unpack_from(cmsg_data)
+                if origin != SO_EE_ORIGIN_ZEROCOPY:
+                    continue
+                if code & SO_EE_CODE_ZEROCOPY_COPIED:
+                    self.metrics.zerocopy_copied += ((last_seq - first_seq) & 0xFFFFFFFF) + 1
+                # Completions arrive in order, so the completed sends are at the front
+                while connection.zerocopy_pending:
+                    seq, slabs = connection.zerocopy_pending[0]
+                    if (seq - first_seq) & 0xFFFFFFFF > (last_seq - first_seq) & 0xFFFFFFFF:
+                        break
+                    connection.zerocopy_pending.popleft()
+                    for slab in slabs:
+                        self.slab_pool.release(slab)
 
     def listen_for_client_connections(self):
         """
         Start listening for client connections and handle events.
         """
+        start_cpu_seconds: float = time.thread_time()
         while not self.dispatcher_exit:
-            events = self.selector.select(timeout=0)
-            for key, _ in events:
+            try:
+                # Block instead of spinning, but wake up regularly to notice close()
+                events = self.selector.select(timeout=0.1)
+            except (OSError, ValueError):
+                if self.dispatcher_exit:
+                    break
+                raise
+            for key, mask in events:
                 callback = key.data
-                callback(key.fileobj)
+                callback(key.fileobj, mask)
+            self.metrics.cpu_seconds = time.thread_time() - start_cpu_seconds
 
-    def _close_connected_socket(self, up_client_socket: socket.socket):
+    def _close_connection(self, connection: UpClientConnection):
         """
-        Close a client socket and unregister it from the selector.
+        Close a client socket, unregister it from the selector and release its slabs.
 
-        :param up_client_socket: The client socket to be closed.
+        :param connection: The up-client connection to be closed.
         """
-        logger.info(f"closing socket {up_client_socket.getpeername()}")
+        if connection.closed:
+            return
+        connection.closed = True
+        up_client_socket = connection.socket
+        try:
+            logger.info(f"closing socket {up_client_socket.getpeername()}")
+        except OSError:
+            logger.info("closing disconnected socket")
         with self.lock:
-            self.connected_sockets.remove(up_client_socket)
+            self.connections.pop(up_client_socket, None)
+        self.route_table.remove_connection(connection)
+
+        for slab, _ in connection.write_queue:
+            self.slab_pool.release(slab)
+        connection.write_queue.clear()
+        for _, slabs in connection.zerocopy_pending:
+            for slab in slabs:
+                self.slab_pool.release(slab)
+        connection.zerocopy_pending.clear()
+        self.slab_pool.release(connection.slab)
 
         self.selector.unregister(up_client_socket)
         up_client_socket.close()
 
     def close(self):
         self.dispatcher_exit = True
-        for utransport_socket in self.connected_sockets.copy():
-            self._close_connected_socket(utransport_socket)
+        for connection in list(self.connections.values()):
+            self._close_connection(connection)
         # Close server socket
         try:
             self.selector.unregister(self.server)
@@ -147,4 +552,19 @@ class Dispatcher:
 
         # Close selector
         self.selector.close()
+        logger.info(f"Dispatcher metrics: {self.metrics.snapshot()}")
         logger.info("Dispatcher closed!")
+
+
+if __name__ == "__main__":
+    # Run as a process of its own, e.g. pinned with taskset, instead of a thread sharing the Test Manager's GIL
+    dispatcher = Dispatcher()
+
+    def stop(signum, frame):
+        dispatcher.dispatcher_exit = True
+
+    # Leaves the event loop within its select timeout, so the metrics are logged on close
+    signal.signal(signal.SIGTERM, stop)
+    signal.signal(signal.SIGINT, stop)
+    dispatcher.listen_for_client_connections()
+    dispatcher.close()
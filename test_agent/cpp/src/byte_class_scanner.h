@@ -0,0 +1,117 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if !defined(TCK_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TCK_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace uprotocol::tck {
+
+inline unsigned count_trailing_zeros(uint32_t mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+/**
+ * Finds the bytes of a small class, e.g. '.' and '#', in the order they occur in a text.
+ * With SSE2 every step compares 16 bytes against all bytes of the class at once and keeps the matches as a bit mask,
+ * elsewhere, and for the last bytes of the text, it compares one byte at a time. It never reads past the text and
+ * never allocates.
+ */
+template <size_t N>
+class ByteClassScanner {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+    static constexpr size_t BLOCK_SIZE = 16;
+
+    ByteClassScanner(std::string_view text, const char (&byte_class)[N]) noexcept : text_(text) {
+        for (size_t i = 0; i < N; ++i) {
+            byte_class_[i] = byte_class[i];
+        }
+    }
+
+    /**
+     * Returns the position of the next byte of the class, or npos after the last one.
+     */
+    size_t next() noexcept {
+        while (mask_ == 0) {
+            if (next_block_ >= text_.size()) {
+                return npos;
+            }
+            block_ = next_block_;
+            mask_ = block_mask(block_);
+            next_block_ += BLOCK_SIZE;
+        }
+        size_t position = block_ + count_trailing_zeros(mask_);
+        // Clears the lowest match
+        mask_ &= mask_ - 1;
+        return position;
+    }
+
+private:
+    uint32_t block_mask(size_t offset) const noexcept {
+        const char* bytes = text_.data() + offset;
+#ifdef TCK_SSE2
+        if (text_.size() - offset >= BLOCK_SIZE) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+            __m128i matches = _mm_cmpeq_epi8(block, _mm_set1_epi8(byte_class_[0]));
+            for (size_t i = 1; i < N; ++i) {
+                matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, _mm_set1_epi8(byte_class_[i])));
+            }
+            return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+        }
+#endif
+        size_t length = text_.size() - offset < BLOCK_SIZE ? text_.size() - offset : BLOCK_SIZE;
+        uint32_t mask = 0;
+        for (size_t position = 0; position < length; ++position) {
+            for (size_t i = 0; i < N; ++i) {
+                if (bytes[position] == byte_class_[i]) {
+                    mask |= 1u << position;
+                }
+            }
+        }
+        return mask;
+    }
+
+    std::string_view text_;
+    char byte_class_[N] = {};
+    size_t block_ = 0;
+    size_t next_block_ = 0;
+    uint32_t mask_ = 0;
+};
+
+}  // namespace uprotocol::tck
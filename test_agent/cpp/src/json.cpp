@@ -0,0 +1,422 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "json.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace uprotocol::tck {
+
+namespace {
+
+// Thrown when the stream ends inside a value, which is completed by a later read
+struct Incomplete {};
+
+bool is_whitespace(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void append_utf8(std::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+}  // namespace
+
+class JsonParser {
+public:
+    JsonParser(std::string_view text, size_t position) : text_(text), position_(position) {}
+
+    Json parse_value() {
+        skip_whitespace();
+        Json value;
+        switch (peek()) {
+            case '{':
+                parse_object(value);
+                break;
+            case '[':
+                parse_array(value);
+                break;
+            case '"':
+                value.type_ = Json::Type::String;
+                value.text_ = parse_string();
+                break;
+            case 't':
+                expect_literal("true");
+                value.type_ = Json::Type::Bool;
+                value.boolean_ = true;
+                break;
+            case 'f':
+                expect_literal("false");
+                value.type_ = Json::Type::Bool;
+                break;
+            case 'n':
+                expect_literal("null");
+                break;
+            default:
+                parse_number(value);
+        }
+        return value;
+    }
+
+    size_t position() const noexcept { return position_; }
+
+private:
+    char peek() {
+        if (position_ >= text_.size()) {
+            throw Incomplete();
+        }
+        return text_[position_];
+    }
+
+    char take() {
+        char c = peek();
+        ++position_;
+        return c;
+    }
+
+    void expect(char expected) {
+        if (take() != expected) {
+            throw JsonError(std::string("Expected '") + expected + "' at " + std::to_string(position_ - 1));
+        }
+    }
+
+    void skip_whitespace() {
+        while (position_ < text_.size() && is_whitespace(text_[position_])) {
+            ++position_;
+        }
+    }
+
+    void expect_literal(std::string_view literal) {
+        for (char c : literal) {
+            expect(c);
+        }
+    }
+
+    void parse_object(Json& value) {
+        value.type_ = Json::Type::Object;
+        expect('{');
+        skip_whitespace();
+        if (peek() == '}') {
+            ++position_;
+            return;
+        }
+        while (true) {
+            skip_whitespace();
+            std::string key = parse_string();
+            skip_whitespace();
+            expect(':');
+            value.members_.emplace_back(std::move(key), parse_value());
+            skip_whitespace();
+            if (take() == '}') {
+                return;
+            }
+            if (text_[position_ - 1] != ',') {
+                throw JsonError("Expected ',' or '}' at " + std::to_string(position_ - 1));
+            }
+        }
+    }
+
+    void parse_array(Json& value) {
+        value.type_ = Json::Type::Array;
+        expect('[');
+        skip_whitespace();
+        if (peek() == ']') {
+            ++position_;
+            return;
+        }
+        while (true) {
+            value.items_.push_back(parse_value());
+            skip_whitespace();
+            if (take() == ']') {
+                return;
+            }
+            if (text_[position_ - 1] != ',') {
+                throw JsonError("Expected ',' or ']' at " + std::to_string(position_ - 1));
+            }
+        }
+    }
+
+    uint32_t parse_hex4() {
+        uint32_t code_unit = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = take();
+            code_unit <<= 4;
+            if (c >= '0' && c <= '9') {
+                code_unit |= static_cast<uint32_t>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code_unit |= static_cast<uint32_t>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code_unit |= static_cast<uint32_t>(c - 'A' + 10);
+            } else {
+                throw JsonError("Invalid \\u escape at " + std::to_string(position_ - 1));
+            }
+        }
+        return code_unit;
+    }
+
+    std::string parse_string() {
+        expect('"');
+        std::string text;
+        while (true) {
+            char c = take();
+            if (c == '"') {
+                return text;
+            }
+            if (c != '\\') {
+                text += c;
+                continue;
+            }
+            switch (take()) {
+                case '"':
+                    text += '"';
+                    break;
+                case '\\':
+                    text += '\\';
+                    break;
+                case '/':
+                    text += '/';
+                    break;
+                case 'b':
+                    text += '\b';
+                    break;
+                case 'f':
+                    text += '\f';
+                    break;
+                case 'n':
+                    text += '\n';
+                    break;
+                case 'r':
+                    text += '\r';
+                    break;
+                case 't':
+                    text += '\t';
+                    break;
+                case 'u': {
+                    uint32_t code_point = parse_hex4();
+                    // Characters beyond the basic multilingual plane are escaped as a surrogate pair
+                    if (code_point >= 0xD800 && code_point < 0xDC00) {
+                        expect('\\');
+                        expect('u');
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (parse_hex4() - 0xDC00);
+                    }
+                    append_utf8(text, code_point);
+                    break;
+                }
+                default:
+                    throw JsonError("Invalid escape at " + std::to_string(position_ - 1));
+            }
+        }
+    }
+
+    void parse_number(Json& value) {
+        size_t start = position_;
+        while (true) {
+            char c = peek();
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                ++position_;
+            } else {
+                break;
+            }
+        }
+        if (position_ == start) {
+            throw JsonError("Unexpected '" + std::string(1, text_[start]) + "' at " + std::to_string(start));
+        }
+        value.type_ = Json::Type::Number;
+        value.text_ = std::string(text_.substr(start, position_ - start));
+    }
+
+    std::string_view text_;
+    size_t position_;
+};
+
+Json Json::string(std::string text) {
+    Json value;
+    value.type_ = Type::String;
+    value.text_ = std::move(text);
+    return value;
+}
+
+const Json* Json::find(std::string_view key) const noexcept {
+    for (const auto& [name, value] : members_) {
+        if (name == key) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+std::string_view Json::text_of(std::string_view key, std::string_view fallback) const noexcept {
+    const Json* value = find(key);
+    return value != nullptr && (value->type_ == Type::String || value->type_ == Type::Number) ? value->text_
+                                                                                               : fallback;
+}
+
+int64_t Json::integer_of(std::string_view key, int64_t fallback) const {
+    std::string_view text = text_of(key);
+    if (text.empty()) {
+        return fallback;
+    }
+    int64_t integer = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), integer);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw JsonError("\"" + std::string(key) + "\" is not an integer: " + std::string(text));
+    }
+    return integer;
+}
+
+bool JsonStreamDecoder::next(Json& value) {
+    while (position_ < buffer_.size() && is_whitespace(buffer_[position_])) {
+        ++position_;
+    }
+    if (position_ == buffer_.size()) {
+        buffer_.clear();
+        position_ = 0;
+        return false;
+    }
+    JsonParser parser(buffer_, position_);
+    try {
+        value = parser.parse_value();
+    } catch (const Incomplete&) {
+        // Keeps only the start of the incomplete value for the next read
+        buffer_.erase(0, position_);
+        position_ = 0;
+        return false;
+    }
+    position_ = parser.position();
+    return true;
+}
+
+void JsonWriter::separate() {
+    if (needs_comma_) {
+        out_ += ',';
+    }
+}
+
+JsonWriter& JsonWriter::begin_object() {
+    separate();
+    out_ += '{';
+    needs_comma_ = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_object() {
+    out_ += '}';
+    needs_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::begin_array() {
+    separate();
+    out_ += '[';
+    needs_comma_ = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_array() {
+    out_ += ']';
+    needs_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    string(name);
+    out_ += ':';
+    needs_comma_ = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::string(std::string_view text) {
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    separate();
+    out_ += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                out_ += "\\\"";
+                break;
+            case '\\':
+                out_ += "\\\\";
+                break;
+            case '\n':
+                out_ += "\\n";
+                break;
+            case '\r':
+                out_ += "\\r";
+                break;
+            case '\t':
+                out_ += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out_ += "\\u00";
+                    out_ += HEX_DIGITS[(c >> 4) & 0xF];
+                    out_ += HEX_DIGITS[c & 0xF];
+                } else {
+                    out_ += c;
+                }
+        }
+    }
+    out_ += '"';
+    needs_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::integer(int64_t value) {
+    separate();
+    char digits[24];
+    out_.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+    needs_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    separate();
+    char digits[32];
+    // JSON has no infinity or NaN
+    double finite = std::isfinite(value) ? value : 0.0;
+    out_.append(digits, std::to_chars(digits, digits + sizeof(digits), finite).ptr);
+    needs_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+    separate();
+    out_ += json;
+    needs_comma_ = true;
+    return *this;
+}
+
+}  // namespace uprotocol::tck
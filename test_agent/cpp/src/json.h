@@ -0,0 +1,136 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace uprotocol::tck {
+
+class JsonError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * A JSON value as the Test Manager sends it. Numbers keep their text, since the Test Manager sends most numbers as
+ * strings anyway and the handlers convert them as they need.
+ */
+class Json {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Json() = default;
+
+    static Json string(std::string text);
+
+    Type type() const noexcept { return type_; }
+    bool is_string() const noexcept { return type_ == Type::String; }
+    bool is_object() const noexcept { return type_ == Type::Object; }
+    bool is_array() const noexcept { return type_ == Type::Array; }
+
+    /**
+     * The text of a string or number, "" for other values.
+     */
+    const std::string& text() const noexcept { return text_; }
+    const std::vector<Json>& items() const noexcept { return items_; }
+    const std::vector<std::pair<std::string, Json>>& members() const noexcept { return members_; }
+
+    /**
+     * Returns the member of an object, or nullptr if there is none.
+     */
+    const Json* find(std::string_view key) const noexcept;
+
+    /**
+     * Returns the text of a member of an object, or fallback if it has none.
+     */
+    std::string_view text_of(std::string_view key, std::string_view fallback = "") const noexcept;
+
+    /**
+     * Returns a string or number member of an object as an integer, or fallback if it has none.
+     *
+     * @throws JsonError If the member is not an integer.
+     */
+    int64_t integer_of(std::string_view key, int64_t fallback = 0) const;
+
+private:
+    friend class JsonParser;
+
+    Type type_ = Type::Null;
+    bool boolean_ = false;
+    std::string text_;
+    std::vector<Json> items_;
+    std::vector<std::pair<std::string, Json>> members_;
+};
+
+/**
+ * Splits the byte stream of the Test Manager into JSON values. The Test Manager sends its commands back to back
+ * without delimiters, so a read may hold several commands or only part of one.
+ */
+class JsonStreamDecoder {
+public:
+    void feed(std::string_view bytes) { buffer_.append(bytes); }
+
+    /**
+     * Takes the next complete value from the stream.
+     *
+     * @return False if the stream holds no complete value yet.
+     * @throws JsonError If the stream is not JSON.
+     */
+    bool next(Json& value);
+
+private:
+    std::string buffer_;
+    size_t position_ = 0;
+};
+
+/**
+ * Appends JSON to a string. Callers open and close objects and arrays themselves, the writer adds the commas.
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    JsonWriter& begin_object();
+    JsonWriter& end_object();
+    JsonWriter& begin_array();
+    JsonWriter& end_array();
+    JsonWriter& key(std::string_view name);
+    JsonWriter& string(std::string_view text);
+    JsonWriter& integer(int64_t value);
+    JsonWriter& number(double value);
+    // Appends a value written by another writer
+    JsonWriter& raw(std::string_view json);
+
+private:
+    void separate();
+
+    std::string& out_;
+    // Whether the next value of the innermost object or array follows another one
+    bool needs_comma_ = false;
+};
+
+}  // namespace uprotocol::tck
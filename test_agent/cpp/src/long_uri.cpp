@@ -0,0 +1,207 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "long_uri.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include "byte_class_scanner.h"
+
+namespace uprotocol::tck {
+
+namespace {
+
+// The SDKs read at most six parts: "", "", authority, entity, version and resource
+constexpr size_t MAX_PARTS = 6;
+constexpr size_t MAX_VERSION_DIGITS = 10;
+
+bool is_space(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+std::string_view strip(std::string_view text) noexcept {
+    while (!text.empty() && is_space(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && is_space(text.back())) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool parse_version(std::string_view text, uint32_t& version) noexcept {
+    if (text.empty()) {
+        version = 0;
+        return true;
+    }
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), version);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+/**
+ * Splits "resource.instance#message": the name ends at the first '.' or '#', the instance at the second '.' or the
+ * first '#' and the message at the second '#'.
+ */
+void parse_resource(std::string_view text, LongUri& uri) noexcept {
+    ByteClassScanner scanner(text, {'.', '#'});
+    size_t name_end = text.size();
+    size_t instance_start = text.size();
+    size_t instance_end = text.size();
+    for (size_t position = scanner.next(); position != scanner.npos; position = scanner.next()) {
+        if (text[position] == '#') {
+            name_end = std::min(name_end, position);
+            instance_end = std::min(instance_end, position);
+            size_t message_start = position + 1;
+            size_t message_end = scanner.next();
+            while (message_end != scanner.npos && text[message_end] != '#') {
+                message_end = scanner.next();
+            }
+            uri.message = text.substr(message_start, std::min(message_end, text.size()) - message_start);
+            break;
+        }
+        if (instance_start == text.size()) {
+            name_end = position;
+            instance_start = position + 1;
+        } else if (instance_end == text.size()) {
+            instance_end = position;
+        }
+    }
+    uri.resource = text.substr(0, name_end);
+    if (instance_start < instance_end) {
+        uri.instance = text.substr(instance_start, instance_end - instance_start);
+    }
+}
+
+char* append(char* out, std::string_view text) noexcept {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+}  // namespace
+
+bool parse_long_uri(std::string_view text, LongUri& uri) noexcept {
+    uri = LongUri();
+    if (strip(text).empty()) {
+        return false;
+    }
+
+    // A scheme such as "up:" is dropped, without one '\' separates parts as well as '/'
+    size_t colon = ByteClassScanner(text, {':'}).next();
+    if (colon != text.npos) {
+        text.remove_prefix(colon + 1);
+    }
+    size_t separators[MAX_PARTS];
+    size_t separator_count = 0;
+    auto collect = [&](auto scanner) {
+        for (size_t position = scanner.next(); position != scanner.npos && separator_count < MAX_PARTS;
+             position = scanner.next()) {
+            separators[separator_count++] = position;
+        }
+    };
+    if (colon != text.npos) {
+        collect(ByteClassScanner(text, {'/'}));
+    } else {
+        collect(ByteClassScanner(text, {'/', '\\'}));
+    }
+
+    size_t part_count = separator_count + 1;
+    auto part = [&](size_t index) {
+        size_t start = index == 0 ? 0 : separators[index - 1] + 1;
+        size_t end = index < separator_count ? separators[index] : text.size();
+        return text.substr(start, end - start);
+    };
+    if (part_count <= 1) {
+        return false;
+    }
+
+    // Remote URIs start with "//", so their parts are shifted by the authority
+    bool is_local = !(separator_count >= 2 && separators[0] == 0 && separators[1] == 1);
+    size_t entity_index = 1;
+    if (!is_local) {
+        if (strip(part(2)).empty()) {
+            return false;
+        }
+        uri.has_authority = true;
+        uri.authority = part(2);
+        if (part_count <= 3) {
+            return true;
+        }
+        entity_index = 3;
+    }
+
+    uri.entity = part(entity_index);
+    if (part_count > entity_index + 1 && !parse_version(part(entity_index + 1), uri.version_major)) {
+        uri = LongUri();
+        return false;
+    }
+    if (part_count > entity_index + 2) {
+        parse_resource(part(entity_index + 2), uri);
+    }
+    return !uri.is_empty();
+}
+
+size_t max_long_uri_length(const LongUri& uri) noexcept {
+    // "//" authority "/" entity "/" version "/" resource "." instance "#" message
+    return 2 + uri.authority.size() + 1 + uri.entity.size() + 1 + MAX_VERSION_DIGITS + 1 + uri.resource.size() + 1 +
+           uri.instance.size() + 1 + uri.message.size();
+}
+
+size_t serialize_long_uri(const LongUri& uri, char* out) noexcept {
+    if (uri.is_empty()) {
+        return 0;
+    }
+    char* end = out;
+    if (uri.has_authority) {
+        end = append(end, "//");
+        end = append(end, uri.authority);
+    }
+    *end++ = '/';
+    end = append(end, strip(uri.entity));
+    *end++ = '/';
+    if (uri.version_major > 0) {
+        end = std::to_chars(end, end + MAX_VERSION_DIGITS, uri.version_major).ptr;
+    }
+    *end++ = '/';
+    end = append(end, uri.resource);
+    if (!uri.instance.empty()) {
+        *end++ = '.';
+        end = append(end, uri.instance);
+    }
+    if (!uri.message.empty()) {
+        *end++ = '#';
+        end = append(end, uri.message);
+    }
+    // The parts left empty at the end leave no trailing '/'
+    while (end != out && end[-1] == '/') {
+        --end;
+    }
+    return static_cast<size_t>(end - out);
+}
+
+std::string serialize_long_uri(const LongUri& uri) {
+    std::string serialized(max_long_uri_length(uri), '\0');
+    serialized.resize(serialize_long_uri(uri, serialized.data()));
+    return serialized;
+}
+
+}  // namespace uprotocol::tck
@@ -0,0 +1,76 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace uprotocol::tck {
+
+/**
+ * The fields of a UUri that its long form "//authority/entity/version/resource.instance#message" carries.
+ * The views point into the text the UUri was parsed from, or into the strings it is serialized from.
+ */
+struct LongUri {
+    // Set for a remote UUri, even if the authority name is empty
+    bool has_authority = false;
+    std::string_view authority;
+    std::string_view entity;
+    uint32_t version_major = 0;
+    std::string_view resource;
+    std::string_view instance;
+    std::string_view message;
+
+    bool is_empty() const noexcept {
+        return authority.empty() && entity.empty() && version_major == 0 && resource.empty() && instance.empty() &&
+               message.empty();
+    }
+};
+
+/**
+ * Parses a long form URI like LongUriSerializer.deserialize of the other SDKs, without allocating.
+ *
+ * @param text The long form URI, e.g. "//vcu.my_car_vin/neelam/1/test.front#Test".
+ * @param uri Receives the fields, which point into text. It is left empty where the SDKs return an empty UUri.
+ * @return False if the URI is empty or invalid, e.g. because its version is not a number.
+ */
+bool parse_long_uri(std::string_view text, LongUri& uri) noexcept;
+
+/**
+ * Returns the most bytes serialize_long_uri writes for the UUri.
+ */
+size_t max_long_uri_length(const LongUri& uri) noexcept;
+
+/**
+ * Serializes a UUri to its long form like LongUriSerializer.serialize of the other SDKs, without allocating.
+ *
+ * @param uri The UUri, an empty one serializes to "".
+ * @param out Receives the long form, at least max_long_uri_length(uri) bytes.
+ * @return The number of bytes written.
+ */
+size_t serialize_long_uri(const LongUri& uri, char* out) noexcept;
+
+std::string serialize_long_uri(const LongUri& uri);
+
+}  // namespace uprotocol::tck
@@ -0,0 +1,244 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace uprotocol::tck {
+
+/**
+ * The micro form of a UUri, as MicroUriSerializer of the other SDKs writes it:
+ *
+ *  0: version (1) | 1: address type | 2-3: resource id | 4-5: entity id | 6: version major | 7: unused
+ *  8: IPv4 (4 bytes), IPv6 (16 bytes) or the length of the id followed by the id (at most 255 bytes)
+ *
+ * All multi-byte numbers are big-endian. Everything here is constexpr, so micro URIs of well-known topics can be
+ * encoded and looked up at compile time.
+ */
+enum class AddressType : uint8_t { Local = 0, IPv4 = 1, IPv6 = 2, Id = 3 };
+
+constexpr uint8_t MICRO_URI_VERSION = 1;
+constexpr size_t LOCAL_MICRO_URI_LENGTH = 8;
+constexpr size_t IPV4_LENGTH = 4;
+constexpr size_t IPV6_LENGTH = 16;
+constexpr size_t MAX_ID_LENGTH = 255;
+constexpr size_t MAX_MICRO_URI_LENGTH = LOCAL_MICRO_URI_LENGTH + 1 + MAX_ID_LENGTH;
+
+struct MicroUri {
+    AddressType address_type = AddressType::Local;
+    // The 4 or 16 bytes of the IP address or the id, pointing into the micro form it was decoded from
+    std::string_view authority;
+    uint16_t resource_id = 0;
+    uint16_t entity_id = 0;
+    uint8_t version_major = 0;
+};
+
+namespace micro_uri_detail {
+
+// Length of the micro form by address type, without the id itself
+constexpr std::array<size_t, 4> FIXED_LENGTHS = {LOCAL_MICRO_URI_LENGTH, LOCAL_MICRO_URI_LENGTH + IPV4_LENGTH,
+                                                 LOCAL_MICRO_URI_LENGTH + IPV6_LENGTH, LOCAL_MICRO_URI_LENGTH + 1};
+
+constexpr uint8_t byte_at(std::string_view bytes, size_t index) noexcept {
+    return static_cast<uint8_t>(bytes[index]);
+}
+
+}  // namespace micro_uri_detail
+
+/**
+ * Returns the length of the micro form of the UUri, or 0 if its authority does not fit its address type.
+ */
+constexpr size_t micro_uri_length(const MicroUri& uri) noexcept {
+    switch (uri.address_type) {
+        case AddressType::Local:
+            return uri.authority.empty() ? LOCAL_MICRO_URI_LENGTH : 0;
+        case AddressType::IPv4:
+            return uri.authority.size() == IPV4_LENGTH ? LOCAL_MICRO_URI_LENGTH + IPV4_LENGTH : 0;
+        case AddressType::IPv6:
+            return uri.authority.size() == IPV6_LENGTH ? LOCAL_MICRO_URI_LENGTH + IPV6_LENGTH : 0;
+        case AddressType::Id:
+            return uri.authority.size() <= MAX_ID_LENGTH ? LOCAL_MICRO_URI_LENGTH + 1 + uri.authority.size() : 0;
+    }
+    return 0;
+}
+
+/**
+ * Writes the micro form of the UUri.
+ *
+ * @param out Receives the micro form, at least micro_uri_length(uri) bytes.
+ * @return The number of bytes written, 0 if the authority does not fit the address type.
+ */
+constexpr size_t encode_micro_uri(const MicroUri& uri, char* out) noexcept {
+    size_t length = micro_uri_length(uri);
+    if (length == 0) {
+        return 0;
+    }
+    out[0] = static_cast<char>(MICRO_URI_VERSION);
+    out[1] = static_cast<char>(uri.address_type);
+    out[2] = static_cast<char>(uri.resource_id >> 8);
+    out[3] = static_cast<char>(uri.resource_id & 0xFF);
+    out[4] = static_cast<char>(uri.entity_id >> 8);
+    out[5] = static_cast<char>(uri.entity_id & 0xFF);
+    out[6] = static_cast<char>(uri.version_major);
+    out[7] = 0;
+    size_t position = LOCAL_MICRO_URI_LENGTH;
+    if (uri.address_type == AddressType::Id) {
+        out[position++] = static_cast<char>(uri.authority.size());
+    }
+    for (char c : uri.authority) {
+        out[position++] = c;
+    }
+    return length;
+}
+
+/**
+ * A micro form held by value, e.g. as a compile-time constant.
+ */
+template <size_t Capacity>
+struct MicroUriBytes {
+    std::array<char, Capacity> bytes{};
+    size_t length = 0;
+
+    constexpr std::string_view view() const noexcept { return std::string_view(bytes.data(), length); }
+};
+
+/**
+ * Encodes a local UUri, e.g. constexpr auto DOOR = local_micro_uri(0x1234, 1, 0x8000).
+ */
+constexpr MicroUriBytes<LOCAL_MICRO_URI_LENGTH> local_micro_uri(uint16_t entity_id, uint8_t version_major,
+                                                                uint16_t resource_id) noexcept {
+    MicroUriBytes<LOCAL_MICRO_URI_LENGTH> micro_uri;
+    MicroUri uri;
+    uri.entity_id = entity_id;
+    uri.version_major = version_major;
+    uri.resource_id = resource_id;
+    micro_uri.length = encode_micro_uri(uri, micro_uri.bytes.data());
+    return micro_uri;
+}
+
+/**
+ * Decodes a micro form like MicroUriSerializer.deserialize of the other SDKs, without allocating.
+ * Whether the bytes are a micro form is decided by comparing the version, the address type and the length the
+ * address type implies all at once, without a branch per check.
+ *
+ * @param bytes The micro form.
+ * @param uri Receives the fields, its authority points into bytes. It is left empty if the bytes are no micro form.
+ * @return False if the bytes are no micro form.
+ */
+constexpr bool decode_micro_uri(std::string_view bytes, MicroUri& uri) noexcept {
+    using micro_uri_detail::byte_at;
+    uri = MicroUri();
+    // The only branch before the checks, it keeps the reads of the fixed header in bounds
+    if (bytes.size() < LOCAL_MICRO_URI_LENGTH) {
+        return false;
+    }
+    uint8_t address_type = byte_at(bytes, 1);
+    bool is_id = address_type == static_cast<uint8_t>(AddressType::Id);
+    size_t id_length = bytes.size() > LOCAL_MICRO_URI_LENGTH ? byte_at(bytes, LOCAL_MICRO_URI_LENGTH) : 0;
+    size_t expected_length = micro_uri_detail::FIXED_LENGTHS[address_type & 3] + is_id * id_length;
+    bool valid = (byte_at(bytes, 0) == MICRO_URI_VERSION) & (address_type <= 3) & (bytes.size() == expected_length);
+    if (!valid) {
+        return false;
+    }
+
+    uri.address_type = static_cast<AddressType>(address_type);
+    uri.resource_id = static_cast<uint16_t>(byte_at(bytes, 2) << 8 | byte_at(bytes, 3));
+    uri.entity_id = static_cast<uint16_t>(byte_at(bytes, 4) << 8 | byte_at(bytes, 5));
+    uri.version_major = byte_at(bytes, 6);
+    uri.authority = bytes.substr(LOCAL_MICRO_URI_LENGTH + is_id);
+    return true;
+}
+
+/**
+ * Returns the first 8 bytes of a micro form, which identify a local UUri, as one integer.
+ */
+constexpr uint64_t micro_uri_key(std::string_view micro_uri) noexcept {
+    uint64_t key = 0;
+    for (size_t i = 0; i < LOCAL_MICRO_URI_LENGTH && i < micro_uri.size(); ++i) {
+        key = key << 8 | micro_uri_detail::byte_at(micro_uri, i);
+    }
+    return key;
+}
+
+/**
+ * Maps the micro forms of local UUris to values, built and sorted at compile time and searched without hashing, e.g.
+ *
+ *   constexpr MicroUriTable<int, 2> ROUTES({{{local_micro_uri(0x1234, 1, 0x8000), 0},
+ *                                           {local_micro_uri(0x1234, 1, 0x8001), 1}}});
+ *   const int* route = ROUTES.find(received_micro_uri);
+ */
+template <typename Value, size_t N>
+class MicroUriTable {
+public:
+    using Entry = std::pair<MicroUriBytes<LOCAL_MICRO_URI_LENGTH>, Value>;
+
+    constexpr explicit MicroUriTable(const std::array<Entry, N>& entries) {
+        for (size_t i = 0; i < N; ++i) {
+            keys_[i] = micro_uri_key(entries[i].first.view());
+            values_[i] = entries[i].second;
+        }
+        // Insertion sort, as std::sort and std::swap are constexpr only from C++20 on
+        for (size_t i = 1; i < N; ++i) {
+            uint64_t key = keys_[i];
+            Value value = values_[i];
+            size_t j = i;
+            for (; j > 0 && keys_[j - 1] > key; --j) {
+                keys_[j] = keys_[j - 1];
+                values_[j] = values_[j - 1];
+            }
+            keys_[j] = key;
+            values_[j] = value;
+        }
+    }
+
+    /**
+     * Returns the value of a local micro form, or nullptr if the table has none.
+     */
+    constexpr const Value* find(std::string_view micro_uri) const noexcept {
+        if (micro_uri.size() != LOCAL_MICRO_URI_LENGTH) {
+            return nullptr;
+        }
+        uint64_t key = micro_uri_key(micro_uri);
+        size_t first = 0;
+        size_t count = N;
+        while (count > 0) {
+            size_t half = count / 2;
+            if (keys_[first + half] < key) {
+                first += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        return first < N && keys_[first] == key ? &values_[first] : nullptr;
+    }
+
+private:
+    std::array<uint64_t, N> keys_{};
+    std::array<Value, N> values_{};
+};
+
+}  // namespace uprotocol::tck
@@ -0,0 +1,519 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * The C++ Test Agent. There is no C++ uTransport for the Dispatcher yet, so it serves the serializer actions and
+ * get_stats only and answers every other action with UNIMPLEMENTED.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "json.h"
+#include "long_uri.h"
+#include "micro_uri.h"
+
+#ifndef MSG_NOSIGNAL
+// macOS has no MSG_NOSIGNAL, a closed Test Manager connection ends the Test Agent there
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace uprotocol::tck {
+
+namespace {
+
+constexpr std::string_view SDK_NAME = "cpp";
+constexpr char INSTANCE_SEPARATOR = '#';
+constexpr char TEST_MANAGER_IP[] = "127.0.0.5";
+constexpr uint16_t TEST_MANAGER_PORT = 12345;
+constexpr size_t BYTES_MSG_LENGTH = 32767;
+// UCodes of the UStatus answering requests the C++ Test Agent cannot serve
+constexpr int UCODE_INVALID_ARGUMENT = 3;
+constexpr int UCODE_UNIMPLEMENTED = 12;
+// Prefix of the request fields that hold bytes
+constexpr std::string_view BYTES_PREFIX = "BYTES:";
+// Resource ids below it are methods, see UResourceBuilder.from_id
+constexpr uint16_t MAX_RPC_ID = 1000;
+
+constexpr std::string_view SERIALIZE_URI = "uri_serialize";
+constexpr std::string_view DESERIALIZE_URI = "uri_deserialize";
+constexpr std::string_view MICRO_SERIALIZE_URI = "micro_serialize_uri";
+constexpr std::string_view MICRO_DESERIALIZE_URI = "micro_deserialize_uri";
+constexpr std::string_view RUN_VECTORS_COMMAND = "run_vectors";
+constexpr std::string_view GET_STATS_COMMAND = "get_stats";
+
+int ta_socket = -1;
+std::string test_agent_name;
+// Requests answered by their handler, and requests rejected as INVALID_ARGUMENT because their data did not parse
+int64_t actions_handled = 0;
+int64_t parse_errors = 0;
+
+void send_to_test_manager(const std::string& data_json, std::string_view action, std::string_view test_id) {
+    std::string response;
+    JsonWriter writer(response);
+    writer.begin_object().key("data").raw(data_json);
+    writer.key("action").string(action).key("ue").string(test_agent_name).key("test_id").string(test_id);
+    writer.end_object();
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t written = ::send(ta_socket, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            std::cerr << "Error while sending to the Test Manager: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        sent += static_cast<size_t>(written);
+    }
+}
+
+const Json& data_of(const Json& json_msg) {
+    const Json* data = json_msg.find("data");
+    if (data == nullptr) {
+        throw JsonError("The request has no data");
+    }
+    return *data;
+}
+
+/**
+ * Reads a UUri of the request data, whose fields point into the data.
+ */
+LongUri long_uri_of(const Json& data) {
+    LongUri uri;
+    if (const Json* authority = data.find("authority"); authority != nullptr && authority->is_object()) {
+        uri.has_authority = true;
+        uri.authority = authority->text_of("name");
+    }
+    if (const Json* entity = data.find("entity"); entity != nullptr && entity->is_object()) {
+        uri.entity = entity->text_of("name");
+        uri.version_major = static_cast<uint32_t>(entity->integer_of("version_major"));
+    }
+    if (const Json* resource = data.find("resource"); resource != nullptr && resource->is_object()) {
+        uri.resource = resource->text_of("name");
+        uri.instance = resource->text_of("instance");
+        uri.message = resource->text_of("message");
+    }
+    return uri;
+}
+
+/**
+ * Writes a UUri with all its fields, the ones the long form does not carry set to their defaults like the Python
+ * Test Agent does.
+ */
+void write_uuri(JsonWriter& writer, const LongUri& uri) {
+    writer.begin_object();
+    writer.key("authority").begin_object();
+    writer.key("name").string(uri.authority).key("ip").string("").key("id").string("");
+    writer.end_object();
+    writer.key("entity").begin_object();
+    writer.key("name").string(uri.entity).key("id").integer(0);
+    writer.key("version_major").integer(uri.version_major).key("version_minor").integer(0);
+    writer.end_object();
+    writer.key("resource").begin_object();
+    writer.key("name").string(uri.resource).key("instance").string(uri.instance);
+    writer.key("message").string(uri.message).key("id").integer(0);
+    writer.end_object();
+    writer.end_object();
+}
+
+/**
+ * The Test Manager exchanges micro forms as strings with one character per byte, like Python's "iso-8859-1" codec,
+ * which JSON carries UTF-8 encoded.
+ *
+ * @return False if a character is no byte.
+ */
+bool latin1_of(std::string_view text, std::string& bytes) {
+    bytes.clear();
+    for (size_t i = 0; i < text.size(); ++i) {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            bytes += static_cast<char>(c);
+        } else if ((c & 0xFE) == 0xC2 && i + 1 < text.size()) {
+            bytes += static_cast<char>((c & 0x03) << 6 | (static_cast<unsigned char>(text[++i]) & 0x3F));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string utf8_of_latin1(std::string_view bytes) {
+    std::string text;
+    text.reserve(bytes.size() * 2);
+    for (char byte : bytes) {
+        auto c = static_cast<unsigned char>(byte);
+        if (c < 0x80) {
+            text += byte;
+        } else {
+            text += static_cast<char>(0xC0 | c >> 6);
+            text += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return text;
+}
+
+std::string_view bytes_of(std::string_view field) {
+    return field.substr(0, BYTES_PREFIX.size()) == BYTES_PREFIX ? field.substr(BYTES_PREFIX.size()) : field;
+}
+
+/**
+ * Reads a UUri of the request data like MicroUriSerializer.serialize does, whose authority points into the data.
+ *
+ * @return False if the UUri has no micro form, i.e. lacks the entity or resource id or an IP or id of its authority.
+ */
+bool micro_uri_of(const Json& data, MicroUri& uri) {
+    uri = MicroUri();
+    const Json* entity = data.find("entity");
+    const Json* resource = data.find("resource");
+    if (entity == nullptr || resource == nullptr || entity->find("id") == nullptr || resource->find("id") == nullptr) {
+        return false;
+    }
+    uri.entity_id = static_cast<uint16_t>(entity->integer_of("id"));
+    uri.version_major = static_cast<uint8_t>(entity->integer_of("version_major"));
+    uri.resource_id = static_cast<uint16_t>(resource->integer_of("id"));
+    if (const Json* authority = data.find("authority"); authority != nullptr && authority->is_object()) {
+        std::string_view ip = bytes_of(authority->text_of("ip"));
+        std::string_view id = bytes_of(authority->text_of("id"));
+        if (ip.size() == IPV4_LENGTH || ip.size() == IPV6_LENGTH) {
+            uri.address_type = ip.size() == IPV4_LENGTH ? AddressType::IPv4 : AddressType::IPv6;
+            uri.authority = ip;
+        } else if (!ip.empty() || id.empty()) {
+            return false;
+        } else {
+            uri.address_type = AddressType::Id;
+            uri.authority = id;
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes a UUri decoded from a micro form like the Python Test Agent does, naming the resource after its id like
+ * UResourceBuilder.from_id. Bytes that are no micro form give the empty UUri.
+ */
+void write_micro_uuri(JsonWriter& writer, const MicroUri& uri, bool decoded) {
+    bool has_ip = uri.address_type == AddressType::IPv4 || uri.address_type == AddressType::IPv6;
+    std::string_view ip = has_ip ? uri.authority : std::string_view();
+    std::string_view id = uri.address_type == AddressType::Id ? uri.authority : std::string_view();
+    bool is_rpc = decoded && uri.resource_id < MAX_RPC_ID;
+    std::string_view instance = is_rpc && uri.resource_id == 0 ? "response" : "";
+    writer.begin_object();
+    writer.key("authority").begin_object();
+    // The address is no text, its bytes are written as characters so the JSON stays valid
+    writer.key("name").string("").key("ip").string(utf8_of_latin1(ip)).key("id").string(id);
+    writer.end_object();
+    writer.key("entity").begin_object();
+    writer.key("name").string("").key("id").integer(uri.entity_id);
+    writer.key("version_major").integer(uri.version_major).key("version_minor").integer(0);
+    writer.end_object();
+    writer.key("resource").begin_object();
+    writer.key("name").string(is_rpc ? "rpc" : "").key("instance").string(instance);
+    writer.key("message").string("").key("id").integer(uri.resource_id);
+    writer.end_object();
+    writer.end_object();
+}
+
+void handle_long_serialize_uri(const Json& json_msg) {
+    std::string data_json;
+    JsonWriter(data_json).string(serialize_long_uri(long_uri_of(data_of(json_msg))));
+    send_to_test_manager(data_json, SERIALIZE_URI, json_msg.text_of("test_id"));
+}
+
+void handle_long_deserialize_uri(const Json& json_msg) {
+    LongUri uri;
+    parse_long_uri(data_of(json_msg).text(), uri);
+    std::string data_json;
+    JsonWriter writer(data_json);
+    write_uuri(writer, uri);
+    send_to_test_manager(data_json, DESERIALIZE_URI, json_msg.text_of("test_id"));
+}
+
+void handle_micro_serialize_uri(const Json& json_msg) {
+    MicroUri uri;
+    char out[MAX_MICRO_URI_LENGTH];
+    size_t length = micro_uri_of(data_of(json_msg), uri) ? encode_micro_uri(uri, out) : 0;
+    std::string data_json;
+    JsonWriter(data_json).string(utf8_of_latin1(std::string_view(out, length)));
+    send_to_test_manager(data_json, MICRO_SERIALIZE_URI, json_msg.text_of("test_id"));
+}
+
+void handle_micro_deserialize_uri(const Json& json_msg) {
+    std::string bytes;
+    MicroUri uri;
+    bool decoded = latin1_of(data_of(json_msg).text(), bytes) && decode_micro_uri(bytes, uri);
+    std::string data_json;
+    JsonWriter writer(data_json);
+    write_micro_uuri(writer, uri, decoded);
+    send_to_test_manager(data_json, MICRO_DESERIALIZE_URI, json_msg.text_of("test_id"));
+}
+
+/**
+ * Runs a serializer over all "inputs" of the request "repeat" times and reports the results of the first pass and
+ * the operations per second of all passes, so serializers are compared without a round trip per operation.
+ */
+void handle_run_vectors_command(const Json& json_msg) {
+    const Json& data = data_of(json_msg);
+    std::string_view action = data.text_of("action");
+    int64_t repeat = std::max<int64_t>(data.integer_of("repeat", 1), 1);
+    const Json* inputs = data.find("inputs");
+    bool is_micro = action == MICRO_SERIALIZE_URI || action == MICRO_DESERIALIZE_URI;
+    if (inputs == nullptr || !inputs->is_array() || (action != SERIALIZE_URI && action != DESERIALIZE_URI && !is_micro)) {
+        throw JsonError("run_vectors needs \"inputs\" and an \"action\" of the uri or micro uri serializer");
+    }
+
+    std::string data_json;
+    JsonWriter writer(data_json);
+    writer.begin_object().key("action").string(action).key("results").begin_array();
+    // Anything derived from every result, so the passes cannot be optimized away
+    size_t checksum = 0;
+    std::chrono::steady_clock::duration elapsed{};
+    if (action == SERIALIZE_URI) {
+        std::vector<LongUri> uris;
+        size_t max_length = 0;
+        for (const Json& input : inputs->items()) {
+            uris.push_back(long_uri_of(input));
+            max_length = std::max(max_length, max_long_uri_length(uris.back()));
+        }
+        std::string out(max_length, '\0');
+        for (const LongUri& uri : uris) {
+            writer.string(std::string_view(out.data(), serialize_long_uri(uri, out.data())));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int64_t pass = 0; pass < repeat; ++pass) {
+            for (const LongUri& uri : uris) {
+                checksum += serialize_long_uri(uri, out.data());
+            }
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    } else if (action == DESERIALIZE_URI) {
+        std::vector<std::string_view> texts;
+        for (const Json& input : inputs->items()) {
+            texts.push_back(input.text());
+        }
+        LongUri uri;
+        for (std::string_view text : texts) {
+            parse_long_uri(text, uri);
+            write_uuri(writer, uri);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int64_t pass = 0; pass < repeat; ++pass) {
+            for (std::string_view text : texts) {
+                checksum += parse_long_uri(text, uri) + uri.entity.size();
+            }
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    } else if (action == MICRO_SERIALIZE_URI) {
+        // UUris without a micro form serialize to nothing, like MicroUriSerializer does
+        std::vector<std::pair<MicroUri, bool>> uris;
+        for (const Json& input : inputs->items()) {
+            MicroUri uri;
+            bool has_micro_form = micro_uri_of(input, uri);
+            uris.emplace_back(uri, has_micro_form);
+        }
+        char out[MAX_MICRO_URI_LENGTH];
+        for (const auto& [uri, has_micro_form] : uris) {
+            size_t length = has_micro_form ? encode_micro_uri(uri, out) : 0;
+            writer.string(utf8_of_latin1(std::string_view(out, length)));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int64_t pass = 0; pass < repeat; ++pass) {
+            for (const auto& [uri, has_micro_form] : uris) {
+                checksum += has_micro_form ? encode_micro_uri(uri, out) : 0;
+            }
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    } else {
+        std::vector<std::string> micro_uris;
+        for (const Json& input : inputs->items()) {
+            micro_uris.emplace_back();
+            // Characters that are no bytes leave nothing to decode
+            if (!latin1_of(input.text(), micro_uris.back())) {
+                micro_uris.back().clear();
+            }
+        }
+        MicroUri uri;
+        for (const std::string& micro_uri : micro_uris) {
+            bool decoded = decode_micro_uri(micro_uri, uri);
+            write_micro_uuri(writer, uri, decoded);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int64_t pass = 0; pass < repeat; ++pass) {
+            for (const std::string& micro_uri : micro_uris) {
+                checksum += decode_micro_uri(micro_uri, uri) + uri.entity_id;
+            }
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    int64_t ops = repeat * static_cast<int64_t>(inputs->items().size());
+    writer.end_array().key("ops").integer(ops).key("elapsed_ns").integer(elapsed_ns);
+    writer.key("ops_per_s").number(elapsed_ns > 0 ? ops * 1e9 / static_cast<double>(elapsed_ns) : 0.0);
+    writer.key("checksum").integer(static_cast<int64_t>(checksum)).end_object();
+    send_to_test_manager(data_json, RUN_VECTORS_COMMAND, json_msg.text_of("test_id"));
+}
+
+/**
+ * Returns the user and system CPU time the process has used, in seconds.
+ */
+double process_cpu_s() {
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval& time) { return static_cast<double>(time.tv_sec) + time.tv_usec / 1e6; };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+/**
+ * Returns the resident set size of the process, 0 where /proc is not available.
+ */
+int64_t current_rss_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    int64_t size_pages = 0;
+    int64_t resident_pages = 0;
+    if (!(statm >> size_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * ::sysconf(_SC_PAGESIZE);
+}
+
+void handle_get_stats_command(const Json& json_msg) {
+    std::string data_json;
+    JsonWriter writer(data_json);
+    writer.begin_object().key("actions_handled").integer(actions_handled).key("parse_errors").integer(parse_errors);
+    writer.key("cpu_s").number(process_cpu_s()).key("rss_bytes").integer(current_rss_bytes()).end_object();
+    send_to_test_manager(data_json, GET_STATS_COMMAND, json_msg.text_of("test_id"));
+}
+
+void send_status(const Json& json_msg, std::string_view action, int code, std::string_view message) {
+    std::string data_json;
+    JsonWriter writer(data_json);
+    writer.begin_object().key("code").integer(code).key("message").string(message);
+    writer.key("details").begin_array().end_array().end_object();
+    send_to_test_manager(data_json, action, json_msg.text_of("test_id"));
+}
+
+using ActionHandler = void (*)(const Json&);
+
+const std::unordered_map<std::string_view, ActionHandler> action_handlers = {
+    {SERIALIZE_URI, handle_long_serialize_uri},
+    {DESERIALIZE_URI, handle_long_deserialize_uri},
+    {MICRO_SERIALIZE_URI, handle_micro_serialize_uri},
+    {MICRO_DESERIALIZE_URI, handle_micro_deserialize_uri},
+    {RUN_VECTORS_COMMAND, handle_run_vectors_command},
+    {GET_STATS_COMMAND, handle_get_stats_command},
+};
+
+void process_message(const Json& json_msg) {
+    std::string_view action = json_msg.text_of("action");
+    auto handler = action_handlers.find(action);
+    if (handler == action_handlers.end()) {
+        send_status(json_msg, action, UCODE_UNIMPLEMENTED,
+                    "The C++ Test Agent does not implement " + std::string(action));
+        return;
+    }
+    try {
+        handler->second(json_msg);
+        ++actions_handled;
+    } catch (const JsonError& e) {
+        // Answers anyway, so the Test Manager does not wait for a response that never comes
+        ++parse_errors;
+        send_status(json_msg, action, UCODE_INVALID_ARGUMENT, e.what());
+    }
+}
+
+void receive_from_tm() {
+    JsonStreamDecoder decoder;
+    std::vector<char> recv_data(BYTES_MSG_LENGTH);
+    while (true) {
+        ssize_t received = ::recv(ta_socket, recv_data.data(), recv_data.size(), 0);
+        if (received <= 0) {
+            return;
+        }
+        decoder.feed(std::string_view(recv_data.data(), static_cast<size_t>(received)));
+        Json json_msg;
+        try {
+            while (decoder.next(json_msg)) {
+                if (json_msg.is_object()) {
+                    process_message(json_msg);
+                }
+            }
+        } catch (const JsonError& e) {
+            std::cerr << "Invalid command from the Test Manager: " << e.what() << std::endl;
+            return;
+        }
+    }
+}
+
+}  // namespace
+
+}  // namespace uprotocol::tck
+
+int main(int argc, char* argv[]) {
+    using namespace uprotocol::tck;
+
+    std::string instance_id;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view option = argv[i];
+        if (option == "--instance-id") {
+            instance_id = argv[i + 1];
+        } else if (option != "--transport") {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 2;
+        }
+    }
+    test_agent_name = std::string(SDK_NAME);
+    if (!instance_id.empty()) {
+        test_agent_name += INSTANCE_SEPARATOR + instance_id;
+    }
+
+    ta_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(TEST_MANAGER_PORT);
+    ::inet_pton(AF_INET, TEST_MANAGER_IP, &address.sin_addr);
+    if (::connect(ta_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Cannot connect to the Test Manager: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    int no_delay = 1;
+    ::setsockopt(ta_socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    std::string initialize;
+    JsonWriter(initialize).begin_object().key("SDK_name").string(SDK_NAME).key("instance_id").string(instance_id)
+        .end_object();
+    send_to_test_manager(initialize, "initialize", "");
+    receive_from_tm();
+    ::close(ta_socket);
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <iostream>
+
+/**
+ * The checks of the C++ Test Agent's test programs. A failed check is reported and counted, the program goes on and
+ * its main returns exit_code(), so that one run lists every failure.
+ */
+namespace uprotocol::tck::test {
+
+inline int failures = 0;
+
+/**
+ * Returns the exit code of a test program, 1 after reporting the number of failed checks if there are any.
+ */
+inline int exit_code() {
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace uprotocol::tck::test
+
+#define EXPECT_EQ(actual, expected)                                                                       \
+    do {                                                                                                 \
+        if ((actual) != (expected)) {                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is " << (actual) << ", expected " \
+                      << (expected) << std::endl;                                                        \
+            ++uprotocol::tck::test::failures;                                                            \
+        }                                                                                                \
+    } while (false)
@@ -0,0 +1,104 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string>
+#include <string_view>
+
+#include "expect.h"
+#include "json.h"
+
+using uprotocol::tck::Json;
+using uprotocol::tck::JsonError;
+using uprotocol::tck::JsonStreamDecoder;
+using uprotocol::tck::JsonWriter;
+
+namespace {
+
+void test_commands_back_to_back_and_split() {
+    std::string_view stream =
+        R"({"data": {"entity": {"name": "neelam", "version_major": "1"}}, "action": "uri_serialize", "test_id": "1"})"
+        R"( {"data": "/neelam/1", "action": "uri_deserialize", "test_id": "2"})";
+    JsonStreamDecoder decoder;
+    Json command;
+    // Fed in pieces that end inside strings, numbers and between values
+    for (size_t offset = 0; offset < stream.size(); offset += 7) {
+        decoder.feed(stream.substr(offset, 7));
+        while (decoder.next(command)) {
+            std::string_view action = command.text_of("action");
+            if (action == "uri_serialize") {
+                const Json* entity = command.find("data")->find("entity");
+                EXPECT_EQ(entity->text_of("name"), "neelam");
+                EXPECT_EQ(entity->integer_of("version_major"), 1);
+                EXPECT_EQ(command.text_of("test_id"), "1");
+            } else {
+                EXPECT_EQ(action, "uri_deserialize");
+                EXPECT_EQ(command.find("data")->text(), "/neelam/1");
+                EXPECT_EQ(command.text_of("test_id"), "2");
+            }
+        }
+    }
+    EXPECT_EQ(decoder.next(command), false);
+}
+
+void test_escapes() {
+    JsonStreamDecoder decoder;
+    decoder.feed(R"(["a\"b\\c\n", "é😀", 12, -3.5e2, true, null, []])");
+    Json value;
+    EXPECT_EQ(decoder.next(value), true);
+    EXPECT_EQ(value.items().size(), 7u);
+    EXPECT_EQ(value.items()[0].text(), "a\"b\\c\n");
+    EXPECT_EQ(value.items()[1].text(), "\xc3\xa9\xf0\x9f\x98\x80");
+    EXPECT_EQ(value.items()[2].text(), "12");
+    EXPECT_EQ(value.items()[3].text(), "-3.5e2");
+    EXPECT_EQ(value.items()[6].is_array(), true);
+}
+
+void test_invalid_json() {
+    JsonStreamDecoder decoder;
+    decoder.feed(R"({"data" 1})");
+    Json value;
+    bool thrown = false;
+    try {
+        decoder.next(value);
+    } catch (const JsonError&) {
+        thrown = true;
+    }
+    EXPECT_EQ(thrown, true);
+}
+
+void test_writer() {
+    std::string out;
+    JsonWriter writer(out);
+    writer.begin_object().key("data").begin_object().key("code").integer(12).key("details").begin_array().end_array();
+    writer.end_object().key("results").begin_array().string("x\ty").integer(-1).raw("{}").end_array();
+    writer.key("ops_per_s").number(2.5).end_object();
+    EXPECT_EQ(out, R"({"data":{"code":12,"details":[]},"results":["x\ty",-1,{}],"ops_per_s":2.5})");
+}
+
+}  // namespace
+
+int main() {
+    test_commands_back_to_back_and_split();
+    test_escapes();
+    test_invalid_json();
+    test_writer();
+    return uprotocol::tck::test::exit_code();
+}
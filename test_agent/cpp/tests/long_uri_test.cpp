@@ -0,0 +1,171 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string>
+#include <string_view>
+
+#include "byte_class_scanner.h"
+#include "expect.h"
+#include "long_uri.h"
+
+using uprotocol::tck::ByteClassScanner;
+using uprotocol::tck::LongUri;
+using uprotocol::tck::parse_long_uri;
+using uprotocol::tck::serialize_long_uri;
+
+namespace {
+
+struct Vector {
+    std::string_view authority;
+    std::string_view entity;
+    uint32_t version_major;
+    std::string_view resource;
+    std::string_view instance;
+    std::string_view message;
+    std::string_view serialized;
+};
+
+// The examples of long_uri_serializer.feature and long_uri_deserializer.feature
+constexpr Vector TCK_VECTORS[] = {
+    {"", "neelam", 0, "rpc", "test", "", "/neelam//rpc.test"},
+    {"", "neelam", 0, "", "", "", "/neelam"},
+    {"", "neelam", 1, "", "", "", "/neelam/1"},
+    {"", "neelam", 0, "test", "", "", "/neelam//test"},
+    {"", "neelam", 1, "test", "", "", "/neelam/1/test"},
+    {"", "neelam", 0, "test", "front", "", "/neelam//test.front"},
+    {"", "neelam", 1, "test", "front", "", "/neelam/1/test.front"},
+    {"", "neelam", 0, "test", "front", "Test", "/neelam//test.front#Test"},
+    {"", "neelam", 1, "test", "front", "Test", "/neelam/1/test.front#Test"},
+    {"vcu.my_car_vin", "neelam", 0, "", "", "", "//vcu.my_car_vin/neelam"},
+    {"vcu.my_car_vin", "neelam", 1, "", "", "", "//vcu.my_car_vin/neelam/1"},
+    {"vcu.my_car_vin", "neelam", 1, "test", "", "", "//vcu.my_car_vin/neelam/1/test"},
+    {"vcu.my_car_vin", "neelam", 0, "test", "", "", "//vcu.my_car_vin/neelam//test"},
+    {"vcu.my_car_vin", "neelam", 1, "test", "front", "", "//vcu.my_car_vin/neelam/1/test.front"},
+    {"vcu.my_car_vin", "neelam", 0, "test", "front", "", "//vcu.my_car_vin/neelam//test.front"},
+    {"vcu.my_car_vin", "neelam", 1, "test", "front", "Test", "//vcu.my_car_vin/neelam/1/test.front#Test"},
+    {"vcu.my_car_vin", "neelam", 0, "test", "front", "Test", "//vcu.my_car_vin/neelam//test.front#Test"},
+    {"vcu.my_car_vin", "petapp", 0, "rpc", "response", "", "//vcu.my_car_vin/petapp//rpc.response"},
+};
+
+// The URIs uri_validator.feature deserializes, and further ones that cross the 16 byte blocks of the scan
+constexpr Vector PARSE_VECTORS[] = {
+    {"authority_name_nameName", "name of entity", 64, "resource name", "resource instance", "message of resource",
+     "//authority_name_nameName/name of entity/64/resource name.resource instance#message of resource"},
+    {"uAuthName", "entityName", 1, "resrcName", "instance", "Message",
+     "//uAuthName/entityName/1/resrcName.instance#Message"},
+    {"uAuthName", "", 0, "resrcName", "instance", "Message", "//uAuthName///resrcName.instance#Message"},
+    {"uAuthName", "entityName", 1, "", "", "", "//uAuthName/entityName/1"},
+    {"bo.cloud", "petapp", 1, "rpc", "response", "", "//bo.cloud/petapp/1/rpc.response"},
+    {"VCU.myvin", "", 1, "", "", "", "//VCU.myvin//1"},
+    {"", "entityName", 1, "resrcName", "instance", "Message", "/entityName/1/resrcName.instance#Message"},
+    {"", "hartley", 1000, "", "", "", "/hartley/1000"},
+    {"", "neelam", 0, "rpc", "echo", "", "/neelam//rpc.echo"},
+    {"", "petapp", 1, "rpc", "", "", "/petapp/1/rpc"},
+    {"", "", 0, "", "", "", ""},
+    {"", "", 0, "", "", "", "   "},
+    {"", "", 0, "", "", "", ":"},
+    {"", "", 0, "", "", "", "///"},
+    {"", "", 0, "", "", "", "random string"},
+    // A scheme is dropped, without one '\' separates parts
+    {"vcu", "body.access", 1, "door", "front_left", "", "up://vcu/body.access/1/door.front_left"},
+    {"vcu", "body.access", 1, "door", "", "", "\\\\vcu\\body.access\\1\\door"},
+    // The instance ends at the second '.' or the first '#', the message at the second '#'
+    {"", "body.access", 2, "door", "front", "Door", "/body.access/2/door.front.left#Door#ignored/more"},
+    {"", "body.access", 2, "door", "", "Door.front", "/body.access/2/door#Door.front"},
+    // A version that is not a number leaves the UUri empty
+    {"", "", 0, "", "", "", "/body.access/one/door"},
+    {"", "", 0, "", "", "", "/body.access/99999999999/door"},
+};
+
+void expect_fields(const LongUri& uri, const Vector& vector) {
+    EXPECT_EQ(uri.authority, vector.authority);
+    EXPECT_EQ(uri.entity, vector.entity);
+    EXPECT_EQ(uri.version_major, vector.version_major);
+    EXPECT_EQ(uri.resource, vector.resource);
+    EXPECT_EQ(uri.instance, vector.instance);
+    EXPECT_EQ(uri.message, vector.message);
+}
+
+LongUri uri_of(const Vector& vector) {
+    LongUri uri;
+    uri.has_authority = !vector.authority.empty();
+    uri.authority = vector.authority;
+    uri.entity = vector.entity;
+    uri.version_major = vector.version_major;
+    uri.resource = vector.resource;
+    uri.instance = vector.instance;
+    uri.message = vector.message;
+    return uri;
+}
+
+void test_tck_vectors() {
+    for (const Vector& vector : TCK_VECTORS) {
+        EXPECT_EQ(serialize_long_uri(uri_of(vector)), vector.serialized);
+
+        LongUri uri;
+        EXPECT_EQ(parse_long_uri(vector.serialized, uri), true);
+        expect_fields(uri, vector);
+        EXPECT_EQ(uri.has_authority, !vector.authority.empty());
+    }
+}
+
+void test_parse_vectors() {
+    for (const Vector& vector : PARSE_VECTORS) {
+        LongUri uri;
+        bool parsed = parse_long_uri(vector.serialized, uri);
+        EXPECT_EQ(parsed, !uri.is_empty());
+        expect_fields(uri, vector);
+    }
+}
+
+void test_serialize_empty() {
+    EXPECT_EQ(serialize_long_uri(LongUri()), "");
+    // The entity name is stripped
+    LongUri uri;
+    uri.entity = " neelam ";
+    uri.version_major = 3;
+    EXPECT_EQ(serialize_long_uri(uri), "/neelam/3");
+}
+
+void test_scanner_crosses_blocks() {
+    std::string text(100, 'a');
+    text[0] = '/';
+    text[15] = '.';
+    text[16] = '#';
+    text[47] = '/';
+    text[99] = '#';
+    ByteClassScanner scanner(text, {'/', '#'});
+    EXPECT_EQ(scanner.next(), 0u);
+    EXPECT_EQ(scanner.next(), 16u);
+    EXPECT_EQ(scanner.next(), 47u);
+    EXPECT_EQ(scanner.next(), 99u);
+    EXPECT_EQ(scanner.next(), scanner.npos);
+}
+
+}  // namespace
+
+int main() {
+    test_tck_vectors();
+    test_parse_vectors();
+    test_serialize_empty();
+    test_scanner_crosses_blocks();
+    return uprotocol::tck::test::exit_code();
+}
@@ -0,0 +1,176 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string>
+#include <string_view>
+
+#include "expect.h"
+#include "micro_uri.h"
+
+using uprotocol::tck::AddressType;
+using uprotocol::tck::decode_micro_uri;
+using uprotocol::tck::encode_micro_uri;
+using uprotocol::tck::local_micro_uri;
+using uprotocol::tck::MAX_MICRO_URI_LENGTH;
+using uprotocol::tck::MicroUri;
+using uprotocol::tck::MicroUriTable;
+using namespace std::string_view_literals;
+
+namespace {
+
+struct Vector {
+    std::string_view authority_id;
+    uint16_t entity_id;
+    uint8_t version_major;
+    uint16_t resource_id;
+    std::string_view serialized;
+};
+
+// The examples of micro_uri_serializer.feature and micro_uri_deserializer.feature, their base64 decoded
+constexpr Vector TCK_VECTORS[] = {
+    {"", 1, 0, 1, "\x01\x00\x00\x01\x00\x01\x00\x00"sv},
+    {"", 1, 1, 1, "\x01\x00\x00\x01\x00\x01\x01\x00"sv},
+    {"", 2, 1, 3, "\x01\x00\x00\x03\x00\x02\x01\x00"sv},
+    {"", 0, 0, 0, "\x01\x00\x00\x00\x00\x00\x00\x00"sv},
+    {"", 100, 1, 300, "\x01\x00\x01\x2c\x00\x64\x01\x00"sv},
+    {"", 255, 0, 255, "\x01\x00\x00\xff\x00\xff\x00\x00"sv},
+    {"", 256, 1, 256, "\x01\x00\x01\x00\x01\x00\x01\x00"sv},
+    {"unique id 1234", 29999, 254, 99,
+     "\x01\x03\x00\x63\x75\x2f\xfe\x00\x0e\x75\x6e\x69\x71\x75\x65\x20\x69\x64\x20\x31\x32\x33\x34"sv},
+};
+
+// Well-known topics encoded at compile time, so the vectors are checked by the compiler as well
+static_assert(local_micro_uri(100, 1, 300).view() == TCK_VECTORS[4].serialized);
+static_assert(local_micro_uri(256, 1, 256).view() == TCK_VECTORS[6].serialized);
+
+constexpr bool decodes_at_compile_time(const Vector& vector) {
+    MicroUri uri;
+    return decode_micro_uri(vector.serialized, uri) && uri.entity_id == vector.entity_id &&
+           uri.version_major == vector.version_major && uri.resource_id == vector.resource_id &&
+           uri.authority == vector.authority_id;
+}
+static_assert(decodes_at_compile_time(TCK_VECTORS[5]));
+static_assert(decodes_at_compile_time(TCK_VECTORS[7]));
+
+// Bytes MicroUriSerializer.deserialize answers with the empty UUri
+constexpr std::string_view INVALID_MICRO_URIS[] = {
+    ""sv,
+    "\x01\x00\x00\x01\x00\x01\x00"sv,
+    // Version 2
+    "\x02\x00\x00\x01\x00\x01\x00\x00"sv,
+    // Address type 4
+    "\x01\x04\x00\x01\x00\x01\x00\x00"sv,
+    // Lengths that do not fit the address type
+    "\x01\x00\x00\x01\x00\x01\x00\x00\x00"sv,
+    "\x01\x01\x00\x01\x00\x01\x00\x00\xc0\xa8\x01"sv,
+    "\x01\x02\x00\x01\x00\x01\x00\x00\xc0\xa8\x01\x01"sv,
+    "\x01\x03\x00\x01\x00\x01\x00\x00"sv,
+    "\x01\x03\x00\x01\x00\x01\x00\x00\x02\x41"sv,
+    "\x01\x03\x00\x01\x00\x01\x00\x00\x01\x41\x42"sv,
+};
+
+constexpr MicroUriTable<int, 4> ROUTES({{
+    {local_micro_uri(0x1234, 1, 0x8001), 1},
+    {local_micro_uri(0x0001, 2, 0x8000), 2},
+    {local_micro_uri(0x1234, 1, 0x8000), 0},
+    {local_micro_uri(0xffff, 255, 0xffff), 3},
+}});
+static_assert(*ROUTES.find(local_micro_uri(0x1234, 1, 0x8000).view()) == 0);
+static_assert(ROUTES.find(local_micro_uri(0x1234, 2, 0x8000).view()) == nullptr);
+
+std::string encoded(const MicroUri& uri) {
+    char out[MAX_MICRO_URI_LENGTH];
+    return std::string(out, encode_micro_uri(uri, out));
+}
+
+void test_tck_vectors() {
+    for (const Vector& vector : TCK_VECTORS) {
+        MicroUri uri;
+        uri.address_type = vector.authority_id.empty() ? AddressType::Local : AddressType::Id;
+        uri.authority = vector.authority_id;
+        uri.entity_id = vector.entity_id;
+        uri.version_major = vector.version_major;
+        uri.resource_id = vector.resource_id;
+        EXPECT_EQ(encoded(uri), vector.serialized);
+
+        MicroUri decoded;
+        EXPECT_EQ(decode_micro_uri(vector.serialized, decoded), true);
+        EXPECT_EQ(static_cast<int>(decoded.address_type), static_cast<int>(uri.address_type));
+        EXPECT_EQ(decoded.authority, vector.authority_id);
+        EXPECT_EQ(decoded.entity_id, vector.entity_id);
+        EXPECT_EQ(static_cast<int>(decoded.version_major), static_cast<int>(vector.version_major));
+        EXPECT_EQ(decoded.resource_id, vector.resource_id);
+    }
+}
+
+void test_ip_addresses() {
+    MicroUri uri;
+    uri.address_type = AddressType::IPv4;
+    uri.authority = "\xc0\xa8\x01\x64"sv;
+    uri.entity_id = 0x0102;
+    uri.resource_id = 0x0304;
+    std::string ipv4 = encoded(uri);
+    EXPECT_EQ(ipv4, "\x01\x01\x03\x04\x01\x02\x00\x00\xc0\xa8\x01\x64"sv);
+    MicroUri decoded;
+    EXPECT_EQ(decode_micro_uri(ipv4, decoded), true);
+    EXPECT_EQ(decoded.authority, uri.authority);
+
+    uri.address_type = AddressType::IPv6;
+    uri.authority = "\x20\x01\x0d\xb8\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01"sv;
+    std::string ipv6 = encoded(uri);
+    EXPECT_EQ(ipv6.size(), 24u);
+    EXPECT_EQ(decode_micro_uri(ipv6, decoded), true);
+    EXPECT_EQ(static_cast<int>(decoded.address_type), static_cast<int>(AddressType::IPv6));
+    EXPECT_EQ(decoded.authority, uri.authority);
+
+    // An address of the wrong length has no micro form
+    uri.authority = "\xc0\xa8\x01\x64"sv;
+    EXPECT_EQ(encoded(uri), "");
+}
+
+void test_invalid_micro_uris() {
+    for (std::string_view bytes : INVALID_MICRO_URIS) {
+        MicroUri uri;
+        EXPECT_EQ(decode_micro_uri(bytes, uri), false);
+        EXPECT_EQ(uri.entity_id, 0);
+        EXPECT_EQ(uri.resource_id, 0);
+        EXPECT_EQ(uri.authority, "");
+    }
+}
+
+void test_routing_table() {
+    EXPECT_EQ(*ROUTES.find(local_micro_uri(0x1234, 1, 0x8001).view()), 1);
+    EXPECT_EQ(*ROUTES.find(local_micro_uri(0x0001, 2, 0x8000).view()), 2);
+    EXPECT_EQ(*ROUTES.find(local_micro_uri(0xffff, 255, 0xffff).view()), 3);
+    EXPECT_EQ(ROUTES.find(TCK_VECTORS[0].serialized) == nullptr, true);
+    // Only local micro forms are routed
+    EXPECT_EQ(ROUTES.find(TCK_VECTORS[7].serialized) == nullptr, true);
+}
+
+}  // namespace
+
+int main() {
+    test_tck_vectors();
+    test_ip_addresses();
+    test_invalid_micro_uris();
+    test_routing_table();
+    return uprotocol::tck::test::exit_code();
+}
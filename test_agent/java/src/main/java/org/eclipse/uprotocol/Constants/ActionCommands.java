@@ -37,5 +37,9 @@ public class ActionCommands {
     public static final String VALIDATE_UATTRIBUTES = "uattributes_validate";
     public static final String MICRO_SERIALIZE_URI = "micro_serialize_uri";
     public static final String MICRO_DESERIALIZE_URI = "micro_deserialize_uri";
+    public static final String ADVANCE_CLOCK_COMMAND = "advance_clock";
+    public static final String PROFILE_COMMAND = "profile";
+    public static final String GET_STATS_COMMAND = "get_stats";
+    public static final String RUN_VECTORS_COMMAND = "run_vectors";
 
 }
@@ -28,5 +28,7 @@ public class Constant {
     public static final String TEST_MANAGER_IP = "127.0.0.5";
     public static final int TEST_MANAGER_PORT = 12345;
     public static final int BYTES_MSG_LENGTH = 32767;
+    public static final String SDK_NAME = "java";
+    public static final String INSTANCE_SEPARATOR = "#";
 
 }
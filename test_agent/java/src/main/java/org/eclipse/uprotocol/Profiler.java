@@ -0,0 +1,100 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import jdk.jfr.Recording;
+import jdk.jfr.consumer.RecordedEvent;
+import jdk.jfr.consumer.RecordedFrame;
+import jdk.jfr.consumer.RecordedMethod;
+import jdk.jfr.consumer.RecordedStackTrace;
+import jdk.jfr.consumer.RecordedThread;
+import jdk.jfr.consumer.RecordingFile;
+
+import java.io.IOException;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.time.Duration;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * Samples the stacks of the Test Agent with Java Flight Recorder.
+ */
+final class Profiler {
+    private static final Duration SAMPLE_PERIOD = Duration.ofMillis(5);
+
+    private Profiler() {
+    }
+
+    /**
+     * Records execution samples for the given duration and counts them as collapsed stacks, i.e. the thread name
+     * and the frames from the outermost to the innermost separated by semicolons, as read by flamegraph tools.
+     *
+     * @param durationMs How long to sample.
+     * @return Collapsed stack -> number of samples.
+     * @throws IOException          If the recording cannot be written or read.
+     * @throws InterruptedException If interrupted while sampling.
+     */
+    static Map<String, Long> sampleStacks(long durationMs) throws IOException, InterruptedException {
+        Path recordingFile = Files.createTempFile("tck-test-agent-profile", ".jfr");
+        try (Recording recording = new Recording()) {
+            recording.enable("jdk.ExecutionSample").withPeriod(SAMPLE_PERIOD).withStackTrace();
+            recording.enable("jdk.NativeMethodSample").withPeriod(SAMPLE_PERIOD).withStackTrace();
+            recording.start();
+            Thread.sleep(durationMs);
+            recording.stop();
+            recording.dump(recordingFile);
+
+            Map<String, Long> stacks = new HashMap<>();
+            for (RecordedEvent event : RecordingFile.readAllEvents(recordingFile)) {
+                RecordedStackTrace stackTrace = event.getStackTrace();
+                if (stackTrace == null) {
+                    continue;
+                }
+                stacks.merge(collapse(event.getThread("sampledThread"), stackTrace.getFrames()), 1L, Long::sum);
+            }
+            return stacks;
+        } finally {
+            Files.deleteIfExists(recordingFile);
+        }
+    }
+
+    private static String collapse(RecordedThread thread, List<RecordedFrame> frames) {
+        StringBuilder stack = new StringBuilder(thread != null ? String.valueOf(thread.getJavaName()) : "unknown");
+        // JFR lists the innermost frame first
+        for (int i = frames.size() - 1; i >= 0; i--) {
+            RecordedMethod method = frames.get(i).getMethod();
+            stack.append(';').append(method.getType().getName()).append('.').append(method.getName());
+        }
+        return stack.toString();
+    }
+
+    /**
+     * Formats collapsed stacks one per line, followed by their number of samples.
+     */
+    static String format(Map<String, Long> stacks) {
+        StringBuilder collapsed = new StringBuilder();
+        stacks.forEach((stack, count) -> collapsed.append(stack).append(' ').append(count).append('\n'));
+        return collapsed.toString();
+    }
+}
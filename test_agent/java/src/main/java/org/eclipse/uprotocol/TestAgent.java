@@ -22,6 +22,8 @@
 package org.eclipse.uprotocol;
 
 import com.google.gson.Gson;
+import com.google.gson.JsonParseException;
+import com.google.gson.JsonStreamParser;
 import com.google.protobuf.Any;
 import com.google.protobuf.Message;
 import com.google.protobuf.StringValue;
@@ -42,26 +44,46 @@ import org.eclipse.uprotocol.v1.*;
 import org.json.JSONObject;
 
 import java.io.IOException;
-import java.io.InputStream;
+import java.io.InputStreamReader;
 import java.io.OutputStream;
 import java.io.UnsupportedEncodingException;
+import java.lang.management.ManagementFactory;
 import java.net.Socket;
 import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.time.Duration;
 import java.time.Instant;
+import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.HashMap;
+import java.util.List;
 import java.util.Map;
 import java.util.concurrent.CompletionStage;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.TimeoutException;
 import java.util.function.Function;
 import java.util.logging.Level;
 import java.util.logging.Logger;
 
 public class TestAgent {
-    private static final Socket clientSocket;
-    private static final SocketUTransport transport;
+    private static Socket clientSocket;
+    private static SocketUTransport transport;
     private static final Map<String, ActionHandler> actionHandlers = new HashMap<>();
     private static final Logger logger = Logger.getLogger("JavaTestAgent");
     private static final UListener listener = TestAgent::handleOnReceive;
     private static final Gson gson = new Gson();
+    // Responses to the TM are written from command handlers, listeners and RPC callbacks alike
+    private static final Object tmSocketLock = new Object();
+    private static String instanceId = "";
+    private static String testAgentName = Constant.SDK_NAME;
+    // Runs command handlers, listener callbacks and RPC callbacks, null to handle commands one by one
+    private static ExecutorService executor;
+    // Times out RPC requests when the TM advances it, null to time them out in real time
+    private static VirtualClock clock;
+    // Attributes with a ttl of 1 ms get an id this old, so that they are expired when validated without waiting
+    private static final Duration EXPIRED_ID_AGE = Duration.ofMillis(800);
 
     static {
         actionHandlers.put(ActionCommands.SEND_COMMAND, TestAgent::handleSendCommand);
@@ -70,6 +92,7 @@ public class TestAgent {
         actionHandlers.put(ActionCommands.INVOKE_METHOD_COMMAND, TestAgent::handleInvokeMethodCommand);
         actionHandlers.put(ActionCommands.SERIALIZE_URI, TestAgent::handleLongSerializeUriCommand);
         actionHandlers.put(ActionCommands.DESERIALIZE_URI, TestAgent::handleLongDeserializeUriCommand);
+        actionHandlers.put(ActionCommands.RUN_VECTORS_COMMAND, TestAgent::handleRunVectorsCommand);
         actionHandlers.put(ActionCommands.VALIDATE_URI, TestAgent::handleValidateUriCommand);
         actionHandlers.put(ActionCommands.VALIDATE_UUID, TestAgent::handleValidateUuidCommand);
         actionHandlers.put(ActionCommands.SERIALIZE_UUID, TestAgent::handleLongSerializeUuidCommand);
@@ -77,16 +100,29 @@ public class TestAgent {
         actionHandlers.put(ActionCommands.VALIDATE_UATTRIBUTES, TestAgent::handleUAttributesValidateCommand);
         actionHandlers.put(ActionCommands.MICRO_SERIALIZE_URI, TestAgent::handleMicroSerializeUuriCommand);
         actionHandlers.put(ActionCommands.MICRO_DESERIALIZE_URI, TestAgent::handleMicroDeserializeUuriCommand);
+        actionHandlers.put(ActionCommands.ADVANCE_CLOCK_COMMAND, TestAgent::handleAdvanceClockCommand);
+        actionHandlers.put(ActionCommands.PROFILE_COMMAND, TestAgent::handleProfileCommand);
+        actionHandlers.put(ActionCommands.GET_STATS_COMMAND, TestAgent::handleGetStatsCommand);
     }
 
-    static {
-        try {
-            transport = new SocketUTransport();
-            clientSocket = new Socket(Constant.TEST_MANAGER_IP, Constant.TEST_MANAGER_PORT);
-        } catch (IOException e) {
-            throw new RuntimeException(e);
-        }
-    }
+    // Commands replayed by --cds-training, covering the classes loaded by the common test steps
+    private static final String[] TRAINING_COMMANDS = {
+            "{\"action\": \"uri_serialize\", \"data\": {\"authority\": {\"name\": \"vcu.my_car_vin\"}, "
+                    + "\"entity\": {\"name\": \"neelam\", \"version_major\": \"1\"}, "
+                    + "\"resource\": {\"name\": \"test\", \"instance\": \"front\", \"message\": \"Test\"}}}",
+            "{\"action\": \"uri_deserialize\", \"data\": \"//vcu.my_car_vin/neelam/1/test.front#Test\"}",
+            "{\"action\": \"uri_validate\", \"data\": {\"validation_type\": \"uri\", "
+                    + "\"uuri\": {\"entity\": {\"name\": \"neelam\"}}}}",
+            "{\"action\": \"micro_serialize_uri\", \"data\": {\"entity\": {\"id\": \"1\", "
+                    + "\"version_major\": \"1\"}, \"resource\": {\"id\": \"2\"}}}",
+            "{\"action\": \"uuid_validate\", \"data\": {\"uuid_type\": \"uprotocol\", "
+                    + "\"validator_type\": \"get_validator\"}}",
+            "{\"action\": \"uuid_serialize\", \"data\": {\"msb\": \"1\", \"lsb\": \"2\"}}",
+            "{\"action\": \"uuid_deserialize\", \"data\": \"00000000-0000-0001-0000-000000000002\"}",
+            "{\"action\": \"uattributes_validate\", \"data\": {\"validation_method\": \"publish\", "
+                    + "\"attributes\": {\"type\": \"UMESSAGE_TYPE_PUBLISH\", \"priority\": \"UPRIORITY_CS1\"}, "
+                    + "\"id\": \"uprotocol\"}}",
+    };
 
     public static void processMessage(Map<String, Object> jsonData) throws IOException {
         String action = (String) jsonData.get("action");
@@ -127,11 +163,18 @@ public class TestAgent {
 
     private static void writeDataToTMSocket(JSONObject responseDict, String action) {
         responseDict.put("action", action);
-        responseDict.put("ue", "java");
+        responseDict.put("ue", testAgentName);
+        if (clientSocket == null) {
+            // Replayed training commands have no Test Manager to answer
+            return;
+        }
         try {
-            OutputStream outputStream = clientSocket.getOutputStream();
-            outputStream.write(responseDict.toString().getBytes(StandardCharsets.UTF_8));
-            outputStream.flush();
+            byte[] response = responseDict.toString().getBytes(StandardCharsets.UTF_8);
+            synchronized (tmSocketLock) {
+                OutputStream outputStream = clientSocket.getOutputStream();
+                outputStream.write(response);
+                outputStream.flush();
+            }
             logger.info("Sent to TM: " + responseDict);
 
         } catch (IOException ioException) {
@@ -164,14 +207,91 @@ public class TestAgent {
         UUri uri = (UUri) ProtoConverter.dictToProto(data, UUri.newBuilder());
         UPayload payload = (UPayload) ProtoConverter.dictToProto((Map<String, Object>) data.get("payload"),
                 UPayload.newBuilder());
+        int ttl = Integer.parseInt(data.getOrDefault("ttl", "10000").toString());
         CompletionStage<UMessage> responseFuture = transport.invokeMethod(uri, payload,
-                CallOptions.newBuilder().setTtl(10000).build());
+                CallOptions.newBuilder().setTtl(ttl).build());
         responseFuture.whenComplete((responseMessage, exception) -> {
-            sendToTestManager(responseMessage, ActionCommands.INVOKE_METHOD_COMMAND, (String) jsonData.get("test_id"));
+            String testID = (String) jsonData.get("test_id");
+            if (exception != null) {
+                UCode code = exception instanceof TimeoutException || exception.getCause() instanceof TimeoutException
+                        ? UCode.DEADLINE_EXCEEDED : UCode.INTERNAL;
+                sendToTestManager(UStatus.newBuilder().setCode(code).setMessage(String.valueOf(exception.getMessage()))
+                        .build(), ActionCommands.INVOKE_METHOD_COMMAND, testID);
+            } else {
+                sendToTestManager(responseMessage, ActionCommands.INVOKE_METHOD_COMMAND, testID);
+            }
         });
         return null;
     }
 
+    private static UStatus handleAdvanceClockCommand(Map<String, Object> jsonData) {
+        if (clock == null) {
+            return UStatus.newBuilder().setCode(UCode.FAILED_PRECONDITION)
+                    .setMessage("Test Agent does not run on a virtual clock").build();
+        }
+        Map<String, Object> data = (Map<String, Object>) jsonData.get("data");
+        clock.advance(Long.parseLong(data.get("ms").toString()));
+        return UStatus.newBuilder().setCode(UCode.OK).setMessage("OK").build();
+    }
+
+    private static Object handleGetStatsCommand(Map<String, Object> jsonData) {
+        Map<String, Object> stats = transport.getStats();
+        long cpuNs = processCpuNs();
+        if (cpuNs >= 0) {
+            stats.put("cpu_s", cpuNs / 1e9);
+        }
+        stats.put("rss_bytes", currentRssBytes());
+        sendToTestManager(stats, ActionCommands.GET_STATS_COMMAND, (String) jsonData.get("test_id"));
+        return null;
+    }
+
+    private static long processCpuNs() {
+        java.lang.management.OperatingSystemMXBean os = ManagementFactory.getOperatingSystemMXBean();
+        return os instanceof com.sun.management.OperatingSystemMXBean
+                ? ((com.sun.management.OperatingSystemMXBean) os).getProcessCpuTime() : -1;
+    }
+
+    /**
+     * Returns the resident set size of the Test Agent, the used heap where the operating system does not tell.
+     */
+    private static long currentRssBytes() {
+        try {
+            for (String line : Files.readAllLines(Path.of("/proc/self/status"))) {
+                if (line.startsWith("VmRSS:")) {
+                    return Long.parseLong(line.replaceAll("[^0-9]", "")) * 1024;
+                }
+            }
+        } catch (IOException | NumberFormatException e) {
+            logger.fine("No resident set size available: " + e.getMessage());
+        }
+        Runtime runtime = Runtime.getRuntime();
+        return runtime.totalMemory() - runtime.freeMemory();
+    }
+
+    private static Object handleProfileCommand(Map<String, Object> jsonData) {
+        Map<String, Object> data = (Map<String, Object>) jsonData.get("data");
+        long durationMs = Long.parseLong(data.getOrDefault("duration_ms", "1000").toString());
+        String testID = (String) jsonData.get("test_id");
+        // Samples on a thread of its own, so that the commands to profile keep being processed
+        Thread profiler = new Thread(() -> {
+            try {
+                Map<String, Long> stacks = Profiler.sampleStacks(durationMs);
+                Map<String, Object> profile = new HashMap<>();
+                profile.put("format", "collapsed");
+                profile.put("collapsed", Profiler.format(stacks));
+                profile.put("samples", stacks.values().stream().mapToLong(Long::longValue).sum());
+                sendToTestManager(profile, ActionCommands.PROFILE_COMMAND, testID);
+            } catch (IOException | InterruptedException e) {
+                logger.log(Level.SEVERE, "Profiling failed: " + e.getMessage(), e);
+                sendToTestManager(UStatus.newBuilder().setCode(UCode.INTERNAL).setMessage(String.valueOf(e.getMessage()))
+                        .build(), ActionCommands.PROFILE_COMMAND, testID);
+            }
+        }, "profiler");
+        profiler.setDaemon(true);
+        profiler.start();
+        return null;
+    }
+
     private static Object handleLongSerializeUriCommand(Map<String, Object> jsonData) {
         Map<String, Object> data = (Map<String, Object>) jsonData.get("data");
         UUri uri = (UUri) ProtoConverter.dictToProto(data, UUri.newBuilder());
@@ -188,6 +308,66 @@ public class TestAgent {
         return null;
     }
 
+    /**
+     * Runs a serializer over all "inputs" "repeat" times and answers with the results of the first pass and the
+     * operations per second of all passes, so serializers are compared without a round trip per operation.
+     */
+    private static Object handleRunVectorsCommand(Map<String, Object> jsonData) {
+        Map<String, Object> data = (Map<String, Object>) jsonData.get("data");
+        String action = (String) data.get("action");
+        long repeat = Math.max(Long.parseLong(data.getOrDefault("repeat", "1").toString()), 1);
+        List<Object> inputs = (List<Object>) data.get("inputs");
+        LongUriSerializer serializer = LongUriSerializer.instance();
+        MicroUriSerializer microSerializer = MicroUriSerializer.instance();
+        Function<Object, Object> operation;
+        List<Object> results = new ArrayList<>();
+        List<Object> vectors = new ArrayList<>();
+        if (ActionCommands.SERIALIZE_URI.equals(action)) {
+            for (Object input : inputs) {
+                vectors.add(ProtoConverter.dictToProto((Map<String, Object>) input, UUri.newBuilder()));
+            }
+            operation = uri -> serializer.serialize((UUri) uri);
+            vectors.forEach(uri -> results.add(operation.apply(uri)));
+        } else if (ActionCommands.DESERIALIZE_URI.equals(action)) {
+            vectors.addAll(inputs);
+            operation = uri -> serializer.deserialize((String) uri);
+            vectors.forEach(uri -> results.add(ProtoConverter.convertMessageToMap((UUri) operation.apply(uri))));
+        } else if (ActionCommands.MICRO_SERIALIZE_URI.equals(action)) {
+            for (Object input : inputs) {
+                vectors.add(ProtoConverter.dictToProto((Map<String, Object>) input, UUri.newBuilder()));
+            }
+            operation = uri -> microSerializer.serialize((UUri) uri);
+            vectors.forEach(uri -> results.add(
+                    new String((byte[]) operation.apply(uri), StandardCharsets.ISO_8859_1)));
+        } else if (ActionCommands.MICRO_DESERIALIZE_URI.equals(action)) {
+            for (Object input : inputs) {
+                vectors.add(((String) input).getBytes(StandardCharsets.ISO_8859_1));
+            }
+            operation = uri -> microSerializer.deserialize((byte[]) uri);
+            vectors.forEach(uri -> results.add(ProtoConverter.convertMessageToMap((UUri) operation.apply(uri))));
+        } else {
+            return UStatus.newBuilder().setCode(UCode.INVALID_ARGUMENT)
+                    .setMessage("run_vectors runs a uri or micro uri serializer").build();
+        }
+
+        long startNs = System.nanoTime();
+        for (long pass = 0; pass < repeat; pass++) {
+            for (Object vector : vectors) {
+                operation.apply(vector);
+            }
+        }
+        long elapsedNs = System.nanoTime() - startNs;
+        long ops = repeat * vectors.size();
+        Map<String, Object> response = new HashMap<>();
+        response.put("action", action);
+        response.put("results", results);
+        response.put("ops", ops);
+        response.put("elapsed_ns", elapsedNs);
+        response.put("ops_per_s", elapsedNs > 0 ? ops * 1e9 / elapsedNs : 0.0);
+        sendToTestManager(response, ActionCommands.RUN_VECTORS_COMMAND, (String) jsonData.get("test_id"));
+        return null;
+    }
+
     private static Object handleValidateUriCommand(Map<String, Object> jsonData) {
         Map<String, Object> data = (Map<String, Object>) jsonData.get("data");
         String valType = (String) data.get("validation_type");
@@ -253,10 +433,13 @@ public class TestAgent {
             attributes = UAttributes.newBuilder().build();
         }
 
+        Instant createdAt = attributes.getTtl() == 1 ? Instant.now().minus(EXPIRED_ID_AGE) : Instant.now();
         if ("uprotocol".equals(data.get("id"))) {
-            attributes = attributes.toBuilder().setId(UuidFactory.Factories.UPROTOCOL.factory().create()).build();
+            attributes = attributes.toBuilder().setId(UuidFactory.Factories.UPROTOCOL.factory().create(createdAt))
+                    .build();
         } else if ("uuid".equals(data.get("id"))) {
-            attributes = attributes.toBuilder().setId(UuidFactory.Factories.UUIDV6.factory().create()).build();
+            attributes = attributes.toBuilder().setId(UuidFactory.Factories.UUIDV6.factory().create(createdAt))
+                    .build();
         }
 
         if ("uprotocol".equals(data.get("reqid"))) {
@@ -274,14 +457,6 @@ public class TestAgent {
         UAttributesValidator res_val = UAttributesValidator.Validators.RESPONSE.validator();
         UAttributesValidator not_val = UAttributesValidator.Validators.NOTIFICATION.validator();
 
-        if (attributes != null && attributes.getTtl() == 1) {
-            try {
-                Thread.sleep(800);
-            } catch (InterruptedException e) {
-                e.printStackTrace();
-            }
-        }
-
         if (valType.equals("get_validator")) {
             str_result = UAttributesValidator.getValidator(attributes).toString();
         }
@@ -518,34 +693,106 @@ public class TestAgent {
     }
 
     public static void main(String[] args) throws IOException {
+        if (Arrays.asList(args).contains("--cds-training")) {
+            runCdsTraining();
+            return;
+        }
+        transport = new SocketUTransport();
+        clientSocket = new Socket(Constant.TEST_MANAGER_IP, Constant.TEST_MANAGER_PORT);
+        parseArgs(args);
         Thread receiveThread = new Thread(TestAgent::receiveFromTM);
         receiveThread.start();
         JSONObject obj = new JSONObject();
-        obj.put("SDK_name", "java");
+        obj.put("SDK_name", Constant.SDK_NAME);
+        obj.put("instance_id", instanceId);
+        obj.put("execution_model", executor != null ? "virtual-threads" : "platform-threads");
         sendToTestManager(obj, "initialize");
     }
 
-    public static void receiveFromTM() {
-        try {
-            while (true) {
-                byte[] buffer = new byte[Constant.BYTES_MSG_LENGTH];
-                InputStream inputStream = clientSocket.getInputStream();
-                int readSize = inputStream.read(buffer);
-                if (readSize < 1) {
-                    return;
+    /**
+     * Reads the command line options passed by the Test Manager, e.g. "--transport socket --instance-id 7".
+     * Unknown options are ignored.
+     *
+     * @param args The command line arguments.
+     */
+    private static void parseArgs(String[] args) {
+        for (int i = 0; i < args.length; i++) {
+            if ("--instance-id".equals(args[i]) && i + 1 < args.length) {
+                instanceId = args[i + 1];
+                testAgentName = Constant.SDK_NAME + Constant.INSTANCE_SEPARATOR + instanceId;
+            } else if ("--shm-payloads".equals(args[i])) {
+                // Send large payloads by reference through shared memory
+                try {
+                    transport.setPayloadStore(new SharedMemoryPayloadStore());
+                } catch (IOException e) {
+                    logger.log(Level.SEVERE, "Shared memory payloads are not available", e);
                 }
+            } else if ("--virtual-clock".equals(args[i])) {
+                // Time out RPC requests only when the TM advances the clock
+                clock = new VirtualClock();
+                transport.setClock(clock);
+            } else if ("--virtual-threads".equals(args[i])) {
+                executor = newVirtualThreadExecutor();
+                if (executor != null) {
+                    transport.setCallbackExecutor(executor);
+                }
+            }
+        }
+    }
+
+    /**
+     * Returns an executor starting a virtual thread per task, or null before JDK 21.
+     * It is looked up reflectively, so the agent still builds and runs on older JDKs.
+     */
+    private static ExecutorService newVirtualThreadExecutor() {
+        try {
+            return (ExecutorService) Executors.class.getMethod("newVirtualThreadPerTaskExecutor").invoke(null);
+        } catch (ReflectiveOperationException e) {
+            logger.warning("Virtual threads need JDK 21 or newer, running on platform threads");
+            return null;
+        }
+    }
 
-                String jsonData = new String(buffer, 0, readSize);
+    /**
+     * Replays typical commands without connecting to the Test Manager or the Dispatcher, so that a run with
+     * -XX:ArchiveClassesAtExit archives the classes of protobuf, Gson, org.json and the uProtocol SDK that the agent
+     * loads on startup and in its first test steps.
+     */
+    private static void runCdsTraining() {
+        logger.info("Loading " + SocketUTransport.class.getName() + " and replaying " + TRAINING_COMMANDS.length
+                + " commands for the class data sharing archive");
+        for (String command : TRAINING_COMMANDS) {
+            processCommand(gson.fromJson(command, Map.class));
+        }
+    }
 
-                // Parse the JSON string using Gson
-                Map<String, Object> jsonMap = gson.fromJson(jsonData, Map.class);
-                processMessage(jsonMap);
+    public static void receiveFromTM() {
+        try {
+            // A read may hold several commands sent back to back, or part of one
+            JsonStreamParser parser = new JsonStreamParser(
+                    new InputStreamReader(clientSocket.getInputStream(), StandardCharsets.UTF_8));
+            while (parser.hasNext()) {
+                Map<String, Object> jsonMap = gson.fromJson(parser.next(), Map.class);
+                if (executor != null) {
+                    // Commands run concurrently, so a blocking one does not hold up the next
+                    executor.execute(() -> processCommand(jsonMap));
+                } else {
+                    processMessage(jsonMap);
+                }
             }
-        } catch (IOException e) {
+        } catch (IOException | JsonParseException e) {
             e.printStackTrace();
         }
     }
 
+    private static void processCommand(Map<String, Object> jsonData) {
+        try {
+            processMessage(jsonData);
+        } catch (IOException | RuntimeException e) {
+            logger.log(Level.SEVERE, "Error while handling command: " + e.getMessage(), e);
+        }
+    }
+
     @FunctionalInterface
     private interface ActionHandler {
         Object handle(Map<String, Object> jsonData);
@@ -0,0 +1,106 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import argparse
+import importlib
+import json
+import logging
+import os
+import signal
+import socket
+import sys
+
+import testagent
+
+logger = logging.getLogger("File:Line# Debugger")
+
+# Imported lazily by the command handlers of the Test Agent, a forked Test Agent finds them already imported
+PRELOADED_MODULES = (
+    "uprotocol.transport.validate.uattributesvalidator",
+    "uprotocol.uri.serializer.longuriserializer",
+    "uprotocol.uri.serializer.microuriserializer",
+    "uprotocol.uri.validator.urivalidator",
+    "uprotocol.uuid.factory.uuidutils",
+    "uprotocol.uuid.serializer.longuuidserializer",
+    "uprotocol.uuid.validate.uuidvalidator",
+    "uprotocol.validation.validationresult",
+)
+
+
+def run_forked_test_agent(argv, cpus=None):
+    """Runs in the forked child, which must never return into the server loop"""
+    exit_code: int = 0
+    try:
+        signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+        signal.signal(signal.SIGTERM, signal.SIG_DFL)
+        if cpus:
+            # Pinned before the Test Agent starts its threads, which inherit the CPUs
+            os.sched_setaffinity(0, cpus)
+        testagent.run(argv).join()
+    except Exception as e:
+        logger.error(f"Forked Test Agent failed: {e}")
+        exit_code = 1
+    finally:
+        os._exit(exit_code)
+
+
+def serve(address: str):
+    """
+    Accepts one request per connection, a JSON line such as {"argv": ["--instance-id", "7"], "cpus": [3]}.
+    Forks a Test Agent with these command line options, pinned to the optional CPUs, and answers with a JSON line
+    such as {"pid": 4242}.
+
+    :param address: Path of the Unix domain socket to listen on.
+    """
+    # Forked Test Agents are reaped by the kernel, the Test Manager terminates them by pid
+    signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+
+    if os.path.exists(address):
+        os.unlink(address)
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        server.bind(address)
+        server.listen()
+        while True:
+            connection, _ = server.accept()
+            with connection:
+                request = json.loads(connection.makefile("r").readline())
+                pid: int = os.fork()
+                if pid == 0:
+                    server.close()
+                    connection.close()
+                    run_forked_test_agent(request["argv"], request.get("cpus"))
+                connection.sendall((json.dumps({"pid": pid}) + "\n").encode("utf-8"))
+    finally:
+        server.close()
+        if os.path.exists(address):
+            os.unlink(address)
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Forks ready Python Test Agents on request")
+    parser.add_argument("--socket", required=True, help="Path of the Unix domain socket to listen on")
+    args, _ = parser.parse_known_args()
+    return args
+
+
+if __name__ == "__main__":
+    args = parse_args()
+    for module in PRELOADED_MODULES:
+        importlib.import_module(module)
+    serve(args.socket)
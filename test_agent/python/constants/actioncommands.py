@@ -30,3 +30,11 @@ DESERIALIZE_UUID = "uuid_deserialize"
 VALIDATE_UATTRIBUTES = "uattributes_validate"
 MICRO_SERIALIZE_URI = "micro_serialize_uri"
 MICRO_DESERIALIZE_URI = "micro_deserialize_uri"
+LOADGEN_COMMAND = "loadgen"
+BENCH_SUBSCRIBE_COMMAND = "bench_subscribe"
+BENCH_RESULTS_COMMAND = "bench_results"
+SLOW_SUBSCRIBE_COMMAND = "slow_subscribe"
+ADVANCE_CLOCK_COMMAND = "advance_clock"
+PROFILE_COMMAND = "profile"
+GET_STATS_COMMAND = "get_stats"
+RUN_VECTORS_COMMAND = "run_vectors"
@@ -26,3 +26,5 @@
 
 TEST_MANAGER_ADDR = ("127.0.0.5", 12345)
 BYTES_MSG_LENGTH: int = 32767
+SDK_NAME: str = "python"
+INSTANCE_SEPARATOR: str = "#"
@@ -0,0 +1,64 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import os
+import sys
+import threading
+import time
+from collections import Counter
+from typing import Dict
+
+# Samples per second, uneven so that sampling does not run in lockstep with periodic work
+SAMPLE_RATE_HZ: int = 199
+
+
+def frame_label(frame) -> str:
+    code = frame.f_code
+    return f"{code.co_name} ({os.path.basename(code.co_filename)}:{code.co_firstlineno})"
+
+
+def sample_stacks(duration_s: float, rate_hz: int = SAMPLE_RATE_HZ) -> Dict[str, int]:
+    """
+    Samples the stacks of all other threads for duration_s and counts them as collapsed stacks, i.e. the thread
+    name and the frames from the outermost to the innermost separated by semicolons, as read by flamegraph tools.
+
+    :param duration_s: How long to sample.
+    :param rate_hz: Samples per second.
+    :return: Collapsed stack -> number of samples.
+    """
+    own_thread_id: int = threading.get_ident()
+    interval_s: float = 1 / rate_hz
+    stacks: Counter = Counter()
+    deadline: float = time.perf_counter() + duration_s
+    while time.perf_counter() < deadline:
+        thread_names: Dict[int, str] = {thread.ident: thread.name for thread in threading.enumerate()}
+        for thread_id, frame in sys._current_frames().items():
+            if thread_id == own_thread_id:
+                continue
+            frames = []
+            while frame is not None:
+                frames.append(frame_label(frame))
+                frame = frame.f_back
+            frames.append(thread_names.get(thread_id, str(thread_id)))
+            stacks[";".join(reversed(frames))] += 1
+        time.sleep(interval_s)
+    return dict(stacks)
+
+
+def collapse(stacks: Dict[str, int]) -> str:
+    """Formats collapsed stacks one per line, followed by their number of samples"""
+    return "".join(f"{stack} {count}\n" for stack, count in stacks.items())
@@ -15,17 +15,21 @@ SPDX-FileType: SOURCE
 SPDX-License-Identifier: Apache-2.0
 """
 
+import argparse
+import codecs
 import json
 import logging
+import os
 import socket
+import struct
 import sys
 import time
 from concurrent.futures import Future
-from datetime import datetime, timezone
-from threading import Thread
-from typing import Any, Dict, List, Union
+from datetime import datetime, timedelta, timezone
+from threading import Lock, Thread
+from typing import Any, Dict, List, Optional, Union
 
-import git
+import profiler
 from constants import actioncommands, constants
 from google.protobuf import any_pb2
 from google.protobuf.descriptor import FieldDescriptor
@@ -44,26 +48,23 @@ from uprotocol.proto.ustatus_pb2 import UCode, UStatus
 from uprotocol.proto.uuid_pb2 import UUID
 from uprotocol.transport.builder.uattributesbuilder import UAttributesBuilder
 from uprotocol.transport.ulistener import UListener
-from uprotocol.transport.validate import uattributesvalidator
-from uprotocol.transport.validate.uattributesvalidator import (
-    UAttributesValidator,
-)
-from uprotocol.uri.serializer.longuriserializer import LongUriSerializer
-from uprotocol.uri.serializer.microuriserializer import MicroUriSerializer
-from uprotocol.uri.validator.urivalidator import UriValidator
 from uprotocol.uuid.factory.uuidfactory import Factories
-from uprotocol.uuid.factory.uuidutils import UUIDUtils
-from uprotocol.uuid.serializer.longuuidserializer import LongUuidSerializer
-from uprotocol.uuid.validate.uuidvalidator import UuidValidator, Validators
-from uprotocol.validation.validationresult import ValidationResult
 
-repo = git.Repo(".", search_parent_directories=True)
-sys.path.insert(0, repo.working_tree_dir)
+# The repository root, two levels above this file
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..")))
+from up_client_socket.python.clock import VirtualClock
+from up_client_socket.python.shm_payload_store import SharedMemoryPayloadStore
 from up_client_socket.python.socket_transport import SocketUTransport
 
 logging.basicConfig(format="%(levelname)s| %(filename)s:%(lineno)s %(message)s")
 logger = logging.getLogger("File:Line# Debugger")
 logger.setLevel(logging.DEBUG)
+# Send time in nanoseconds at the start of "loadgen" payloads
+LOADGEN_TIMESTAMP = struct.Struct(">Q")
+# Attributes with a ttl of 1 ms get an id this old, so that they are expired when validated without waiting
+EXPIRED_ID_AGE = timedelta(seconds=0.8)
+# Listener workers, the command, clock and profiler threads all answer the Test Manager, one message at a time
+ta_socket_lock = Lock()
 
 
 class SocketUListener(UListener):
@@ -90,6 +91,65 @@ class SocketUListener(UListener):
             send_to_test_manager(umsg, actioncommands.RESPONSE_ON_RECEIVE)
 
 
+class BenchmarkUListener(UListener):
+    """Counts received messages instead of forwarding each one to the Test Manager"""
+
+    def __init__(self):
+        self.lock = Lock()
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.count = 0
+            self.bytes = 0
+            self.first_receive_ns = 0
+            self.last_receive_ns = 0
+            self.latency_sum_ns = 0
+            self.latency_max_ns = 0
+            self.start_cpu_s = time.process_time()
+            self.cpu_s = 0.0
+
+    def on_receive(self, umsg: UMessage) -> None:
+        receive_ns = time.time_ns()
+        payload = umsg.payload.value
+        payload_length = len(payload)
+        # "loadgen" payloads start with their send time
+        latency_ns = (
+            receive_ns - LOADGEN_TIMESTAMP.unpack_from(payload)[0] if len(payload) >= LOADGEN_TIMESTAMP.size else 0
+        )
+        with self.lock:
+            if self.count == 0:
+                self.first_receive_ns = receive_ns
+            self.count += 1
+            self.bytes += payload_length
+            self.last_receive_ns = receive_ns
+            self.latency_sum_ns += latency_ns
+            self.latency_max_ns = max(self.latency_max_ns, latency_ns)
+            self.cpu_s = time.process_time() - self.start_cpu_s
+
+    def results(self) -> Dict[str, Any]:
+        with self.lock:
+            return {
+                "count": self.count,
+                "bytes": self.bytes,
+                "first_receive_ns": self.first_receive_ns,
+                "last_receive_ns": self.last_receive_ns,
+                "latency_sum_ns": self.latency_sum_ns,
+                "latency_max_ns": self.latency_max_ns,
+                "cpu_s": self.cpu_s,
+            }
+
+
+class SlowUListener(UListener):
+    """Takes delay_s to handle each message, e.g. to benchmark the listeners of other topics next to it"""
+
+    def __init__(self, delay_s: float):
+        self.delay_s = delay_s
+
+    def on_receive(self, umsg: UMessage) -> None:
+        time.sleep(self.delay_s)
+
+
 def message_to_dict(message: Message) -> Dict[str, Any]:
     """Converts protobuf Message to Dict and keeping respective data types
 
@@ -141,11 +201,12 @@ def send_to_test_manager(
     response_dict = {
         "data": response,
         "action": action,
-        "ue": "python",
+        "ue": test_agent_name,
         "test_id": received_test_id,
     }
     response_dict = json.dumps(response_dict).encode("utf-8")
-    ta_socket.sendall(response_dict)
+    with ta_socket_lock:
+        ta_socket.sendall(response_dict)
     logger.info(f"Sent to TM {response_dict}")
 
 
@@ -206,12 +267,18 @@ def handle_unregister_listener_command(json_msg):
 def handle_invoke_method_command(json_msg):
     uri = dict_to_proto(json_msg["data"], UUri())
     payload = dict_to_proto(json_msg["data"]["payload"], UPayload())
-    res_future: Future = transport.invoke_method(uri, payload, CallOptions(ttl=10000))
+    ttl = int(json_msg["data"].get("ttl", 10000))
+    res_future: Future = transport.invoke_method(uri, payload, CallOptions(ttl=ttl))
 
     def handle_response(message):
-        message: Message = message.result()
+        if isinstance(message.exception(), TimeoutError):
+            response = UStatus(code=UCode.DEADLINE_EXCEEDED, message=str(message.exception()))
+        elif message.exception() is not None:
+            response = UStatus(code=UCode.INTERNAL, message=str(message.exception()))
+        else:
+            response: Message = message.result()
         send_to_test_manager(
-            message,
+            response,
             actioncommands.INVOKE_METHOD_COMMAND,
             received_test_id=json_msg["test_id"],
         )
@@ -219,7 +286,124 @@ def handle_invoke_method_command(json_msg):
     res_future.add_done_callback(handle_response)
 
 
+def handle_loadgen_command(json_msg):
+    """Publishes count messages with payload_size byte payloads to topic and reports how long it took.
+    Payloads of at least 8 bytes start with their send time, so receivers can measure the latency.
+    The messages are batched into batch_bytes while the load runs, if set"""
+    data = json_msg["data"]
+    topic = dict_to_proto(data["topic"], UUri())
+    payload_size = int(data.get("payload_size", 0))
+    count = int(data.get("count", 1))
+    batch_bytes = int(data.get("batch_bytes", 0))
+    batch_delay_s = int(data.get("batch_delay_ms", 0)) / 1000
+    filler = bytes(max(payload_size - LOADGEN_TIMESTAMP.size, 0))
+
+    transport.session.set_batching(batch_bytes, batch_delay_s)
+    sent = 0
+    start_ns = time.time_ns()
+    start_cpu_s = time.process_time()
+    for _ in range(count):
+        value = LOADGEN_TIMESTAMP.pack(time.time_ns()) + filler if payload_size >= LOADGEN_TIMESTAMP.size else filler
+        payload = UPayload(value=value, format=UPayloadFormat.UPAYLOAD_FORMAT_RAW)
+        attributes = UAttributesBuilder.publish(topic, UPriority.UPRIORITY_CS1).build()
+        status: UStatus = transport.send(UMessage(attributes=attributes, payload=payload))
+        if status.code == UCode.OK:
+            sent += 1
+    transport.session.set_batching(0, 0.0)
+
+    send_to_test_manager(
+        {
+            "count": sent,
+            "bytes": sent * payload_size,
+            "start_ns": start_ns,
+            "elapsed_s": (time.time_ns() - start_ns) / 1e9,
+            "cpu_s": time.process_time() - start_cpu_s,
+        },
+        actioncommands.LOADGEN_COMMAND,
+        received_test_id=json_msg["test_id"],
+    )
+
+
+def handle_bench_subscribe_command(json_msg) -> UStatus:
+    uri = dict_to_proto(json_msg["data"], UUri())
+    # Registering again would count every message twice
+    transport.unregister_listener(uri, bench_listener)
+    bench_listener.reset()
+    return transport.register_listener(uri, bench_listener)
+
+
+def handle_slow_subscribe_command(json_msg) -> UStatus:
+    data = json_msg["data"]
+    uri = dict_to_proto(data["topic"], UUri())
+    # Subscribing again replaces the slow listener of the topic
+    previous = slow_listeners.pop(uri.SerializeToString(), None)
+    if previous is not None:
+        transport.unregister_listener(uri, previous)
+    slow_listener = SlowUListener(int(data.get("delay_ms", 0)) / 1000)
+    slow_listeners[uri.SerializeToString()] = slow_listener
+    return transport.register_listener(uri, slow_listener)
+
+
+def handle_advance_clock_command(json_msg) -> UStatus:
+    """Moves the virtual clock forward by "ms", which runs the timeouts due until then"""
+    if clock is None:
+        return UStatus(code=UCode.FAILED_PRECONDITION, message="Test Agent does not run on a virtual clock")
+    clock.advance(int(json_msg["data"]["ms"]) / 1000)
+    return UStatus(code=UCode.OK, message="OK")
+
+
+def handle_bench_results_command(json_msg):
+    results: Dict[str, Any] = bench_listener.results()
+    results["listener_dispatch"] = transport.session.dispatch_metrics()
+    send_to_test_manager(
+        results,
+        actioncommands.BENCH_RESULTS_COMMAND,
+        received_test_id=json_msg["test_id"],
+    )
+
+
+def current_rss_bytes() -> int:
+    """Returns the resident set size of the Test Agent, its peak where the current one is not available"""
+    try:
+        with open("/proc/self/statm") as statm:
+            return int(statm.read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+    except OSError:
+        import resource
+
+        max_rss: int = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+        # Linux reports kilobytes, macOS bytes
+        return max_rss if sys.platform == "darwin" else max_rss * 1024
+
+
+def handle_get_stats_command(json_msg):
+    stats: Dict[str, Any] = transport.session.get_stats()
+    stats["cpu_s"] = time.process_time()
+    stats["rss_bytes"] = current_rss_bytes()
+    send_to_test_manager(stats, actioncommands.GET_STATS_COMMAND, received_test_id=json_msg["test_id"])
+
+
+def handle_profile_command(json_msg):
+    """Samples the stacks of the Test Agent for "duration_ms" on a thread of its own, so that the commands to
+    profile keep being processed, and answers with the collapsed stacks"""
+    duration_s = int(json_msg["data"].get("duration_ms", 1000)) / 1000
+
+    def profile():
+        stacks: Dict[str, int] = profiler.sample_stacks(duration_s)
+        send_to_test_manager(
+            {"format": "collapsed", "collapsed": profiler.collapse(stacks), "samples": sum(stacks.values())},
+            actioncommands.PROFILE_COMMAND,
+            received_test_id=json_msg["test_id"],
+        )
+
+    Thread(target=profile, name="profiler", daemon=True).start()
+
+
+# Serializers and validators are imported by their handlers, so that they do not delay the initialize message
+
+
 def handle_long_serialize_uuri(json_msg: Dict[str, Any]):
+    from uprotocol.uri.serializer.longuriserializer import LongUriSerializer
+
     uri: UUri = dict_to_proto(json_msg["data"], UUri())
     serialized_uuri: str = LongUriSerializer().serialize(uri)
     send_to_test_manager(
@@ -230,6 +414,8 @@ def handle_long_serialize_uuri(json_msg: Dict[str, Any]):
 
 
 def handle_long_deserialize_uri(json_msg: Dict[str, Any]):
+    from uprotocol.uri.serializer.longuriserializer import LongUriSerializer
+
     uuri: UUri = LongUriSerializer().deserialize(json_msg["data"])
     send_to_test_manager(
         uuri,
@@ -238,7 +424,55 @@ def handle_long_deserialize_uri(json_msg: Dict[str, Any]):
     )
 
 
+def handle_run_vectors_command(json_msg: Dict[str, Any]):
+    """Runs a serializer over all "inputs" "repeat" times and answers with the results of the first pass and the
+    operations per second of all passes, so serializers are compared without a round trip per operation"""
+    from uprotocol.uri.serializer.longuriserializer import LongUriSerializer
+    from uprotocol.uri.serializer.microuriserializer import MicroUriSerializer
+
+    data: Dict[str, Any] = json_msg["data"]
+    repeat: int = max(int(data.get("repeat", 1)), 1)
+    if data["action"] == actioncommands.SERIALIZE_URI:
+        inputs: List[Any] = [dict_to_proto(uri, UUri()) for uri in data["inputs"]]
+        operation = LongUriSerializer().serialize
+        results: List[Any] = [operation(uri) for uri in inputs]
+    elif data["action"] == actioncommands.DESERIALIZE_URI:
+        inputs = list(data["inputs"])
+        operation = LongUriSerializer().deserialize
+        results = [message_to_dict(operation(uri)) for uri in inputs]
+    elif data["action"] == actioncommands.MICRO_SERIALIZE_URI:
+        inputs = [dict_to_proto(uri, UUri()) for uri in data["inputs"]]
+        operation = MicroUriSerializer().serialize
+        results = [operation(uri).decode("iso-8859-1") for uri in inputs]
+    elif data["action"] == actioncommands.MICRO_DESERIALIZE_URI:
+        inputs = [uri.encode("iso-8859-1") for uri in data["inputs"]]
+        operation = MicroUriSerializer().deserialize
+        results = [message_to_dict(operation(uri)) for uri in inputs]
+    else:
+        return UStatus(code=UCode.INVALID_ARGUMENT, message="run_vectors runs a uri or micro uri serializer")
+
+    start_ns: int = time.perf_counter_ns()
+    for _ in range(repeat):
+        for vector in inputs:
+            operation(vector)
+    elapsed_ns: int = time.perf_counter_ns() - start_ns
+    ops: int = repeat * len(inputs)
+    send_to_test_manager(
+        {
+            "action": data["action"],
+            "results": results,
+            "ops": ops,
+            "elapsed_ns": elapsed_ns,
+            "ops_per_s": ops * 1e9 / elapsed_ns if elapsed_ns > 0 else 0.0,
+        },
+        actioncommands.RUN_VECTORS_COMMAND,
+        received_test_id=json_msg["test_id"],
+    )
+
+
 def handle_long_deserialize_uuid(json_msg: Dict[str, Any]):
+    from uprotocol.uuid.serializer.longuuidserializer import LongUuidSerializer
+
     uuid: UUID = LongUuidSerializer().deserialize(json_msg["data"])
     send_to_test_manager(
         uuid,
@@ -248,6 +482,8 @@ def handle_long_deserialize_uuid(json_msg: Dict[str, Any]):
 
 
 def handle_long_serialize_uuid(json_msg: Dict[str, Any]):
+    from uprotocol.uuid.serializer.longuuidserializer import LongUuidSerializer
+
     uuid: UUID = dict_to_proto(json_msg["data"], UUID())
     serialized_uuid: str = LongUuidSerializer().serialize(uuid)
     send_to_test_manager(
@@ -258,6 +494,9 @@ def handle_long_serialize_uuid(json_msg: Dict[str, Any]):
 
 
 def handle_uri_validate_command(json_msg: Dict[str, Any]):
+    from uprotocol.uri.validator.urivalidator import UriValidator
+    from uprotocol.validation.validationresult import ValidationResult
+
     val_type: str = json_msg["data"]["validation_type"]
     uuri_data: Dict[str, Any] = json_msg["data"]["uuri"]
 
@@ -298,6 +537,8 @@ def handle_uri_validate_command(json_msg: Dict[str, Any]):
 
 
 def handle_micro_serialize_uri_command(json_msg: Dict[str, Any]):
+    from uprotocol.uri.serializer.microuriserializer import MicroUriSerializer
+
     uri: UUri = dict_to_proto(json_msg["data"], UUri())
     serialized_uuri: bytes = MicroUriSerializer().serialize(uri)
     # Use "iso-8859-1" to decode bytes -> str, so no UnicodeDecodeError if "utf-8" decode
@@ -310,6 +551,8 @@ def handle_micro_serialize_uri_command(json_msg: Dict[str, Any]):
 
 
 def handle_micro_deserialize_uri_command(json_msg: Dict[str, Any]):
+    from uprotocol.uri.serializer.microuriserializer import MicroUriSerializer
+
     sent_micro_serialized_uuri: str = json_msg["data"]
     # Incoming micro serialized uuri is sent as an "iso-8859-1" str
     micro_serialized_uuri: bytes = sent_micro_serialized_uuri.encode("iso-8859-1")
@@ -322,6 +565,10 @@ def handle_micro_deserialize_uri_command(json_msg: Dict[str, Any]):
 
 
 def handle_uuid_validate_command(json_msg):
+    from uprotocol.uuid.factory.uuidutils import UUIDUtils
+    from uprotocol.uuid.serializer.longuuidserializer import LongUuidSerializer
+    from uprotocol.uuid.validate.uuidvalidator import UuidValidator, Validators
+
     uuid_type = json_msg["data"].get("uuid_type")
     validator_type = json_msg["data"]["validator_type"]
 
@@ -355,6 +602,10 @@ def handle_uuid_validate_command(json_msg):
 
 
 def handle_uattributes_validate_command(json_msg: Dict[str, Any]):
+    from uprotocol.transport.validate import uattributesvalidator
+    from uprotocol.transport.validate.uattributesvalidator import UAttributesValidator
+    from uprotocol.validation.validationresult import ValidationResult
+
     data = json_msg["data"]
     val_method = data.get("validation_method")
     val_type = data.get("validation_type")
@@ -365,10 +616,11 @@ def handle_uattributes_validate_command(json_msg: Dict[str, Any]):
     else:
         attributes = UAttributes()
 
+    created_at = datetime.now(timezone.utc) - EXPIRED_ID_AGE if attributes.ttl == 1 else None
     if data.get("id") == "uprotocol":
-        attributes.id.CopyFrom(Factories.UPROTOCOL.create())
+        attributes.id.CopyFrom(Factories.UPROTOCOL.create(created_at))
     elif data.get("id") == "uuid":
-        attributes.id.CopyFrom(Factories.UUIDV6.create())
+        attributes.id.CopyFrom(Factories.UUIDV6.create(created_at))
 
     if data.get("reqid") == "uprotocol":
         attributes.reqid.CopyFrom(Factories.UPROTOCOL.create())
@@ -417,9 +669,6 @@ def handle_uattributes_validate_command(json_msg: Dict[str, Any]):
         }.get(val_type, not_val.validate),
     }.get(val_method)
 
-    if attributes.ttl == 1:
-        time.sleep(0.8)
-
     if val_type == "get_validator":
         status = validator_type(attributes)
     if validator_method is not None:
@@ -449,6 +698,7 @@ action_handlers = {
     actioncommands.INVOKE_METHOD_COMMAND: handle_invoke_method_command,
     actioncommands.SERIALIZE_URI: handle_long_serialize_uuri,
     actioncommands.DESERIALIZE_URI: handle_long_deserialize_uri,
+    actioncommands.RUN_VECTORS_COMMAND: handle_run_vectors_command,
     actioncommands.SERIALIZE_UUID: handle_long_serialize_uuid,
     actioncommands.DESERIALIZE_UUID: handle_long_deserialize_uuid,
     actioncommands.VALIDATE_URI: handle_uri_validate_command,
@@ -456,6 +706,13 @@ action_handlers = {
     actioncommands.MICRO_SERIALIZE_URI: handle_micro_serialize_uri_command,
     actioncommands.MICRO_DESERIALIZE_URI: handle_micro_deserialize_uri_command,
     actioncommands.VALIDATE_UUID: handle_uuid_validate_command,
+    actioncommands.LOADGEN_COMMAND: handle_loadgen_command,
+    actioncommands.BENCH_SUBSCRIBE_COMMAND: handle_bench_subscribe_command,
+    actioncommands.BENCH_RESULTS_COMMAND: handle_bench_results_command,
+    actioncommands.SLOW_SUBSCRIBE_COMMAND: handle_slow_subscribe_command,
+    actioncommands.ADVANCE_CLOCK_COMMAND: handle_advance_clock_command,
+    actioncommands.PROFILE_COMMAND: handle_profile_command,
+    actioncommands.GET_STATS_COMMAND: handle_get_stats_command,
 }
 
 
@@ -471,21 +728,65 @@ def process_message(json_data):
 
 
 def receive_from_tm():
+    # A read may hold several commands sent back to back, or part of one
+    utf8_decoder = codecs.getincrementaldecoder("utf-8")()
+    json_decoder = json.JSONDecoder()
+    buffer = ""
     while True:
         recv_data = ta_socket.recv(constants.BYTES_MSG_LENGTH)
         if not recv_data or recv_data == b"":
             return
-        # Deserialize the JSON data
-        json_data = json.loads(recv_data.decode("utf-8"))
-        logger.info("Received data from test manager: %s", json_data)
-        process_message(json_data)
+        buffer += utf8_decoder.decode(recv_data)
+        while buffer:
+            try:
+                json_data, end = json_decoder.raw_decode(buffer)
+            except json.JSONDecodeError:
+                break
+            buffer = buffer[end:].lstrip()
+            logger.info("Received data from test manager: %s", json_data)
+            process_message(json_data)
+
+
+def parse_args(argv: Optional[List[str]] = None) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="Python Test Agent")
+    parser.add_argument("--transport", default="socket", help="Transport with which to run python TA")
+    parser.add_argument("--instance-id", default="", help="Distinguishes several python TAs connected to one TM")
+    parser.add_argument(
+        "--shm-payloads", action="store_true", help="Send large payloads by reference through shared memory"
+    )
+    parser.add_argument(
+        "--virtual-clock", action="store_true", help="Time out requests only when the TM advances the clock"
+    )
+    args, _ = parser.parse_known_args(argv)
+    return args
 
 
-if __name__ == "__main__":
+def run(argv: Optional[List[str]] = None) -> Thread:
+    """
+    Connects to the Dispatcher and the Test Manager, then sends initialize.
+
+    :param argv: Command line options, sys.argv if None.
+    :return: The thread handling the commands of the Test Manager, which ends when the Test Manager disconnects.
+    """
+    global test_agent_name, listener, bench_listener, slow_listeners, clock, transport, ta_socket
+
+    args = parse_args(argv)
+    test_agent_name = constants.SDK_NAME
+    if args.instance_id != "":
+        test_agent_name += constants.INSTANCE_SEPARATOR + args.instance_id
     listener = SocketUListener()
-    transport = SocketUTransport()
+    bench_listener = BenchmarkUListener()
+    slow_listeners = {}
+    clock = VirtualClock() if args.virtual_clock else None
+    payload_store = SharedMemoryPayloadStore() if args.shm_payloads else None
+    transport = SocketUTransport(payload_store=payload_store, clock=clock)
     ta_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
     ta_socket.connect(constants.TEST_MANAGER_ADDR)
     thread = Thread(target=receive_from_tm)
     thread.start()
-    send_to_test_manager({"SDK_name": "python"}, "initialize")
+    send_to_test_manager({"SDK_name": constants.SDK_NAME, "instance_id": args.instance_id}, "initialize")
+    return thread
+
+
+if __name__ == "__main__":
+    run()
@@ -22,11 +22,22 @@
 pub const SEND_COMMAND: &str = "send";
 pub const REGISTER_LISTENER_COMMAND: &str = "registerlistener";
 pub const UNREGISTER_LISTENER_COMMAND: &str = "unregisterlistener";
-pub const SDK_INIT_MESSAGE: &str =
-    r#"{"ue":"rust","data":{"SDK_name":"rust"},"action":"initialize"}"#;
+pub const PROFILE_COMMAND: &str = "profile";
+pub const GET_STATS_COMMAND: &str = "get_stats";
+pub const SDK_NAME: &str = "rust";
+pub const INSTANCE_SEPARATOR: &str = "#";
+pub const SDK_INIT_COMMAND: &str = "initialize";
 
 pub const RESPONSE_ON_RECEIVE: &str = "onreceive";
 
 pub const TEST_MANAGER_ADDR: (&str, u16) = ("127.0.0.5", 12345);
 
 pub const ZENOH_TRANSPORT: &str = "zenoh";
+
+pub const VIRTUAL_ENTITY_NAME: &str = "default.entity";
+pub const ALL_ENTITIES: &str = "all";
+
+// Reports of received messages queued for the TM before listeners have to wait
+pub const REPORT_QUEUE_CAPACITY: usize = 1024;
+// Upper bound on the reports written to the TM at once
+pub const MAX_REPORT_BATCH_BYTES: usize = 64 * 1024;
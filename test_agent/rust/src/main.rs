@@ -20,20 +20,28 @@
  */
 
 mod constants;
+mod profiler;
 
+mod runtime;
 mod utils;
 
-use std::{sync::Arc, thread};
+use std::collections::{HashMap, HashSet};
+use std::sync::atomic::Ordering;
+use std::sync::Arc;
 
-use crate::constants::{TEST_MANAGER_ADDR, ZENOH_TRANSPORT};
-use testagent::{ListenerHandlers, SocketTestAgent};
+use crate::constants::{
+    INSTANCE_SEPARATOR, SDK_NAME, TEST_MANAGER_ADDR, VIRTUAL_ENTITY_NAME, ZENOH_TRANSPORT,
+};
+use testagent::{ListenerHandlers, SocketTestAgent, VirtualEntity};
 use up_rust::{Number, UAuthority, UEntity, UTransport};
+use utransport_socket::shm_payload::SharedPayloadStore;
+use utransport_socket::transport_stats::TransportStats;
 use utransport_socket::UTransportSocket;
 mod testagent;
 use clap::Parser;
-use log::{debug, error};
+use log::{debug, error, warn};
+use runtime::RuntimeConfig;
 use std::net::TcpStream;
-use tokio::runtime::Runtime;
 use up_client_zenoh::UPClientZenoh;
 use zenoh::config::Config;
 
@@ -43,6 +51,20 @@ struct Args {
     /// Transport with which to run rust TA
     #[arg(short, long)]
     transport: String,
+    /// Distinguishes several rust TAs connected to one TM
+    #[arg(long, default_value = "")]
+    instance_id: String,
+    /// Number of virtual uEntities hosted by this TA, each with its own identity, transport and listener
+    #[arg(long, default_value_t = 1)]
+    entities: usize,
+    /// Multiplex all virtual uEntities over a single Dispatcher connection (socket transport only)
+    #[arg(long)]
+    shared_connection: bool,
+    /// Send large payloads by reference through shared memory (socket transport only)
+    #[arg(long)]
+    shm_payloads: bool,
+    #[command(flatten)]
+    runtime: RuntimeConfig,
 }
 
 fn connect_to_socket(addr: &str, port: u16) -> Result<TcpStream, Box<dyn std::error::Error>> {
@@ -56,18 +78,32 @@ fn connect_to_socket(addr: &str, port: u16) -> Result<TcpStream, Box<dyn std::er
     }
 }
 
-async fn create_zenoh_u_transport() -> Box<dyn UTransport> {
-    let uauthority = UAuthority {
-        name: Some("MyAuthName".to_string()),
-        number: Some(Number::Id(vec![1, 2, 3, 4])),
-        ..Default::default()
+/// Creates the identity of a virtual uEntity. The random ids are kept unique within this TA.
+fn create_virtual_uentity(index: usize, used_ids: &mut HashSet<u16>) -> UEntity {
+    let mut id = rand::random::<u16>();
+    while !used_ids.insert(id) {
+        id = rand::random::<u16>();
+    }
+
+    let name = if index == 0 {
+        VIRTUAL_ENTITY_NAME.to_string()
+    } else {
+        format!("{VIRTUAL_ENTITY_NAME}.{index}")
     };
-    let uentity = UEntity {
-        name: "default.entity".to_string(),
-        id: Some(u32::from(rand::random::<u16>())),
+    UEntity {
+        name,
+        id: Some(u32::from(id)),
         version_major: Some(1),
         version_minor: None,
         ..Default::default()
+    }
+}
+
+async fn create_zenoh_u_transport(uentity: UEntity) -> Box<dyn UTransport> {
+    let uauthority = UAuthority {
+        name: Some("MyAuthName".to_string()),
+        number: Some(Number::Id(vec![1, 2, 3, 4])),
+        ..Default::default()
     };
     dbg!("zenoh transport created successfully");
 
@@ -78,53 +114,128 @@ async fn create_zenoh_u_transport() -> Box<dyn UTransport> {
     )
 }
 
-async fn connect_and_receive(transport_name: &str) -> Result<(), Box<dyn std::error::Error>> {
-    let test_agent = connect_to_socket(TEST_MANAGER_ADDR.0, TEST_MANAGER_ADDR.1)?;
-    let ta_to_tm_socket = connect_to_socket(TEST_MANAGER_ADDR.0, TEST_MANAGER_ADDR.1)?;
-    let foo_listener_socket_to_tm = connect_to_socket(TEST_MANAGER_ADDR.0, TEST_MANAGER_ADDR.1)?;
-
+/// Creates the transport of a uEntity, together with the counters of its connection if it has any
+async fn create_u_transport(
+    transport_name: &str,
+    uentity: UEntity,
+    payload_store: Option<Arc<SharedPayloadStore>>,
+) -> Result<(Box<dyn UTransport>, Option<Arc<TransportStats>>), Box<dyn std::error::Error>> {
     #[allow(clippy::single_match_else)]
     // We allow this because we'll have further transports we want to support and match works well
     // for that
-    let u_transport: Box<dyn UTransport> = match transport_name {
-        ZENOH_TRANSPORT => create_zenoh_u_transport().await,
+    let u_transport: (Box<dyn UTransport>, Option<Arc<TransportStats>>) = match transport_name {
+        ZENOH_TRANSPORT => (create_zenoh_u_transport(uentity).await, None),
         _ => {
             debug!("Socket transport created successfully");
-            Box::new(UTransportSocket::new()?)
+            let socket_transport =
+                UTransportSocket::new_for_entity(uentity.id.unwrap_or_default())?;
+            let stats = socket_transport.stats();
+            match payload_store {
+                Some(payload_store) => (
+                    Box::new(socket_transport.with_payload_store(payload_store)),
+                    Some(stats),
+                ),
+                None => (Box::new(socket_transport), Some(stats)),
+            }
         }
     };
+    Ok(u_transport)
+}
 
-    let foo_listener = Arc::new(ListenerHandlers::new(foo_listener_socket_to_tm));
-    let agent = SocketTestAgent::new(test_agent, foo_listener);
+async fn connect_and_receive(
+    transport_name: &str,
+    instance_id: &str,
+    entity_count: usize,
+    shared_connection: bool,
+    shm_payloads: bool,
+    runtime_description: HashMap<String, String>,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let test_agent = connect_to_socket(TEST_MANAGER_ADDR.0, TEST_MANAGER_ADDR.1)?;
+    let ta_to_tm_socket = connect_to_socket(TEST_MANAGER_ADDR.0, TEST_MANAGER_ADDR.1)?;
+    let foo_listener_socket_to_tm = connect_to_socket(TEST_MANAGER_ADDR.0, TEST_MANAGER_ADDR.1)?;
+
+    let test_agent_name = if instance_id.is_empty() {
+        SDK_NAME.to_string()
+    } else {
+        format!("{SDK_NAME}{INSTANCE_SEPARATOR}{instance_id}")
+    };
+
+    let foo_listener = ListenerHandlers::new(foo_listener_socket_to_tm, &test_agent_name);
+    let payload_store = if shm_payloads {
+        Some(Arc::new(SharedPayloadStore::new()?))
+    } else {
+        None
+    };
+    // Every virtual uEntity attaches to this connection instead of opening its own
+    let shared_socket = if shared_connection && transport_name != ZENOH_TRANSPORT {
+        let socket_transport = UTransportSocket::new()?;
+        Some(match &payload_store {
+            Some(payload_store) => socket_transport.with_payload_store(payload_store.clone()),
+            None => socket_transport,
+        })
+    } else {
+        None
+    };
+    let mut used_ids = HashSet::new();
+    let mut entities = Vec::with_capacity(entity_count.max(1));
+    for index in 0..entity_count.max(1) {
+        let uentity = create_virtual_uentity(index, &mut used_ids);
+        let (transport, stats): (Box<dyn UTransport>, _) = match &shared_socket {
+            Some(socket) => (
+                Box::new(socket.attach_entity(uentity.id.unwrap_or_default())?),
+                Some(socket.stats()),
+            ),
+            None => {
+                create_u_transport(transport_name, uentity.clone(), payload_store.clone()).await?
+            }
+        };
+        entities.push(VirtualEntity {
+            uentity,
+            transport,
+            listener: Arc::new(foo_listener.for_entity(index)),
+            stats,
+        });
+    }
+    debug!("Created {} virtual entities", entities.len());
+
+    let report_counters = foo_listener.report_counters();
+    let agent = SocketTestAgent::new(
+        test_agent,
+        &test_agent_name,
+        instance_id,
+        runtime_description,
+        report_counters.clone(),
+    );
     agent
         .clone()
-        .receive_from_tm(u_transport, ta_to_tm_socket)
+        .receive_from_tm(entities, ta_to_tm_socket)
         .await;
+    let overflowed = report_counters.overflowed.load(Ordering::Relaxed);
+    let dropped = report_counters.dropped.load(Ordering::Relaxed);
+    if overflowed > 0 || dropped > 0 {
+        warn!("{overflowed} reports to the TM had to wait for room on the report channel, {dropped} were dropped");
+    }
 
     Ok(())
 }
 
-#[tokio::main]
-async fn main() -> Result<(), Box<dyn std::error::Error>> {
-    let handle = thread::spawn(|| {
-        let args = Args::parse();
-        let transport_name = args.transport;
-
-        println!("Transport Name: {transport_name}");
-
-        let rt = Runtime::new().expect("error creating run time");
-
-        match rt.block_on(connect_and_receive(&transport_name)) {
-            Ok(()) => (),
-            Err(err) => eprintln!("Error occurred: {err}"),
-        };
-    });
-
-    if let Err(err) = handle.join() {
-        eprintln!("Error joining thread: {err:?}");
-        std::process::exit(1);
-    } else {
-        debug!("Successfully joined thread");
+fn main() -> Result<(), Box<dyn std::error::Error>> {
+    let args = Args::parse();
+    println!("Transport Name: {}", args.transport);
+
+    // Everything runs on this one runtime, including the tasks of the transports
+    let runtime = args.runtime.build()?;
+    debug!("Runtime configuration: {:?}", args.runtime);
+
+    if let Err(err) = runtime.block_on(connect_and_receive(
+        &args.transport,
+        &args.instance_id,
+        args.entities,
+        args.shared_connection,
+        args.shm_payloads,
+        args.runtime.describe(),
+    )) {
+        eprintln!("Error occurred: {err}");
     }
     Ok(())
 }
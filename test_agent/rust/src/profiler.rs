@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+use std::fmt::Write;
+use std::thread;
+use std::time::Duration;
+
+// Samples per second, uneven so that sampling does not run in lockstep with periodic work
+const SAMPLE_RATE_HZ: i32 = 997;
+
+/// Samples the stacks of all threads of the Test Agent for `duration` with pprof, which drives `SIGPROF`,
+/// and returns them as collapsed stacks: per line the thread name and the frames from the outermost to the
+/// innermost separated by semicolons, followed by the number of samples, as read by flamegraph tools.
+///
+/// # Errors
+///
+/// Returns an error if the profiler cannot be started, e.g. because another profile is running.
+pub fn sample_stacks(duration: Duration) -> Result<(String, isize), pprof::Error> {
+    let guard = pprof::ProfilerGuardBuilder::default()
+        .frequency(SAMPLE_RATE_HZ)
+        .blocklist(&["libc", "libgcc", "pthread", "vdso"])
+        .build()?;
+    thread::sleep(duration);
+    let report = guard.report().build()?;
+
+    let mut collapsed = String::new();
+    let mut samples = 0;
+    for (frames, count) in &report.data {
+        collapsed.push_str(&frames.thread_name_or_id());
+        // pprof lists the innermost frame first
+        for frame in frames.frames.iter().rev() {
+            for symbol in frame.iter().rev() {
+                collapsed.push(';');
+                collapsed.push_str(&symbol.name());
+            }
+        }
+        let _ = writeln!(collapsed, " {count}");
+        samples += count;
+    }
+    Ok((collapsed, samples))
+}
@@ -0,0 +1,151 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//! The tokio runtime the Test Agent runs on, configurable from the command line so benchmark
+//! results can be attributed to a runtime topology.
+
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Arc;
+use std::thread;
+
+use clap::{Args, ValueEnum};
+use log::error;
+use tokio::runtime::{Builder, Runtime};
+
+// tokio's default size of the blocking thread pool
+const DEFAULT_MAX_BLOCKING_THREADS: usize = 512;
+
+#[derive(ValueEnum, Clone, Copy, Debug, PartialEq, Eq)]
+pub enum RuntimeFlavor {
+    /// All tasks run on the thread that starts the Test Agent
+    CurrentThread,
+    /// Tasks are scheduled on a pool of worker threads
+    MultiThread,
+}
+
+#[derive(Args, Debug, Clone)]
+pub struct RuntimeConfig {
+    /// Tokio runtime flavor
+    #[arg(long, value_enum, default_value_t = RuntimeFlavor::MultiThread)]
+    runtime: RuntimeFlavor,
+    /// Number of worker threads of the multi-thread runtime, one per core by default
+    #[arg(long)]
+    worker_threads: Option<usize>,
+    /// Upper bound on the threads of the blocking pool
+    #[arg(long, default_value_t = DEFAULT_MAX_BLOCKING_THREADS)]
+    max_blocking_threads: usize,
+    /// Comma-separated cores to pin the runtime threads to, assigned round-robin (Linux only)
+    #[arg(long, value_delimiter = ',')]
+    pin_cores: Vec<usize>,
+}
+
+impl RuntimeConfig {
+    /// Builds the single runtime the Test Agent runs on.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the runtime cannot be created
+    pub fn build(&self) -> std::io::Result<Runtime> {
+        let mut builder = match self.runtime {
+            RuntimeFlavor::CurrentThread => {
+                // The current thread drives the runtime, pin it like the worker threads
+                if let Some(core) = self.pin_cores.first() {
+                    pin_current_thread(*core);
+                }
+                Builder::new_current_thread()
+            }
+            RuntimeFlavor::MultiThread => {
+                let mut builder = Builder::new_multi_thread();
+                builder.worker_threads(self.worker_threads());
+                builder
+            }
+        };
+        builder
+            .enable_all()
+            .max_blocking_threads(self.max_blocking_threads);
+
+        if !self.pin_cores.is_empty() {
+            let cores = Arc::new(self.pin_cores.clone());
+            let next_core = Arc::new(AtomicUsize::new(0));
+            builder.on_thread_start(move || {
+                let index = next_core.fetch_add(1, Ordering::Relaxed) % cores.len();
+                pin_current_thread(cores[index]);
+            });
+        }
+        builder.build()
+    }
+
+    fn worker_threads(&self) -> usize {
+        self.worker_threads.unwrap_or_else(|| {
+            thread::available_parallelism().map_or(1, std::num::NonZeroUsize::get)
+        })
+    }
+
+    /// Describes the runtime for the `initialize` message to the TM
+    #[must_use]
+    pub fn describe(&self) -> HashMap<String, String> {
+        let (flavor, worker_threads) = match self.runtime {
+            RuntimeFlavor::CurrentThread => ("current-thread", 1),
+            RuntimeFlavor::MultiThread => ("multi-thread", self.worker_threads()),
+        };
+        let pinned_cores = self
+            .pin_cores
+            .iter()
+            .map(ToString::to_string)
+            .collect::<Vec<_>>()
+            .join(",");
+        HashMap::from([
+            ("runtime".to_string(), flavor.to_string()),
+            ("worker_threads".to_string(), worker_threads.to_string()),
+            (
+                "max_blocking_threads".to_string(),
+                self.max_blocking_threads.to_string(),
+            ),
+            ("pinned_cores".to_string(), pinned_cores),
+        ])
+    }
+}
+
+#[cfg(target_os = "linux")]
+fn pin_current_thread(core: usize) {
+    // SAFETY: cpu_set_t is plain data, it is zero-initialized and only touched through the libc macros
+    let result = unsafe {
+        let mut cpu_set: libc::cpu_set_t = std::mem::zeroed();
+        libc::CPU_SET(core, &mut cpu_set);
+        libc::sched_setaffinity(
+            0,
+            std::mem::size_of::<libc::cpu_set_t>(),
+            std::ptr::addr_of!(cpu_set),
+        )
+    };
+    if result != 0 {
+        error!(
+            "Could not pin thread to core {core}: {}",
+            std::io::Error::last_os_error()
+        );
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+fn pin_current_thread(core: usize) {
+    error!("Pinning threads is only supported on Linux, not pinning to core {core}");
+}
@@ -20,27 +20,33 @@
  */
 
 use async_trait::async_trait;
-use log::{debug, error};
+use log::{debug, error, warn};
 use serde_json::Value;
-use up_rust::{Data, UCode, UListener};
+use up_rust::{Data, UCode, UEntity, UListener};
 use up_rust::{UMessage, UStatus, UTransport};
 
 use std::io::{Read, Write};
-use std::{collections::HashMap, sync::Arc};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::Duration;
+use std::{collections::HashMap, sync::Arc, thread};
+use tokio::sync::mpsc::{self, error::TrySendError};
 use tokio::sync::Mutex;
+use tokio::task;
+use utransport_socket::transport_stats::{StatsSnapshot, TransportStats};
 
 use serde::Serialize;
 
-use crate::constants::SDK_INIT_MESSAGE;
-use crate::utils::{convert_json_to_jsonstring, WrapperUMessage, WrapperUUri};
-use crate::{constants, utils};
+use crate::utils::{
+    convert_json_to_jsonstring, current_rss_bytes, process_cpu_s, WrapperUMessage, WrapperUUri,
+};
+use crate::{constants, profiler, utils};
 use std::net::TcpStream;
 
-use self::utils::sanitize_input_string;
+use self::utils::CommandStream;
 
 #[derive(Serialize)]
-pub struct JsonResponseData {
-    data: HashMap<String, String>,
+pub struct JsonResponseData<T = HashMap<String, String>> {
+    data: T,
     action: String,
     ue: String,
     test_id: String,
@@ -49,16 +55,82 @@ pub struct JsonResponseData {
 pub struct SocketTestAgent {
     clientsocket: Arc<Mutex<TcpStream>>,
 
-    listener: Arc<dyn UListener>,
+    test_agent_name: String,
+    instance_id: String,
+    // Reported to the TM on start, so results can be attributed to the runtime configuration
+    runtime_description: HashMap<String, String>,
+    report_counters: Arc<ReportCounters>,
 }
+
+/// A uEntity simulated by this Test Agent. Every virtual uEntity has its own identity, transport and listener,
+/// so one Test Agent process can stand in for many uEntities.
+pub struct VirtualEntity {
+    pub uentity: UEntity,
+    pub transport: Box<dyn UTransport>,
+    pub listener: Arc<dyn UListener>,
+    // Counters of the Dispatcher connection, None for transports without one
+    pub stats: Option<Arc<TransportStats>>,
+}
+
+/// Counts the reports to the TM which did not pass the report channel right away, see "`get_stats`"
+#[derive(Default)]
+pub struct ReportCounters {
+    // Reports which found the channel full and had to wait for the writer
+    pub overflowed: AtomicU64,
+    // Reports lost because the writer stopped
+    pub dropped: AtomicU64,
+}
+
+/// Reports every received message to the TM. Listeners of all virtual uEntities queue their reports
+/// on one bounded channel, which a single writer thread drains onto the socket to the TM.
 #[derive(Clone)]
 pub struct ListenerHandlers {
-    clientsocket_to_tm: Arc<Mutex<TcpStream>>,
+    reports_to_tm: mpsc::Sender<Vec<u8>>,
+    report_counters: Arc<ReportCounters>,
+    test_agent_name: String,
+    entity_index: usize,
 }
 impl ListenerHandlers {
-    pub fn new(test_clientsocket_to_tm: TcpStream) -> Self {
-        let clientsocket_to_tm = Arc::new(Mutex::new(test_clientsocket_to_tm));
-        Self { clientsocket_to_tm }
+    pub fn new(mut test_clientsocket_to_tm: TcpStream, test_agent_name: &str) -> Self {
+        let (reports_to_tm, mut reports) = mpsc::channel(constants::REPORT_QUEUE_CAPACITY);
+        thread::spawn(move || Self::write_reports(&mut test_clientsocket_to_tm, &mut reports));
+        Self {
+            reports_to_tm,
+            report_counters: Arc::new(ReportCounters::default()),
+            test_agent_name: test_agent_name.to_owned(),
+            entity_index: 0,
+        }
+    }
+
+    /// Writes the queued reports to the TM until every listener is dropped.
+    /// Reports queued while a write is in progress are sent together with the next one.
+    fn write_reports(clientsocket_to_tm: &mut TcpStream, reports: &mut mpsc::Receiver<Vec<u8>>) {
+        while let Some(mut batch) = reports.blocking_recv() {
+            while batch.len() < constants::MAX_REPORT_BATCH_BYTES {
+                let Ok(report) = reports.try_recv() else {
+                    break;
+                };
+                batch.extend_from_slice(&report);
+            }
+            if let Err(err) = clientsocket_to_tm.write_all(&batch) {
+                error!("on receive could not send data to TM: {err}");
+            }
+        }
+    }
+
+    /// Returns the counters of the reports of every virtual uEntity
+    #[must_use]
+    pub fn report_counters(&self) -> Arc<ReportCounters> {
+        self.report_counters.clone()
+    }
+
+    /// Creates the listener of another virtual uEntity, reporting over the same socket to the TM
+    #[must_use]
+    pub fn for_entity(&self, entity_index: usize) -> Self {
+        Self {
+            entity_index,
+            ..self.clone()
+        }
     }
 }
 
@@ -105,30 +177,43 @@ impl UListener for ListenerHandlers {
             return;
         };
 
-        let data = [("data".to_string(), payload_str.to_string())]
-            .iter()
-            .cloned()
-            .collect::<HashMap<_, _>>();
+        let data = [
+            ("data".to_string(), payload_str.to_string()),
+            ("entity".to_string(), self.entity_index.to_string()),
+        ]
+        .iter()
+        .cloned()
+        .collect::<HashMap<_, _>>();
         let json_message = JsonResponseData {
             action: constants::RESPONSE_ON_RECEIVE.to_owned(),
             data,
-            ue: "rust".to_string(),
+            ue: self.test_agent_name.clone(),
             test_id: "1".to_string(),
         };
 
         debug!("sending received data to tm....");
-        let json_message_str = convert_json_to_jsonstring(&json_message);
-        let message = json_message_str.as_bytes();
-
-        let Ok(mut socket) = self.clientsocket_to_tm.try_lock() else {
-            error!("Failed to acquire lock for sending data to TM from on_receive");
-            return;
-        };
-
-        let result = socket.write_all(message);
-        match result {
-            Ok(()) => println!("on receive could send data to TM"),
-            Err(err) => error!("on receive could not send data to TM: {err}"),
+        let report = convert_json_to_jsonstring(&json_message).into_bytes();
+
+        match self.reports_to_tm.try_send(report) {
+            Ok(()) => {}
+            Err(TrySendError::Full(report)) => {
+                // Wait for the writer instead of dropping the report
+                let overflowed = self
+                    .report_counters
+                    .overflowed
+                    .fetch_add(1, Ordering::Relaxed);
+                if overflowed == 0 {
+                    warn!("Report channel to TM full, reports wait for the writer; get_stats counts them");
+                }
+                if self.reports_to_tm.send(report).await.is_err() {
+                    self.report_counters.dropped.fetch_add(1, Ordering::Relaxed);
+                    error!("Report writer to TM stopped, dropping report");
+                }
+            }
+            Err(TrySendError::Closed(_)) => {
+                self.report_counters.dropped.fetch_add(1, Ordering::Relaxed);
+                error!("Report writer to TM stopped, dropping report");
+            }
         }
     }
 
@@ -138,15 +223,174 @@ impl UListener for ListenerHandlers {
 }
 
 impl SocketTestAgent {
-    pub fn new(test_clientsocket: TcpStream, listener: Arc<dyn UListener>) -> Self {
+    pub fn new(
+        test_clientsocket: TcpStream,
+        test_agent_name: &str,
+        instance_id: &str,
+        runtime_description: HashMap<String, String>,
+        report_counters: Arc<ReportCounters>,
+    ) -> Self {
         let clientsocket = Arc::new(Mutex::new(test_clientsocket));
 
         Self {
             clientsocket,
-            listener,
+            test_agent_name: test_agent_name.to_owned(),
+            instance_id: instance_id.to_owned(),
+            runtime_description,
+            report_counters,
         }
     }
 
+    /// Selects the virtual uEntities a TM command applies to from its "entity" field:
+    /// no field selects the first uEntity, "all" every uEntity and a number the uEntity with that index.
+    fn select_entities<'a>(
+        entities: &'a [VirtualEntity],
+        selector: &Value,
+    ) -> Result<&'a [VirtualEntity], UStatus> {
+        let index = match selector {
+            Value::Null => 0,
+            Value::String(all) if all == constants::ALL_ENTITIES => return Ok(entities),
+            Value::String(index) => index.parse::<usize>().map_err(|err| {
+                UStatus::fail_with_code(
+                    UCode::INVALID_ARGUMENT,
+                    format!("Invalid entity selector {index}: {err}"),
+                )
+            })?,
+            Value::Number(index) => index
+                .as_u64()
+                .and_then(|index| usize::try_from(index).ok())
+                .ok_or_else(|| {
+                    UStatus::fail_with_code(
+                        UCode::INVALID_ARGUMENT,
+                        format!("Invalid entity selector {index}"),
+                    )
+                })?,
+            _ => {
+                return Err(UStatus::fail_with_code(
+                    UCode::INVALID_ARGUMENT,
+                    format!("Invalid entity selector {selector}"),
+                ))
+            }
+        };
+
+        entities.get(index..=index).ok_or_else(|| {
+            UStatus::fail_with_code(
+                UCode::NOT_FOUND,
+                format!("No virtual entity with index {index}"),
+            )
+        })
+    }
+
+    async fn handle_command(
+        &self,
+        entity: &VirtualEntity,
+        action: &str,
+        json_data_value: Value,
+    ) -> Result<(), UStatus> {
+        match action {
+            constants::SEND_COMMAND => {
+                self.handle_send_command(&*entity.transport, json_data_value)
+                    .await
+            }
+            constants::REGISTER_LISTENER_COMMAND => {
+                self.handle_register_listener_command(entity, json_data_value)
+                    .await
+            }
+            constants::UNREGISTER_LISTENER_COMMAND => {
+                self.handle_unregister_listener_command(entity, json_data_value)
+                    .await
+            }
+            _ => Err(UStatus::fail_with_code(
+                UCode::UNIMPLEMENTED,
+                format!("The Rust Test Agent does not implement {action}"),
+            )),
+        }
+    }
+
+    /// Answers with the counters of every Dispatcher connection of the virtual uEntities, added up,
+    /// together with the reports to the TM which overflowed their channel or were dropped, and the
+    /// CPU time and resident set size of the process
+    fn send_stats(&self, entities: &[VirtualEntity], test_id: &str, ta_to_tm_socket: &TcpStream) {
+        let mut connections: Vec<&Arc<TransportStats>> = Vec::new();
+        for stats in entities.iter().filter_map(|entity| entity.stats.as_ref()) {
+            // Virtual uEntities sharing a connection share its counters
+            if !connections.iter().any(|known| Arc::ptr_eq(known, stats)) {
+                connections.push(stats);
+            }
+        }
+        let mut snapshot = StatsSnapshot::default();
+        for stats in connections {
+            snapshot.merge(stats.snapshot());
+        }
+
+        let mut data = serde_json::to_value(&snapshot).unwrap_or_default();
+        if let Value::Object(fields) = &mut data {
+            fields.insert(
+                "reports_to_tm".to_string(),
+                serde_json::json!({
+                    "overflowed": self.report_counters.overflowed.load(Ordering::Relaxed),
+                    "dropped": self.report_counters.dropped.load(Ordering::Relaxed),
+                }),
+            );
+            fields.insert("cpu_s".to_string(), process_cpu_s().into());
+            fields.insert("rss_bytes".to_string(), current_rss_bytes().into());
+        }
+        let json_message = JsonResponseData {
+            action: constants::GET_STATS_COMMAND.to_owned(),
+            data,
+            ue: self.test_agent_name.clone(),
+            test_id: test_id.to_owned(),
+        };
+        let message = convert_json_to_jsonstring(&json_message);
+        let result = ta_to_tm_socket
+            .try_clone()
+            .and_then(|mut socket| socket.write_all(message.as_bytes()));
+        if let Err(err) = result {
+            error!("could not send stats to TM: {err}");
+        }
+    }
+
+    /// Samples the stacks for "`duration_ms`" on a thread of its own, so that the commands to profile
+    /// keep being processed, and answers with the collapsed stacks
+    fn spawn_profile(&self, data: &Value, test_id: &str, ta_to_tm_socket: &TcpStream) {
+        let duration_ms = match &data["duration_ms"] {
+            Value::String(ms) => ms.parse::<u64>().ok(),
+            value => value.as_u64(),
+        }
+        .unwrap_or(1000);
+        let Ok(mut socket) = ta_to_tm_socket.try_clone() else {
+            error!("Socket cloning failed for ta to tm socket clone");
+            return;
+        };
+        let test_agent_name = self.test_agent_name.clone();
+        let test_id = test_id.to_owned();
+        thread::spawn(move || {
+            let mut profile: HashMap<String, String> = HashMap::new();
+            match profiler::sample_stacks(Duration::from_millis(duration_ms)) {
+                Ok((collapsed, samples)) => {
+                    profile.insert("format".to_string(), "collapsed".to_string());
+                    profile.insert("collapsed".to_string(), collapsed);
+                    profile.insert("samples".to_string(), samples.to_string());
+                }
+                Err(err) => {
+                    error!("Profiling failed: {err}");
+                    profile.insert("message".to_string(), err.to_string());
+                    profile.insert("code".to_string(), (UCode::INTERNAL as i32).to_string());
+                }
+            }
+            let json_message = JsonResponseData {
+                action: constants::PROFILE_COMMAND.to_owned(),
+                data: profile,
+                ue: test_agent_name,
+                test_id,
+            };
+            let message = convert_json_to_jsonstring(&json_message);
+            if let Err(err) = socket.write_all(message.as_bytes()) {
+                error!("could not send profile to TM: {err}");
+            }
+        });
+    }
+
     async fn handle_send_command(
         &self,
         utransport: &dyn UTransport,
@@ -166,7 +410,7 @@ impl SocketTestAgent {
 
     async fn handle_register_listener_command(
         &self,
-        utransport: &dyn UTransport,
+        entity: &VirtualEntity,
         json_data_value: Value,
     ) -> Result<(), UStatus> {
         let wrapper_uuri: WrapperUUri = match serde_json::from_value(json_data_value) {
@@ -178,14 +422,15 @@ impl SocketTestAgent {
             }
         };
         let u_uuri = wrapper_uuri.0;
-        utransport
-            .register_listener(u_uuri, Arc::clone(&self.clone().listener))
+        entity
+            .transport
+            .register_listener(u_uuri, Arc::clone(&entity.listener))
             .await
     }
 
     async fn handle_unregister_listener_command(
         &self,
-        utransport: &dyn UTransport,
+        entity: &VirtualEntity,
         json_data_value: Value,
     ) -> Result<(), UStatus> {
         let wrapper_uuri: WrapperUUri = match serde_json::from_value(json_data_value) {
@@ -197,115 +442,168 @@ impl SocketTestAgent {
             }
         };
         let u_uuri = wrapper_uuri.0;
-        utransport
-            .unregister_listener(u_uuri, Arc::clone(&self.clone().listener))
+        entity
+            .transport
+            .unregister_listener(u_uuri, Arc::clone(&entity.listener))
             .await
     }
 
     pub async fn receive_from_tm(
         &mut self,
-        utransport: Box<dyn UTransport>,
+        entities: Vec<VirtualEntity>,
         ta_to_tm_socket: TcpStream,
     ) {
-        self.clone().inform_tm_ta_starting().await;
+        for (index, entity) in entities.iter().enumerate() {
+            debug!(
+                "Virtual entity {index}: {} with id {:?}",
+                entity.uentity.name, entity.uentity.id
+            );
+        }
+        self.clone().inform_tm_ta_starting(entities.len()).await;
         let clientsocket = self.clientsocket.clone();
-        let mut socket = clientsocket.lock().await;
+        let Ok(mut socket) = clientsocket.lock().await.try_clone() else {
+            error!("Socket cloning failed for tm to ta socket clone");
+            return;
+        };
 
         let mut recv_data = [0; 2048];
-        // Use `while let` to handle reads
-        while let Ok(bytes_received) = socket.read(&mut recv_data) {
+        let mut commands = CommandStream::default();
+        // The blocking read runs on the blocking pool, so that a current-thread runtime still
+        // runs the listener tasks while waiting for the next command
+        loop {
+            let read = task::spawn_blocking(move || {
+                let result = socket.read(&mut recv_data);
+                (socket, recv_data, result)
+            })
+            .await;
+            let Ok((returned_socket, returned_data, Ok(bytes_received))) = read else {
+                break;
+            };
+            socket = returned_socket;
+            recv_data = returned_data;
             if bytes_received == 0 {
                 // Handling the case when the connection is closed properly
                 debug!("Connection closed by the peer.");
                 break;
             }
 
-            let recv_data_str: std::borrow::Cow<'_, str> =
-                String::from_utf8_lossy(&recv_data[..bytes_received]);
-            let cleaned_json_string = sanitize_input_string(&recv_data_str).replace("BYTES:", "");
+            // The TM sends commands back to back, so one read may hold several commands or a part
+            for json_msg in commands.feed(&recv_data[..bytes_received]) {
+                self.handle_tm_command(&entities, &json_msg, &ta_to_tm_socket)
+                    .await;
+            }
+        }
+        self.close_connection().await;
+    }
 
-            let json_msg: Value = match serde_json::from_str(&cleaned_json_string.to_string()) {
-                Ok(json) => json,
-                Err(err) => {
-                    error!("error in converting json_msg to string{}", err);
-                    continue;
-                }
-            };
+    async fn handle_tm_command(
+        &self,
+        entities: &[VirtualEntity],
+        json_msg: &Value,
+        ta_to_tm_socket: &TcpStream,
+    ) {
+        let action = json_msg["action"].clone();
+        let json_data_value = json_msg["data"].clone();
+        let test_id = json_msg["test_id"].clone();
 
-            let action = json_msg["action"].clone();
-            let json_data_value = json_msg["data"].clone();
-            let test_id = json_msg["test_id"].clone();
+        let Some(json_str_ref) = action.as_str() else {
+            error!("action is not a string");
+            return;
+        };
 
-            let Some(json_str_ref) = action.as_str() else {
-                error!("action is not a string");
-                continue;
-            };
+        if json_str_ref == constants::GET_STATS_COMMAND {
+            self.send_stats(
+                entities,
+                test_id.as_str().unwrap_or_default(),
+                ta_to_tm_socket,
+            );
+            return;
+        }
+        if json_str_ref == constants::PROFILE_COMMAND {
+            self.spawn_profile(
+                &json_data_value,
+                test_id.as_str().unwrap_or_default(),
+                ta_to_tm_socket,
+            );
+            return;
+        }
 
-            let status = match json_str_ref {
-                constants::SEND_COMMAND => {
-                    self.handle_send_command(&*utransport, json_data_value)
-                        .await
-                }
-                constants::REGISTER_LISTENER_COMMAND => {
-                    self.handle_register_listener_command(&*utransport, json_data_value)
-                        .await
-                }
-                constants::UNREGISTER_LISTENER_COMMAND => {
-                    self.handle_unregister_listener_command(&*utransport, json_data_value)
-                        .await
+        // A command addressed to several virtual uEntities reports the last failure, if any
+        let status = match Self::select_entities(entities, &json_msg["entity"]) {
+            Ok(selected_entities) => {
+                let mut status = Ok(());
+                for entity in selected_entities {
+                    let entity_status = self
+                        .handle_command(entity, json_str_ref, json_data_value.clone())
+                        .await;
+                    if entity_status.is_err() {
+                        status = entity_status;
+                    }
                 }
-                _ => Ok(()),
-            };
+                status
+            }
+            Err(u_status) => Err(u_status),
+        };
 
-            let mut status_dict: HashMap<String, _> = HashMap::new();
+        let mut status_dict: HashMap<String, _> = HashMap::new();
 
-            match status {
-                Ok(()) => {
-                    let status = UStatus::default();
-                    status_dict.insert(
-                        "message".to_string(),
-                        status.message.clone().unwrap_or_default(),
-                    );
-                    status_dict.insert("code".to_string(), 0.to_string());
-                }
-                Err(u_status) => {
-                    status_dict.insert(
-                        "message".to_string(),
-                        u_status.message.clone().unwrap_or_default(),
-                    );
-                    let enum_number = UStatus::get_code(&u_status) as i32;
-                    status_dict.insert("code".to_string(), enum_number.to_string());
-                }
+        match status {
+            Ok(()) => {
+                let status = UStatus::default();
+                status_dict.insert(
+                    "message".to_string(),
+                    status.message.clone().unwrap_or_default(),
+                );
+                status_dict.insert("code".to_string(), 0.to_string());
+            }
+            Err(u_status) => {
+                status_dict.insert(
+                    "message".to_string(),
+                    u_status.message.clone().unwrap_or_default(),
+                );
+                let enum_number = UStatus::get_code(&u_status) as i32;
+                status_dict.insert("code".to_string(), enum_number.to_string());
             }
+        }
 
-            let json_message = JsonResponseData {
-                action: json_str_ref.to_owned(),
-                data: status_dict.clone(),
-                ue: "rust".to_owned(),
-                test_id: test_id.to_string(),
-            };
+        let json_message = JsonResponseData {
+            action: json_str_ref.to_owned(),
+            data: status_dict.clone(),
+            ue: self.test_agent_name.clone(),
+            test_id: test_id.to_string(),
+        };
 
-            let Ok(ta_to_tm_socket_clone) = ta_to_tm_socket.try_clone() else {
-                error!("Socket cloning failed for ta to tm socket clone");
+        let Ok(ta_to_tm_socket_clone) = ta_to_tm_socket.try_clone() else {
+            error!("Socket cloning failed for ta to tm socket clone");
 
-                continue;
-            };
+            return;
+        };
 
-            let json_message_str = convert_json_to_jsonstring(&json_message);
-            let message = json_message_str.as_bytes();
-            let result = ta_to_tm_socket_clone
-                .try_clone()
-                .and_then(|mut socket_clone| socket_clone.write_all(message));
-            match result {
-                Ok(()) => println!("on receive could send init to TM"),
-                Err(err) => error!("on receive could not send init to TM{}", err),
-            }
+        let json_message_str = convert_json_to_jsonstring(&json_message);
+        let message = json_message_str.as_bytes();
+        let result = ta_to_tm_socket_clone
+            .try_clone()
+            .and_then(|mut socket_clone| socket_clone.write_all(message));
+        match result {
+            Ok(()) => println!("on receive could send init to TM"),
+            Err(err) => error!("on receive could not send init to TM{}", err),
         }
-        self.close_connection().await;
     }
 
-    async fn inform_tm_ta_starting(self) {
-        let sdk_init = SDK_INIT_MESSAGE;
+    async fn inform_tm_ta_starting(self, entity_count: usize) {
+        let mut init_data = HashMap::from([
+            ("SDK_name".to_string(), constants::SDK_NAME.to_string()),
+            ("instance_id".to_string(), self.instance_id.clone()),
+            ("entities".to_string(), entity_count.to_string()),
+        ]);
+        init_data.extend(self.runtime_description.clone());
+        let json_message = JsonResponseData {
+            data: init_data,
+            action: constants::SDK_INIT_COMMAND.to_owned(),
+            ue: self.test_agent_name.clone(),
+            test_id: String::new(),
+        };
+        let sdk_init = convert_json_to_jsonstring(&json_message);
 
         //inform TM that rust TA is running
         debug!("Sending SDK name to Test Manager!");
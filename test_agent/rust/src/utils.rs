@@ -461,6 +461,35 @@ impl<'de> Deserialize<'de> for WrapperUMessage {
     }
 }
 
+/// Returns the CPU time the process has spent so far, in user and kernel mode
+#[must_use]
+#[allow(clippy::cast_precision_loss)]
+pub fn process_cpu_s() -> f64 {
+    // SAFETY: getrusage only writes the zero-initialized struct passed to it
+    let usage = unsafe {
+        let mut usage: libc::rusage = std::mem::zeroed();
+        libc::getrusage(libc::RUSAGE_SELF, std::ptr::addr_of_mut!(usage));
+        usage
+    };
+    let seconds = |time: libc::timeval| time.tv_sec as f64 + time.tv_usec as f64 / 1e6;
+    seconds(usage.ru_utime) + seconds(usage.ru_stime)
+}
+
+/// Returns the resident set size of the process, 0 where /proc is not available
+#[must_use]
+pub fn current_rss_bytes() -> u64 {
+    let Ok(statm) = std::fs::read_to_string("/proc/self/statm") else {
+        return 0;
+    };
+    // SAFETY: sysconf has no preconditions
+    let page_size = u64::try_from(unsafe { libc::sysconf(libc::_SC_PAGESIZE) }).unwrap_or(4096);
+    statm
+        .split_whitespace()
+        .nth(1)
+        .and_then(|pages| pages.parse::<u64>().ok())
+        .map_or(0, |pages| pages * page_size)
+}
+
 pub fn escape_control_character(c: char) -> String {
     format!("\\u{:04x}", c as u32)
 }
@@ -475,6 +504,59 @@ pub fn sanitize_input_string(input: &str) -> String {
         .collect()
 }
 
+// Removes the BYTES: marker the TM puts in front of byte payloads from every string of a command
+fn strip_bytes_marker(value: &mut Value) {
+    match value {
+        Value::String(text) => *text = text.replace("BYTES:", ""),
+        Value::Array(items) => items.iter_mut().for_each(strip_bytes_marker),
+        Value::Object(fields) => fields.values_mut().for_each(strip_bytes_marker),
+        _ => {}
+    }
+}
+
+/// Splits the stream of the TM into its JSON commands, which arrive back to back and may be split
+/// across reads
+#[derive(Default)]
+pub struct CommandStream {
+    pending: Vec<u8>,
+}
+
+impl CommandStream {
+    /// Appends the bytes of one read and returns the commands completed by them
+    pub fn feed(&mut self, data: &[u8]) -> Vec<Value> {
+        // Control characters are single bytes in UTF-8, so they are escaped before a command is
+        // complete
+        for &byte in data {
+            if byte <= 0x1F {
+                self.pending
+                    .extend_from_slice(escape_control_character(char::from(byte)).as_bytes());
+            } else {
+                self.pending.push(byte);
+            }
+        }
+
+        let mut commands = Vec::new();
+        let mut stream = serde_json::Deserializer::from_slice(&self.pending).into_iter::<Value>();
+        let consumed = loop {
+            match stream.next() {
+                Some(Ok(mut command)) => {
+                    strip_bytes_marker(&mut command);
+                    commands.push(command);
+                }
+                // The rest of the command follows with the next read
+                Some(Err(err)) if err.is_eof() => break stream.byte_offset(),
+                Some(Err(err)) => {
+                    error!("error in converting json_msg to string{}", err);
+                    break self.pending.len();
+                }
+                None => break stream.byte_offset(),
+            }
+        };
+        self.pending.drain(..consumed);
+        commands
+    }
+}
+
 #[cfg(test)]
 mod tests {
 
@@ -486,4 +568,19 @@ mod tests {
         let result = convert_json_to_jsonstring(&json);
         assert_eq!(result, r#"{"key":"value"}"#);
     }
+
+    #[test]
+    fn test_command_stream_splits_commands() {
+        let mut commands = CommandStream::default();
+        let first = commands.feed(br#"{"action":"a"}{"action":"b","data":"BYTES:x"}{"act"#);
+        assert_eq!(
+            first,
+            vec![
+                serde_json::json!({"action": "a"}),
+                serde_json::json!({"action": "b", "data": "x"}),
+            ]
+        );
+        let second = commands.feed(br#"ion":"c"}"#);
+        assert_eq!(second, vec![serde_json::json!({"action": "c"})]);
+    }
 }
@@ -15,16 +15,16 @@ SPDX-FileType: SOURCE
 SPDX-License-Identifier: Apache-2.0
 """
 
+import os
 import sys
 from threading import Thread
 
-import git
 from behave.runner import Context
 
-repo = git.Repo(".", search_parent_directories=True)
-sys.path.insert(0, repo.working_tree_dir)
+# The repository root, two levels above this file
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..")))
 
-from test_manager.features.utils import loggerutils
+from test_manager.features.utils import affinityutils, loggerutils, timingutils
 from test_manager.testmanager import TestManager
 
 
@@ -40,7 +40,21 @@ def before_all(context):
 
     context.transport = {}
     context.ues = {}
+    # Test Agent name -> command and time.perf_counter() of its spawn
+    context.test_agent_spawns = {}
+    # Forks the Python Test Agents, started with the first of them
+    context.python_agent_server = None
+    # Test Agent name -> test ids of its "profile" request, until its flamegraph is rendered
+    context.pending_profiles = {}
+    # Test Agent name -> "get_stats" response that later counts are compared against
+    context.stats_baselines = {}
+    # Report of the warmup rounds before the next benchmark result, if any
+    context.benchmark_warmup = None
     context.dispatcher = {}
+    context.timings = timingutils.SuiteTimings()
+    # Pins the Test Manager before it starts its threads, the Dispatcher and Test Agents are pinned when spawned
+    context.cpu_plan = affinityutils.CpuPlan(context.config.userdata)
+    context.cpu_plan.pin_current_process("tm")
 
     loggerutils.setup_logging()
     loggerutils.setup_formatted_logging(context)
@@ -53,15 +67,47 @@ def before_all(context):
     context.logger.info("Created Test Manager...")
 
 
+def before_feature(context: Context, feature):
+    context.timings.start_feature()
+
+
+def after_feature(context: Context, feature):
+    context.timings.end_feature(feature)
+
+
+def before_scenario(context: Context, scenario):
+    context.timings.start_scenario()
+
+
+def after_scenario(context: Context, scenario):
+    context.timings.end_scenario(scenario)
+
+
+def before_step(context: Context, step):
+    context.timings.start_step()
+
+
+def after_step(context: Context, step):
+    context.timings.end_step(context, step)
+
+
+def write_timing_reports(context: Context):
+    report = context.timings.report(context.tm.get_request_timings())
+    timingutils.write_reports(report, timingutils.run_name(context.config))
+    for step in report["slowest_steps"]:
+        context.logger.info(f"{step['duration_s']:8.3f} s {step['step']} ({step['location']}, {step['test_agent']})")
+
+
 def after_all(context: Context):
+    write_timing_reports(context)
+
     context.ue = None
     context.action = None
     context.json_dict = None
 
     context.rust_sender = False
-    context.tm.close_test_agent("rust")
-    context.tm.close_test_agent("python")
-    context.tm.close_test_agent("java")
+    for test_agent_name in context.tm.get_test_agent_names():
+        context.tm.close_test_agent(test_agent_name)
     context.tm.close()
     if context.transport.get("transport") == "socket":
         context.dispatcher["socket"].close()
@@ -71,5 +117,7 @@ def after_all(context: Context):
         for ue in context.ues:
             for process in context.ues[ue]:
                 process.terminate()
+        if context.python_agent_server is not None:
+            context.python_agent_server["process"].terminate()
     except Exception as e:
         context.logger.error(e)
@@ -17,14 +17,16 @@ SPDX-License-Identifier: Apache-2.0
 
 import base64
 import codecs
+import json
 import os
-import subprocess
+import signal
+import socket
 import sys
+import tempfile
 import time
 from threading import Thread
-from typing import Any, Dict, List, Union
+from typing import Any, Dict, List, Optional, Set, Union
 
-import git
 import parse
 from behave import given, register_type, then, when
 from behave.runner import Context
@@ -32,22 +34,41 @@ from hamcrest import assert_that, equal_to
 from uprotocol.proto.uattributes_pb2 import UMessageType, UPriority
 from uprotocol.proto.ustatus_pb2 import UCode
 
-PYTHON_TA_PATH = "/test_agent/python/testagent.py"
-JAVA_TA_PATH = "/test_agent/java/target/tck-test-agent-java-jar-with-dependencies.jar"
-RUST_TA_PATH = "/test_agent/rust/target/debug/rust_tck"
-DISPATCHER_PATH = "/dispatcher/dispatcher.py"
-
-repo = git.Repo(".", search_parent_directories=True)
-sys.path.insert(0, repo.working_tree_dir)
+# The repository root, three levels above this file
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..", "..")))
 
 from dispatcher.dispatcher import Dispatcher
-
-
-def create_command(context, filepath_from_root_repo: str) -> List[str]:
+from test_manager.features.utils import benchutils, flamegraphutils
+from test_manager.features.utils.processutils import (
+    CPP_TA_PATH,
+    DISPATCHER_PATH,
+    JAVA_TA_CDS_ARCHIVE_PATH,
+    JAVA_TA_PATH,
+    PYTHON_TA_PATH,
+    PYTHON_TA_SERVER_PATH,
+    RUST_TA_PATH,
+    DispatcherProcess,
+    create_subprocess,
+)
+from test_manager.testmanager import (
+    INSTANCE_SEPARATOR,
+    is_test_agent_group,
+    resolve_test_agent_alias,
+    split_test_agent_name,
+)
+
+
+def create_command(
+    context, filepath_from_root_repo: str, instance_id: str = "", class_data_sharing: bool = True
+) -> List[str]:
     command: List[str] = []
 
     if filepath_from_root_repo.endswith(".jar"):
         command.append("java")
+        cds_archive: str = os.path.abspath(os.path.dirname(os.getcwd()) + "/" + JAVA_TA_CDS_ARCHIVE_PATH)
+        if class_data_sharing and os.path.isfile(cds_archive):
+            # Maps the classes archived at build time instead of loading and verifying them from the jar
+            command.append("-XX:SharedArchiveFile=" + cds_archive)
         command.append("-jar")
     elif filepath_from_root_repo.endswith(".py"):
         if sys.platform == "win32":
@@ -58,20 +79,12 @@ def create_command(context, filepath_from_root_repo: str) -> List[str]:
 
     command.append("--transport")
     command.append(context.transport["transport"])
+    if instance_id != "":
+        command.append("--instance-id")
+        command.append(instance_id)
     return command
 
 
-def create_subprocess(command: List[str]) -> subprocess.Popen:
-    if sys.platform == "win32":
-        process = subprocess.Popen(command, shell=True)
-    elif sys.platform == "linux" or sys.platform == "linux2" or sys.platform == "darwin":
-        process = subprocess.Popen(command)
-    else:
-        print(sys.platform)
-        raise Exception("only handle Windows and Linux commands for now")
-    return process
-
-
 def cast_data_to_jsonable_bytes(value: str):
     return "BYTES:" + value
 
@@ -126,59 +139,237 @@ def parse_nullable_string(text):
 # creates behave's input data type to be empty/blank/""
 register_type(NullableString=parse_nullable_string)
 
+# Warmup rounds publish on a topic of their own, so they never count towards a measured run
+WARMUP_TOPIC: Dict[str, Any] = {
+    "entity": {"name": "body.access", "id": "1234", "version_major": "1"},
+    "resource": {"name": "warmup", "id": "4321", "message": "Warmup"},
+}
 
-@given('"{sdk_name}" creates data for "{command}"')
-@when('"{sdk_name}" creates data for "{command}"')
-def create_sdk_data(context, sdk_name: str, command: str):
-    context.json_dict = {}
-
-    if sdk_name == "uE1":
-        sdk_name = context.config.userdata["uE1"]
-    elif sdk_name == "uE2":
-        sdk_name = context.config.userdata["uE2"]
 
+def start_dispatcher(context) -> Union[Dispatcher, DispatcherProcess]:
+    """Runs the Dispatcher as a thread of the Test Manager, or as a process with --define dispatcher=process,
+    which is the default once it is pinned with --define cpus_dispatcher
+    """
+    cpus: Optional[Set[int]] = context.cpu_plan.cpus_of("dispatcher")
+    mode: str = context.config.userdata.get("dispatcher", "process" if cpus is not None else "thread")
+    context.transport["dispatcher"] = mode
+    if mode == "process":
+        command: List[str] = [sys.executable, os.path.abspath(os.path.dirname(os.getcwd()) + "/" + DISPATCHER_PATH)]
+        dispatcher = DispatcherProcess(create_subprocess(command, context.cpu_plan.assign("dispatcher", cpus)))
+        dispatcher.wait_until_listening()
+        return dispatcher
+    if mode != "thread":
+        raise ValueError("Invalid dispatcher mode")
+
+    dispatcher = Dispatcher()
+    thread = Thread(target=dispatcher.listen_for_client_connections)
+    thread.start()
+    time.sleep(5)
+    return dispatcher
+
+
+def start_transport(context):
     if context.transport == {}:
         context.transport["transport"] = context.config.userdata["transport"]
         if context.transport["transport"] == "socket":
-            dispatcher = Dispatcher()
-            thread = Thread(target=dispatcher.listen_for_client_connections)
-            thread.start()
-            context.dispatcher[context.transport["transport"]] = dispatcher
-            time.sleep(5)
+            context.dispatcher[context.transport["transport"]] = start_dispatcher(context)
         elif context.transport["transport"] == "zenoh":
             context.logger.info("Zenoh selected as transport")
         else:
             raise ValueError("Invalid transport")
 
-    if sdk_name not in context.ues:
-        context.logger.info(f"Creating {sdk_name} process...")
 
-        if sdk_name == "python":
-            run_command = create_command(context, PYTHON_TA_PATH)
-        elif sdk_name == "java":
-            run_command = create_command(context, JAVA_TA_PATH)
-        elif sdk_name == "rust":
-            run_command = create_command(context, RUST_TA_PATH)
+class ForkedTestAgent:
+    """A Test Agent forked by the Python agent server, terminated like a subprocess"""
 
-        process = create_subprocess(run_command)
-        if sdk_name in ["python", "java", "rust"]:
-            context.ues.setdefault(sdk_name, []).append(process)
-        else:
-            raise ValueError("Invalid SDK name")
+    def __init__(self, pid: int):
+        self.pid = pid
+
+    def terminate(self):
+        try:
+            os.kill(self.pid, signal.SIGTERM)
+        except ProcessLookupError:
+            pass
+
+
+def uses_python_agent_server(context) -> bool:
+    """Python Test Agents are forked from a server which imported the SDK once, unless disabled with
+    --define python_agent_server=false. Forking needs a POSIX platform.
+    """
+    return sys.platform != "win32" and context.config.userdata.get("python_agent_server", "true") == "true"
+
+
+def fork_python_test_agent(context, argv: List[str], cpus: Optional[Set[int]] = None) -> ForkedTestAgent:
+    """Has the Python agent server fork a Test Agent with the given command line options, pinned to the given CPUs,
+    starting the server on first use
+    """
+    if context.python_agent_server is None:
+        address: str = os.path.join(tempfile.gettempdir(), f"up-tck-python-agent-server-{os.getpid()}.sock")
+        server_command: List[str] = create_command(context, PYTHON_TA_SERVER_PATH)
+        server_command.extend(["--socket", address])
+        context.python_agent_server = {"process": create_subprocess(server_command), "address": address}
+    server = context.python_agent_server
+
+    # The server listens once it has imported the SDK
+    deadline: float = time.time() + 30
+    while True:
+        connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            connection.connect(server["address"])
+            break
+        except (FileNotFoundError, ConnectionRefusedError):
+            connection.close()
+            if server["process"].poll() is not None or time.time() > deadline:
+                raise RuntimeError("Python agent server is not running")
+            time.sleep(0.01)
+
+    with connection:
+        request: Dict[str, Any] = {"argv": argv}
+        if cpus is not None:
+            request["cpus"] = sorted(cpus)
+        connection.sendall((json.dumps(request) + "\n").encode("utf-8"))
+        reply: Dict[str, Any] = json.loads(connection.makefile("r").readline())
+    return ForkedTestAgent(reply["pid"])
+
+
+def create_test_agent(context, test_agent_name: str, extra_args: List[str] = None, fast_start: bool = True):
+    """Spawns the Test Agent process for a name such as "python" or "python#7" unless it is already running.
+    With fast_start, Python Test Agents are forked from the agent server and Java Test Agents use their class data
+    sharing archive, if available.
+    """
+    if test_agent_name in context.ues:
+        return
+
+    context.logger.info(f"Creating {test_agent_name} process...")
+    sdk_name, instance_id = split_test_agent_name(test_agent_name)
+
+    if sdk_name == "python":
+        run_command = create_command(context, PYTHON_TA_PATH, instance_id)
+    elif sdk_name == "java":
+        run_command = create_command(context, JAVA_TA_PATH, instance_id, fast_start)
+    elif sdk_name == "rust":
+        run_command = create_command(context, RUST_TA_PATH, instance_id)
+    elif sdk_name == "cpp":
+        run_command = create_command(context, CPP_TA_PATH, instance_id)
+    else:
+        raise ValueError("Invalid SDK name")
+
+    if extra_args is not None:
+        run_command.extend(extra_args)
+    forked: bool = sdk_name == "python" and fast_start and uses_python_agent_server(context)
+    cpus: Optional[Set[int]] = context.cpu_plan.assign(
+        test_agent_name, context.cpu_plan.cpus_of_test_agent(test_agent_name, sdk_name)
+    )
+    context.test_agent_spawns[test_agent_name] = {
+        "command": run_command,
+        "forked": forked,
+        "spawned_at": time.perf_counter(),
+    }
+    if forked:
+        # The server runs testagent.py itself, it only needs the command line options
+        process = fork_python_test_agent(context, run_command[2:], cpus)
+    else:
+        process = create_subprocess(run_command, cpus)
+    context.ues.setdefault(test_agent_name, []).append(process)
+
+
+def start_connected_test_agent(
+    context, test_agent_name: str, extra_args: Optional[List[str]] = None, fast_start: bool = True
+):
+    """Starts the transport and the Test Agent with extra_args, unless they are running, and waits until the Test
+    Agent has connected to the Test Manager
+    """
+    start_transport(context)
 
-    while not context.tm.has_sdk_connection(sdk_name):
+    create_test_agent(context, test_agent_name, extra_args, fast_start)
+    while not context.tm.has_sdk_connection(test_agent_name):
         continue
 
+
+@given('{count:d} "{sdk_name}" test agents are running')
+def create_test_agent_instances(context, count: int, sdk_name: str):
+    start_transport(context)
+
+    test_agent_names: List[str] = [f"{sdk_name}{INSTANCE_SEPARATOR}{instance}" for instance in range(1, count + 1)]
+    for test_agent_name in test_agent_names:
+        create_test_agent(context, test_agent_name)
+
+    for test_agent_name in test_agent_names:
+        while not context.tm.has_sdk_connection(test_agent_name):
+            continue
+
+
+@given('"{sdk_name}" test agent hosts {count:d} virtual entities')
+def create_multi_entity_test_agent(context, sdk_name: str, count: int):
+    start_connected_test_agent(context, sdk_name, ["--entities", str(count)])
+
+
+@given('"{sdk_name}" test agent sends large payloads through shared memory')
+def create_shm_payload_test_agent(context, sdk_name: str):
+    start_connected_test_agent(context, sdk_name, ["--shm-payloads"])
+
+
+@given('"{sdk_name}" test agent runs on virtual threads')
+def create_virtual_thread_test_agent(context, sdk_name: str):
+    """Only the Java Test Agent has this option, it needs JDK 21 or newer"""
+    start_connected_test_agent(context, sdk_name, ["--virtual-threads"])
+
+
+@then('"{sdk_name}" reports the execution model "{execution_model}"')
+def verify_execution_model(context, sdk_name: str, execution_model: str):
+    """A Java Test Agent asked for virtual threads falls back to platform threads before JDK 21"""
+    info: Dict[str, Any] = context.tm.get_test_agent_info(sdk_name)
+    assert_that(info.get("execution_model"), equal_to(execution_model))
+
+
+@given('"{sdk_name}" test agent runs on a virtual clock')
+def create_virtual_clock_test_agent(context, sdk_name: str):
+    """RPC requests of the Test Agent time out only when its clock is advanced, the Rust Test Agent has no RPC"""
+    start_connected_test_agent(context, sdk_name, ["--virtual-clock"])
+
+
+@given('"{sdk_name}" test agent is started')
+def start_test_agent(context, sdk_name: str):
+    start_connected_test_agent(context, sdk_name)
+
+
+@given('"{sdk_name}" test agent is started cold')
+def start_cold_test_agent(context, sdk_name: str):
+    """Launches a Test Agent without the Python agent server or the Java class data sharing archive,
+    the baseline of the startup benchmark
+    """
+    start_connected_test_agent(context, sdk_name, fast_start=False)
+
+
+@given('"{sdk_name}" creates data for "{command}"')
+@when('"{sdk_name}" creates data for "{command}"')
+def create_sdk_data(context, sdk_name: str, command: str):
+    context.json_dict = {}
+
+    if sdk_name == "uE1":
+        sdk_name = context.config.userdata["uE1"]
+    elif sdk_name == "uE2":
+        sdk_name = context.config.userdata["uE2"]
+
+    start_transport(context)
+
+    if is_test_agent_group(sdk_name):
+        # A group only addresses Test Agents which are already running, resolving raises if there are none
+        context.tm.resolve_test_agents(sdk_name)
+    else:
+        start_connected_test_agent(context, sdk_name)
+
     try:
         context.rust_sender
     except AttributeError:
         context.rust_sender = False
 
-    if sdk_name == "rust" and command == "send":
+    if split_test_agent_name(sdk_name)[0] == "rust" and command == "send":
         context.rust_sender = True
 
     context.ue = sdk_name
     context.action = command
+    context.entity = None
 
     # if feature file provides step-table data in step definition ...
     if context.table is not None:
@@ -193,6 +384,12 @@ def create_sdk_data(context, sdk_name: str, command: str):
         context.logger.info(context.json_dict)
 
 
+@given('targets virtual entity "{entity}"')
+@when('targets virtual entity "{entity}"')
+def target_virtual_entity(context, entity: str):
+    context.entity = entity
+
+
 @when('sets "{key}" to previous response data')
 def sets_key_to_previous_response(context, key: str):
     if key not in context.json_dict:
@@ -340,39 +537,271 @@ def set_key_to_bytes(context, key: str, value: str):
         context.json_dict[key] = "BYTES:" + value
 
 
+@given('sets "{key}" to {size:d} bytes of "{character}"')
+@when('sets "{key}" to {size:d} bytes of "{character}"')
+def set_key_to_repeated_bytes(context, key: str, size: int, character: str):
+    """Builds payloads too large to spell out in a feature file, e.g. ones sent through shared memory"""
+    if key not in context.json_dict:
+        context.json_dict[key] = "BYTES:" + character * size
+
+
 @given('sends "{command}" request')
 @when('sends "{command}" request')
 def send_command_request(context, command: str):
     context.json_dict = unflatten_dict(context.json_dict)
     context.logger.info(f"Json request for {command} -> {str(context.json_dict)}")
 
-    response_json: Dict[str, Any] = context.tm.request(context.ue, command, context.json_dict)
+    response_json: Union[Dict[str, Any], List[Dict[str, Any]]] = context.tm.request(
+        context.ue, command, context.json_dict, entity=context.entity
+    )
     context.logger.info(f"Response Json {command} -> {response_json}")
-    context.response_data = response_json["data"]
+    if isinstance(response_json, list):
+        context.response_data = [response["data"] for response in response_json]
+    else:
+        context.response_data = response_json["data"]
+
+
+@when('sends "{command}" request without waiting for the response')
+def send_command_request_nowait(context, command: str):
+    context.json_dict = unflatten_dict(context.json_dict)
+    context.logger.info(f"Json request for {command} -> {str(context.json_dict)}")
+
+    context.pending_request = (
+        context.ue,
+        command,
+        context.tm.request_nowait(context.ue, command, context.json_dict, entity=context.entity),
+    )
+
+
+@when('"{sdk_name}" advances its clock by {ms:d} ms')
+def advance_clock(context, sdk_name: str, ms: int):
+    sdk_name = resolve_test_agent_alias(sdk_name, context.config.userdata)
+    response_json: Dict[str, Any] = context.tm.request(sdk_name, "advance_clock", {"ms": str(ms)})
+    assert_that(int(response_json["data"]["code"]), equal_to(UCode.OK))
+
+
+@then('the "{command}" response is received')
+def receive_pending_response(context, command: str):
+    test_agent_name, action, test_ids = context.pending_request
+    assert_that(action, equal_to(command))
+
+    response_json: Union[Dict[str, Any], List[Dict[str, Any]]] = context.tm.wait_for_responses(
+        test_agent_name, action, test_ids
+    )
+    context.logger.info(f"Response Json {command} -> {response_json}")
+    if isinstance(response_json, list):
+        context.response_data = [response["data"] for response in response_json]
+    else:
+        context.response_data = response_json["data"]
+
+
+@given('"{sdk_name}" starts profiling for {duration_ms:d} ms')
+@when('"{sdk_name}" starts profiling for {duration_ms:d} ms')
+def start_profiling(context, sdk_name: str, duration_ms: int):
+    sdk_name = resolve_test_agent_alias(sdk_name, context.config.userdata)
+    data: Dict[str, str] = {"duration_ms": str(duration_ms)}
+    context.pending_profiles[sdk_name] = context.tm.request_nowait(sdk_name, "profile", data)
+
+
+@then('the flamegraph of "{sdk_name}" is rendered')
+def render_flamegraph(context, sdk_name: str):
+    sdk_name = resolve_test_agent_alias(sdk_name, context.config.userdata)
+    test_ids: List[str] = context.pending_profiles.pop(sdk_name)
+    response_json: Union[Dict[str, Any], List[Dict[str, Any]]] = context.tm.wait_for_responses(
+        sdk_name, "profile", test_ids
+    )
+    feature_name: str = os.path.splitext(os.path.basename(context.feature.filename))[0]
+    for response in response_json if isinstance(response_json, list) else [response_json]:
+        profile: Dict[str, Any] = response["data"]
+        assert "collapsed" in profile, f"{response['ue']} could not be profiled: {profile.get('message')}"
+        report_name: str = f"{feature_name}-{response['ue'].replace(INSTANCE_SEPARATOR, '-')}"
+        svg_path: str = flamegraphutils.write_flamegraph(
+            report_name, profile["collapsed"], f"{response['ue']}, {profile['samples']} samples"
+        )
+        context.logger.info(f"Flamegraph of {response['ue']} -> {svg_path}")
 
 
 @then('the status received with "{field_name}" is "{expected_value}"')
 def receive_status(context, field_name: str, expected_value: str):
-    try:
-        actual_value: str = context.response_data[field_name]
-        expected_value: int = getattr(UCode, expected_value)
-        assert_that(expected_value, equal_to(int(actual_value)))
-    except AssertionError:
-        raise AssertionError(
-            f"Assertion error. Expected is {expected_value} but " f"received {context.response_data[field_name]}"
-        )
-    except Exception as ae:
-        raise ValueError(f"Exception occurred. {ae}")
+    # A group request ("all python") holds one response per Test Agent, all of them must match
+    response_data_list = context.response_data if isinstance(context.response_data, list) else [context.response_data]
+    for response_data in response_data_list:
+        try:
+            actual_value: str = response_data[field_name]
+            expected_code: int = getattr(UCode, expected_value)
+            assert_that(expected_code, equal_to(int(actual_value)))
+        except AssertionError:
+            raise AssertionError(
+                f"Assertion error. Expected is {expected_value} but " f"received {response_data[field_name]}"
+            )
+        except Exception as ae:
+            raise ValueError(f"Exception occurred. {ae}")
+
+
+@then('"{sdk_name}" receives {count:d} benchmark messages within {timeout:d} seconds')
+def wait_for_benchmark_messages(context, sdk_name: str, count: int, timeout: int):
+    if sdk_name == "uE1":
+        sdk_name = context.config.userdata["uE1"]
+    elif sdk_name == "uE2":
+        sdk_name = context.config.userdata["uE2"]
+
+    received: Dict[str, Any] = wait_for_bench_results(context, sdk_name, count, timeout)
+    context.benchmark_received = received
+    assert_that(received["count"], equal_to(count))
+
+
+def wait_for_bench_results(context, sdk_name: str, count: int, timeout: int) -> Dict[str, Any]:
+    deadline: float = time.time() + timeout
+    while True:
+        received: Dict[str, Any] = context.tm.request(sdk_name, "bench_results", {})["data"]
+        if received["count"] >= count or time.time() > deadline:
+            return received
+        time.sleep(0.1)
+
+
+@given('"{sender_sdk_name}" warms up publishing {count:d} messages of {payload_size:d} bytes to "{sdk_name}"')
+@when('"{sender_sdk_name}" warms up publishing {count:d} messages of {payload_size:d} bytes to "{sdk_name}"')
+def warm_up_publishing(context, sender_sdk_name: str, count: int, payload_size: int, sdk_name: str):
+    """Publishes rounds of count messages on a topic of their own until the throughput is steady, configured with
+    --define warmup_rounds, steady_window, steady_max_cv and max_warmup_rounds. The rounds are reported with the
+    next benchmark result, whose "bench_subscribe" resets the counts of the subscriber.
+    """
+    for test_agent_name in (sender_sdk_name, sdk_name):
+        start_connected_test_agent(context, test_agent_name)
+
+    userdata = context.config.userdata
+    detector = benchutils.SteadyStateDetector(
+        window=int(userdata.get("steady_window", benchutils.STEADY_WINDOW)),
+        max_cv=float(userdata.get("steady_max_cv", benchutils.STEADY_MAX_CV)),
+        min_rounds=int(userdata.get("warmup_rounds", 1)),
+        max_rounds=int(userdata.get("max_warmup_rounds", benchutils.MAX_WARMUP_ROUNDS)),
+    )
+    loadgen_data: Dict[str, Any] = {"topic": WARMUP_TOPIC, "payload_size": str(payload_size), "count": str(count)}
+    while not detector.is_done():
+        status: Dict[str, Any] = context.tm.request(sdk_name, "bench_subscribe", WARMUP_TOPIC)["data"]
+        assert_that(int(status["code"]), equal_to(UCode.OK))
+        loadgen: Dict[str, Any] = context.tm.request(sender_sdk_name, "loadgen", loadgen_data)["data"]
+        received: Dict[str, Any] = wait_for_bench_results(context, sdk_name, loadgen["count"], 60)
+        detector.add(benchutils.throughput_result("warmup", loadgen, received)["messages_per_s"])
+
+    context.benchmark_warmup = detector.report()
+    context.logger.info(f"Warmup of {sender_sdk_name} -> {sdk_name}: {context.benchmark_warmup}")
+
+
+def get_stats(context, sdk_name: str) -> Dict[str, Any]:
+    return context.tm.request(sdk_name, "get_stats", {})["data"]
+
+
+def stats_field(stats: Dict[str, Any], field_path: str) -> Any:
+    """Returns a field of a "get_stats" response by its dotted path, e.g. "received.messages" """
+    value: Any = stats
+    for key in field_path.split("."):
+        value = value[key]
+    return value
+
+
+@given('the stats of "{sdk_name}" are taken as baseline')
+@when('the stats of "{sdk_name}" are taken as baseline')
+def take_stats_baseline(context, sdk_name: str):
+    context.stats_baselines[sdk_name] = get_stats(context, sdk_name)
+
+
+@then('"{sdk_name}" received exactly {count:d} messages with {parse_errors:d} parse errors')
+def assert_received_messages(context, sdk_name: str, count: int, parse_errors: int):
+    """Counts from the baseline of the Test Agent if one was taken, else from its start"""
+    stats: Dict[str, Any] = get_stats(context, sdk_name)
+    baseline: Dict[str, Any] = context.stats_baselines.get(sdk_name)
+    context.logger.info(f"Stats of {sdk_name} -> {stats}")
+    received: int = stats["received"]["messages"] - (baseline["received"]["messages"] if baseline else 0)
+    errors: int = stats["parse_errors"] - (baseline["parse_errors"] if baseline else 0)
+    assert_that(received, equal_to(count))
+    assert_that(errors, equal_to(parse_errors))
+
+
+@then('the stats of "{sdk_name}" have "{field_path}" as {expected_value:d}')
+def assert_stats_field(context, sdk_name: str, field_path: str, expected_value: int):
+    """Counts from the baseline of the Test Agent if one was taken, else from its start"""
+    stats: Dict[str, Any] = get_stats(context, sdk_name)
+    baseline: Dict[str, Any] = context.stats_baselines.get(sdk_name)
+    context.logger.info(f"Stats of {sdk_name} -> {stats}")
+    value: int = stats_field(stats, field_path) - (stats_field(baseline, field_path) if baseline else 0)
+    assert_that(value, equal_to(expected_value))
+
+
+@then('the benchmark result "{label}" is recorded')
+def record_benchmark_result(context, label: str):
+    # The CPU time of the Dispatcher thread or process is measured since the previous result
+    dispatcher_cpu_s: float = 0.0
+    dispatcher = context.dispatcher.get("socket")
+    if dispatcher is not None:
+        if isinstance(dispatcher, DispatcherProcess):
+            dispatcher_cpu_total_s: float = dispatcher.cpu_seconds()
+        else:
+            dispatcher_cpu_total_s = dispatcher.metrics.cpu_seconds
+        dispatcher_cpu_s = dispatcher_cpu_total_s - getattr(context, "dispatcher_cpu_mark_s", 0.0)
+        context.dispatcher_cpu_mark_s = dispatcher_cpu_total_s
+
+    result = benchutils.throughput_result(label, context.response_data, context.benchmark_received, dispatcher_cpu_s)
+    # Attributes the result to the Test Agents and their configuration, e.g. the Rust runtime
+    result["test_agents"] = {
+        test_agent_name: context.tm.get_test_agent_info(test_agent_name)
+        for test_agent_name in context.tm.get_test_agent_names()
+    }
+    # The warmup rounds are kept apart from the measured result
+    result["warmup"] = context.benchmark_warmup
+    context.benchmark_warmup = None
+    benchutils.record_result(context, result)
+    context.logger.info(f"Benchmark result -> {result}")
+
+
+@then('the time to initialize of "{sdk_name}" is recorded')
+def record_time_to_initialize(context, sdk_name: str):
+    spawn: Dict[str, Any] = context.test_agent_spawns[sdk_name]
+    result: Dict[str, Any] = {
+        "label": f"{sdk_name} time to initialize",
+        "time_to_initialize_s": context.tm.get_test_agent_initialized_at(sdk_name) - spawn["spawned_at"],
+        "command": spawn["command"],
+        "forked": spawn["forked"],
+        "test_agents": {sdk_name: context.tm.get_test_agent_info(sdk_name)},
+    }
+    benchutils.record_result(context, result)
+    context.logger.info(f"Startup benchmark result -> {result}")
 
 
 @then('"{sender_sdk_name}" sends onreceive message with field "{field_name}" as b"{expected_value}"')
 def receive_value_as_bytes(context, sender_sdk_name: str, field_name: str, expected_value: str):
+    rust_sender: bool = context.rust_sender
+    context.rust_sender = False
+    for test_agent_name in context.tm.resolve_test_agents(sender_sdk_name):
+        verify_onreceive_value_as_bytes(context, test_agent_name, field_name, expected_value, rust_sender)
+
+
+@then('"{sender_sdk_name}" sends {count:d} onreceive messages with field "{field_name}" as b"{expected_value}"')
+def receive_values_as_bytes(context, sender_sdk_name: str, count: int, field_name: str, expected_value: str):
+    """Expects one report from each of the count virtual uEntities of a Test Agent that received the message"""
+    rust_sender: bool = context.rust_sender
+    context.rust_sender = False
+    for test_agent_name in context.tm.resolve_test_agents(sender_sdk_name):
+        entities: List[int] = []
+        for _ in range(count):
+            on_receive_msg: Dict[str, Any] = verify_onreceive_value_as_bytes(
+                context, test_agent_name, field_name, expected_value, rust_sender
+            )
+            entities.append(int(on_receive_msg["data"].get("entity", -1)))
+        # One uEntity delivering twice must not pass for two delivering once
+        assert_that(sorted(entities), equal_to(list(range(count))))
+
+
+def verify_onreceive_value_as_bytes(
+    context, test_agent_name: str, field_name: str, expected_value: str, rust_sender: bool
+) -> Dict[str, Any]:
+    """Checks the next onreceive report of the Test Agent and returns it"""
     try:
         expected_value = expected_value.strip()
-        context.logger.info(f"getting on_receive_msg from {sender_sdk_name}")
-        on_receive_msg: Dict[str, Any] = context.tm.get_onreceive(sender_sdk_name)
+        context.logger.info(f"getting on_receive_msg from {test_agent_name}")
+        on_receive_msg: Dict[str, Any] = context.tm.get_onreceive(test_agent_name)
         context.logger.info(f"got on_receive_msg:  {on_receive_msg}")
-        if sender_sdk_name == "rust":
+        if split_test_agent_name(test_agent_name)[0] == "rust":
             val = on_receive_msg["data"]["data"]
             rec_field_value = bytes(
                 val.split("value")[1]
@@ -386,8 +815,7 @@ def receive_value_as_bytes(context, sender_sdk_name: str, field_name: str, expec
             )
         else:
             val = access_nested_dict(on_receive_msg["data"], field_name)
-            if context.rust_sender:
-                context.rust_sender = False
+            if rust_sender:
                 decoded_string = val.replace('"', "").replace("\\", "").replace("x", "\\x")[1:]
                 rec_field_value = bytes(decoded_string, "utf-8")
             else:
@@ -397,6 +825,7 @@ def receive_value_as_bytes(context, sender_sdk_name: str, field_name: str, expec
         assert (
             rec_field_value.split(b"googleapis.com/")[1] == expected_value.encode("utf-8").split(b"googleapis.com/")[1]
         )
+        return on_receive_msg
 
     except AssertionError:
         raise AssertionError(
@@ -406,10 +835,25 @@ def receive_value_as_bytes(context, sender_sdk_name: str, field_name: str, expec
         raise ValueError(f"Exception occurred. {ae}")
 
 
+@then('"{sender_sdk_name}" sends onreceive message with {size:d} bytes of "{character}" as payload')
+def receive_repeated_bytes(context, sender_sdk_name: str, size: int, character: str):
+    context.rust_sender = False
+    for test_agent_name in context.tm.resolve_test_agents(sender_sdk_name):
+        on_receive_msg: Dict[str, Any] = context.tm.get_onreceive(test_agent_name)
+        if split_test_agent_name(test_agent_name)[0] == "rust":
+            # The Rust Test Agent nests the payload as JSON in strings
+            payload: str = json.loads(json.loads(on_receive_msg["data"]["data"])["payload"])["value"]
+        else:
+            payload: str = access_nested_dict(on_receive_msg["data"], "payload.value")
+        # Not compared as a whole, so that a mismatch is not reported with the entire payload
+        assert_that(len(payload), equal_to(size))
+        assert_that(payload.strip(character), equal_to(""))
+
+
 @then('"{sdk_name}" receives data field "{field_name}" as b"{expected_value}"')
 def receive_rpc_response_as_bytes(context, sdk_name, field_name: str, expected_value: str):
     try:
-        if sdk_name == "rust":
+        if split_test_agent_name(sdk_name)[0] == "rust":
             actual_value = context.response_data["data"]
             actual_value = bytes(
                 actual_value.split("value")[1]
@@ -0,0 +1,42 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+Feature: Benchmarking Test Agent startup
+
+  Scenario Outline: To measure the time from spawning <test_agent> until it sends initialize
+    Given "<test_agent>" test agent is started
+    Then the time to initialize of "<test_agent>" is recorded
+
+    Examples:
+      | test_agent     |
+      | python#startup |
+      | java#startup   |
+      | rust#startup   |
+
+  Scenario Outline: To measure the time to initialize of <test_agent> without startup optimizations
+    Given "<test_agent>" test agent is started cold
+    Then the time to initialize of "<test_agent>" is recorded
+
+    Examples:
+      | test_agent  |
+      | python#cold |
+      | java#cold   |
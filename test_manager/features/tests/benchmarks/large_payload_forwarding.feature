@@ -0,0 +1,95 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+# -------------------------------------------------------------------------
+Feature: Benchmarking large payload forwarding
+
+  Scenario Outline: To measure throughput and CPU cost of <payload_size> byte payloads
+    Given "<uE1>" creates data for "bench_subscribe"
+    And sets "entity.name" to "camera.front"
+    And sets "entity.id" to "4321"
+    And sets "entity.version_major" to "1"
+    And sets "resource.name" to "frame"
+    And sets "resource.id" to "4321"
+    And sets "resource.message" to "Image"
+
+    When sends "bench_subscribe" request
+    Then the status received with "code" is "OK"
+
+    When "<uE2>" creates data for "loadgen"
+    And sets "topic.entity.name" to "camera.front"
+    And sets "topic.entity.id" to "4321"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "frame"
+    And sets "topic.resource.id" to "4321"
+    And sets "topic.resource.message" to "Image"
+    And sets "payload_size" to "<payload_size>"
+    And sets "count" to "<count>"
+    And sends "loadgen" request
+
+    Then "<uE1>" receives <count> benchmark messages within 120 seconds
+    And the benchmark result "<payload_size>" is recorded
+
+    Examples:
+      | uE1    | uE2    | payload_size | count |
+      | python | python | 1024         | 2000  |
+      | python | python | 16384        | 1000  |
+      | python | python | 65536        | 500   |
+      | python | python | 262144       | 200   |
+      | python | python | 1048576      | 50    |
+      | python | python | 4194304      | 20    |
+      | python | python | 16777216     | 10    |
+
+  Scenario Outline: To measure throughput and CPU cost of <payload_size> byte payloads sent by reference
+    Given "<uE2>" test agent sends large payloads through shared memory
+    And "<uE1>" creates data for "bench_subscribe"
+    And sets "entity.name" to "camera.front"
+    And sets "entity.id" to "4321"
+    And sets "entity.version_major" to "1"
+    And sets "resource.name" to "frame"
+    And sets "resource.id" to "4321"
+    And sets "resource.message" to "Image"
+
+    When sends "bench_subscribe" request
+    Then the status received with "code" is "OK"
+
+    When "<uE2>" creates data for "loadgen"
+    And sets "topic.entity.name" to "camera.front"
+    And sets "topic.entity.id" to "4321"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "frame"
+    And sets "topic.resource.id" to "4321"
+    And sets "topic.resource.message" to "Image"
+    And sets "payload_size" to "<payload_size>"
+    And sets "count" to "<count>"
+    And sends "loadgen" request
+
+    Then "<uE1>" receives <count> benchmark messages within 120 seconds
+    And the benchmark result "shm <payload_size>" is recorded
+
+    Examples:
+      | uE1    | uE2        | payload_size | count |
+      | python | python#shm | 65536        | 500   |
+      | python | python#shm | 262144       | 200   |
+      | python | python#shm | 1048576      | 50    |
+      | python | python#shm | 4194304      | 20    |
+      | python | python#shm | 16777216     | 10    |
@@ -0,0 +1,56 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+Feature: Profiling Test Agents while they forward messages
+
+  Scenario Outline: To render flamegraphs of "<uE1>" receiving and "<uE2>" publishing <count> messages
+    Given "<uE1>" creates data for "bench_subscribe"
+    And sets "entity.name" to "body.access"
+    And sets "entity.id" to "1234"
+    And sets "entity.version_major" to "1"
+    And sets "resource.name" to "door"
+    And sets "resource.id" to "1234"
+    And sets "resource.message" to "Door"
+
+    When sends "bench_subscribe" request
+    Then the status received with "code" is "OK"
+
+    When "<uE1>" starts profiling for <duration_ms> ms
+    And "<uE2>" starts profiling for <duration_ms> ms
+    And "<uE2>" creates data for "loadgen"
+    And sets "topic.entity.name" to "body.access"
+    And sets "topic.entity.id" to "1234"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "door"
+    And sets "topic.resource.id" to "1234"
+    And sets "topic.resource.message" to "Door"
+    And sets "payload_size" to "64"
+    And sets "count" to "<count>"
+    And sends "loadgen" request
+
+    Then "<uE1>" receives <count> benchmark messages within 120 seconds
+    And the flamegraph of "<uE1>" is rendered
+    And the flamegraph of "<uE2>" is rendered
+
+    Examples:
+      | uE1    | uE2    | count | duration_ms |
+      | python | python | 20000 | 3000        |
@@ -0,0 +1,63 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+Feature: Benchmarking client-side send batching
+
+  Scenario Outline: To measure throughput and latency of batching <batch_bytes> bytes for up to <batch_delay_ms> ms
+    Given "<uE2>" warms up publishing 2000 messages of 64 bytes to "<uE1>"
+    And "<uE1>" creates data for "bench_subscribe"
+    And sets "entity.name" to "body.access"
+    And sets "entity.id" to "1234"
+    And sets "entity.version_major" to "1"
+    And sets "resource.name" to "door"
+    And sets "resource.id" to "1234"
+    And sets "resource.message" to "Door"
+
+    When sends "bench_subscribe" request
+    Then the status received with "code" is "OK"
+
+    When the stats of "<uE1>" are taken as baseline
+    And "<uE2>" creates data for "loadgen"
+    And sets "topic.entity.name" to "body.access"
+    And sets "topic.entity.id" to "1234"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "door"
+    And sets "topic.resource.id" to "1234"
+    And sets "topic.resource.message" to "Door"
+    And sets "payload_size" to "64"
+    And sets "count" to "20000"
+    And sets "batch_bytes" to "<batch_bytes>"
+    And sets "batch_delay_ms" to "<batch_delay_ms>"
+    And sends "loadgen" request
+
+    Then "<uE1>" receives 20000 benchmark messages within 120 seconds
+    And "<uE1>" received exactly 20000 messages with 0 parse errors
+    And the benchmark result "batch <batch_bytes> bytes <batch_delay_ms> ms" is recorded
+
+    Examples:
+      | uE1    | uE2    | batch_bytes | batch_delay_ms |
+      | python | python | 0           | 0              |
+      | python | python | 4096        | 1              |
+      | python | python | 16384       | 1              |
+      | python | python | 16384       | 5              |
+      | python | python | 65536       | 5              |
+      | python | python | 65536       | 20             |
@@ -0,0 +1,78 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+Feature: Benchmarking listeners next to a slow listener
+
+  Scenario Outline: To measure throughput and latency of a topic while a listener of another topic takes <delay_ms> ms per message
+    Given "<uE1>" creates data for "slow_subscribe"
+    And sets "topic.entity.name" to "body.access"
+    And sets "topic.entity.id" to "1234"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "window"
+    And sets "topic.resource.id" to "1235"
+    And sets "topic.resource.message" to "Window"
+    And sets "delay_ms" to "<delay_ms>"
+
+    When sends "slow_subscribe" request
+    Then the status received with "code" is "OK"
+
+    When "<uE1>" creates data for "bench_subscribe"
+    And sets "entity.name" to "body.access"
+    And sets "entity.id" to "1234"
+    And sets "entity.version_major" to "1"
+    And sets "resource.name" to "door"
+    And sets "resource.id" to "1234"
+    And sets "resource.message" to "Door"
+
+    When sends "bench_subscribe" request
+    Then the status received with "code" is "OK"
+
+    When "<uE2>" creates data for "loadgen"
+    And sets "topic.entity.name" to "body.access"
+    And sets "topic.entity.id" to "1234"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "window"
+    And sets "topic.resource.id" to "1235"
+    And sets "topic.resource.message" to "Window"
+    And sets "payload_size" to "64"
+    And sets "count" to "200"
+    And sends "loadgen" request
+
+    When "<uE2>" creates data for "loadgen"
+    And sets "topic.entity.name" to "body.access"
+    And sets "topic.entity.id" to "1234"
+    And sets "topic.entity.version_major" to "1"
+    And sets "topic.resource.name" to "door"
+    And sets "topic.resource.id" to "1234"
+    And sets "topic.resource.message" to "Door"
+    And sets "payload_size" to "64"
+    And sets "count" to "5000"
+    And sends "loadgen" request
+
+    Then "<uE1>" receives 5000 benchmark messages within 120 seconds
+    And the benchmark result "fast topic next to <delay_ms> ms listener" is recorded
+
+    Examples:
+      | uE1    | uE2    | delay_ms |
+      | python | python | 0        |
+      | python | python | 5        |
+      | python | python | 20       |
@@ -0,0 +1,48 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+# -------------------------------------------------------------------------
+
+
+Feature: Timing out RPC requests on a virtual clock
+
+  Scenario Outline: To test that an unanswered invoke_method times out once the virtual clock passes its ttl
+    Given "<uE1>" test agent runs on a virtual clock
+      And "<uE1>" creates data for "invokemethod"
+      And sets "entity.name" to "body.access"
+      And sets "resource.name" to "window"
+      And sets "resource.instance" to "rear_left"
+      And sets "resource.message" to "Window"
+      And sets "ttl" to "60000"
+      And sets "payload.format" to "UPAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY"
+      And sets "payload.value" to b".type.googleapis.com/google.protobuf.Int32Value\x12\x02\x08\x03"
+
+    When sends "invokemethod" request without waiting for the response
+      And "<uE1>" advances its clock by 30000 ms
+      And "<uE1>" advances its clock by 30000 ms
+    Then the "invokemethod" response is received
+      And the status received with "code" is "DEADLINE_EXCEEDED"
+
+    Examples:
+      | uE1          |
+      | python#clock |
+      | java#clock   |
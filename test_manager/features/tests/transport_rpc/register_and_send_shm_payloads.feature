@@ -0,0 +1,75 @@
+# -------------------------------------------------------------------------
+#
+# SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to 
+# the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#  http: *www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# SPDX-FileType: SOURCE
+# SPDX-License-Identifier: Apache-2.0
+#
+# -------------------------------------------------------------------------
+
+Feature: Testing Publish and Subscribe of payloads sent through shared memory
+
+  Scenario Outline: To test that every transport receives the value of a payload sent by reference
+    Given "<uE2>" test agent sends large payloads through shared memory
+    And "<uE1>" creates data for "registerlistener"
+    And sets "entity.name" to "camera.front"
+    And sets "entity.id" to "4321"
+    And sets "entity.version_major" to "1"
+    And sets "resource.name" to "frame"
+    And sets "resource.id" to "4321"
+    And sets "resource.message" to "Image"
+
+    When sends "registerlistener" request
+    Then the status received with "code" is "OK"
+
+    When "<uE2>" creates data for "send"
+    And sets "attributes.source.entity.name" to "camera.front"
+    And sets "attributes.source.entity.id" to "4321"
+    And sets "attributes.source.entity.version_major" to "1"
+    And sets "attributes.source.resource.name" to "frame"
+    And sets "attributes.source.resource.id" to "4321"
+    And sets "attributes.source.resource.message" to "Image"
+    And sets "attributes.priority" to "UPRIORITY_CS1"
+    And sets "attributes.type" to "UMESSAGE_TYPE_PUBLISH"
+    And sets "payload.format" to "UPAYLOAD_FORMAT_RAW"
+    And sets "payload.value" to <payload_size> bytes of "x"
+    And sends "send" request
+
+    Then the status received with "code" is "OK"
+      And "<uE1>" sends onreceive message with <payload_size> bytes of "x" as payload
+
+    # Unregister in the end for cleanup
+    When "<uE1>" creates data for "unregisterlistener"
+      And sets "entity.name" to "camera.front"
+      And sets "entity.id" to "4321"
+      And sets "entity.version_major" to "1"
+      And sets "resource.name" to "frame"
+      And sets "resource.id" to "4321"
+      And sets "resource.message" to "Image"
+      And sends "unregisterlistener" request
+
+    Then the status received with "code" is "OK"
+
+    Examples:
+      | uE1    | uE2        | payload_size |
+      | python | python#shm | 65536        |
+      | rust   | python#shm | 65536        |
+      | java   | python#shm | 65536        |
+      | python | python#shm | 1048576      |
+      | rust   | python#shm | 1048576      |
+      | java   | python#shm | 1048576      |
@@ -0,0 +1,166 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import os
+import platform
+import sys
+from typing import Any, Dict, List, Optional, Set
+
+# Userdata defining the CPUs of a process, e.g. --define cpus_dispatcher=2 or --define cpus_python=4-5
+CPUS_PREFIX = "cpus_"
+# CPUs handed out one per Test Agent in spawn order, for Test Agents without CPUs of their own
+AGENT_POOL = "agents"
+SYSFS_CPU_DIR = "/sys/devices/system/cpu"
+SYSFS_NODE_DIR = "/sys/devices/system/node"
+
+
+def supports_affinity() -> bool:
+    return hasattr(os, "sched_setaffinity")
+
+
+def parse_cpu_list(cpu_list: str) -> Set[int]:
+    """Parses a CPU list as taskset and sysfs write it, e.g. "0-3,6" """
+    cpus: Set[int] = set()
+    for part in cpu_list.split(","):
+        part = part.strip()
+        if not part:
+            continue
+        if "-" in part:
+            first, last = part.split("-")
+            cpus.update(range(int(first), int(last) + 1))
+        else:
+            cpus.add(int(part))
+    return cpus
+
+
+def format_cpu_list(cpus: Set[int]) -> str:
+    """Formats CPUs as a CPU list, e.g. {0, 1, 2, 3, 6} as "0-3,6" """
+    ranges: List[List[int]] = []
+    for cpu in sorted(cpus):
+        if ranges and ranges[-1][1] == cpu - 1:
+            ranges[-1][1] = cpu
+        else:
+            ranges.append([cpu, cpu])
+    return ",".join(str(first) if first == last else f"{first}-{last}" for first, last in ranges)
+
+
+class CpuPlan:
+    def __init__(self, userdata: Dict[str, str]) -> None:
+        """
+        Assigns CPUs to the Test Manager, the Dispatcher and the Test Agents from the run configuration, e.g.
+        --define cpus_tm=0 --define cpus_dispatcher=1 --define cpus_agents=2-5.
+        A Test Agent is pinned to the CPUs defined for its name, e.g. cpus_python#2, else for its SDK, e.g.
+        cpus_python, else to the next CPU of the agents pool. Processes without CPUs float as before.
+        """
+        self.cpus: Dict[str, Set[int]] = {
+            name[len(CPUS_PREFIX) :]: parse_cpu_list(value)
+            for name, value in userdata.items()
+            if name.startswith(CPUS_PREFIX) and value
+        }
+        self.agent_pool: List[int] = sorted(self.cpus.pop(AGENT_POOL, set()))
+        self.next_pool_index: int = 0
+        # Process name -> CPUs it was pinned to, recorded in the topology
+        self.assigned: Dict[str, Set[int]] = {}
+
+    def cpus_of(self, process_name: str) -> Optional[Set[int]]:
+        return self.cpus.get(process_name)
+
+    def cpus_of_test_agent(self, test_agent_name: str, sdk_name: str) -> Optional[Set[int]]:
+        cpus: Optional[Set[int]] = self.cpus.get(test_agent_name, self.cpus.get(sdk_name))
+        if cpus is None and self.agent_pool:
+            cpus = {self.agent_pool[self.next_pool_index % len(self.agent_pool)]}
+            self.next_pool_index += 1
+        return cpus
+
+    def assign(self, process_name: str, cpus: Optional[Set[int]]) -> Optional[Set[int]]:
+        """Records the CPUs of a process, which float if there are none or the platform cannot pin them"""
+        if cpus is None or not supports_affinity():
+            return None
+        self.assigned[process_name] = cpus
+        return cpus
+
+    def pin_current_process(self, process_name: str) -> None:
+        """Pins the calling process, threads started afterwards inherit its CPUs"""
+        cpus: Optional[Set[int]] = self.assign(process_name, self.cpus_of(process_name))
+        if cpus is not None:
+            os.sched_setaffinity(0, cpus)
+
+
+def read_sysfs(path: str) -> Optional[str]:
+    try:
+        with open(path) as sysfs_file:
+            return sysfs_file.read().strip()
+    except OSError:
+        return None
+
+
+def cpu_model() -> str:
+    try:
+        with open("/proc/cpuinfo") as cpuinfo:
+            for line in cpuinfo:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return platform.processor()
+
+
+def cpu_topology(cpu: int) -> Dict[str, Any]:
+    """Where a CPU sits, so pinning two processes to SMT siblings or to different NUMA nodes shows in the report"""
+    cpu_dir: str = os.path.join(SYSFS_CPU_DIR, f"cpu{cpu}")
+    topology_dir: str = os.path.join(cpu_dir, "topology")
+    nodes: List[str] = []
+    if os.path.isdir(cpu_dir):
+        nodes = [entry[len("node") :] for entry in os.listdir(cpu_dir) if entry.startswith("node")]
+    return {
+        "core_id": read_sysfs(os.path.join(topology_dir, "core_id")),
+        "package_id": read_sysfs(os.path.join(topology_dir, "physical_package_id")),
+        "thread_siblings": read_sysfs(os.path.join(topology_dir, "thread_siblings_list")),
+        "numa_node": nodes[0] if nodes else None,
+        "max_frequency_khz": read_sysfs(os.path.join(cpu_dir, "cpufreq", "cpuinfo_max_freq")),
+        "governor": read_sysfs(os.path.join(cpu_dir, "cpufreq", "scaling_governor")),
+    }
+
+
+def topology(plan: CpuPlan, dispatcher_mode: str) -> Dict[str, Any]:
+    """Describes the machine and the placement of the processes, recorded with every benchmark result"""
+    pinned: Set[int] = set().union(*plan.assigned.values()) if plan.assigned else set()
+    return {
+        "platform": platform.platform(),
+        "python": sys.version.split()[0],
+        "cpu_model": cpu_model(),
+        "cpu_count": os.cpu_count(),
+        "online_cpus": read_sysfs(os.path.join(SYSFS_CPU_DIR, "online")),
+        "isolated_cpus": read_sysfs(os.path.join(SYSFS_CPU_DIR, "isolated")),
+        "numa_nodes": read_sysfs(os.path.join(SYSFS_NODE_DIR, "online")),
+        "smt": read_sysfs(os.path.join(SYSFS_CPU_DIR, "smt", "control")),
+        "dispatcher": dispatcher_mode,
+        "affinity": {process_name: format_cpu_list(cpus) for process_name, cpus in sorted(plan.assigned.items())},
+        "pinned_cpus": {str(cpu): cpu_topology(cpu) for cpu in sorted(pinned)},
+    }
+
+
+def process_cpu_seconds(pid: int) -> float:
+    """User and system CPU time of another process, from /proc/<pid>/stat"""
+    try:
+        with open(f"/proc/{pid}/stat") as stat:
+            # The command name in parentheses may contain spaces, the fields after it do not
+            fields: List[str] = stat.read().rsplit(")", 1)[1].split()
+    except OSError:
+        return 0.0
+    # utime and stime are the 14th and 15th field, the 12th and 13th after the command name
+    return (int(fields[11]) + int(fields[12])) / os.sysconf("SC_CLK_TCK")
@@ -0,0 +1,132 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import json
+import os
+import statistics
+from typing import Any, Dict, List
+
+from test_manager.features.utils import affinityutils
+
+# Benchmark results are written next to the behave reports
+BENCHMARK_REPORT_DIR = os.path.join("reports", "benchmarks")
+# Warmup rounds whose throughput varies by at most STEADY_MAX_CV of its mean over the last STEADY_WINDOW of them
+# are steady
+STEADY_WINDOW: int = 3
+STEADY_MAX_CV: float = 0.05
+MAX_WARMUP_ROUNDS: int = 20
+
+
+class SteadyStateDetector:
+    def __init__(
+        self,
+        window: int = STEADY_WINDOW,
+        max_cv: float = STEADY_MAX_CV,
+        min_rounds: int = 0,
+        max_rounds: int = MAX_WARMUP_ROUNDS,
+    ) -> None:
+        """
+        Decides when a warmup is over: once the throughput of the last window rounds varies by at most max_cv,
+        its coefficient of variation, so JIT compilation, lazy imports and growing thread pools no longer skew it.
+
+        :param window: Rounds the variation is measured over.
+        :param max_cv: Largest standard deviation relative to the mean that counts as steady.
+        :param min_rounds: Rounds to warm up even if steady earlier.
+        :param max_rounds: Rounds after which the warmup ends unsteady.
+        """
+        self.window = max(window, 2)
+        self.max_cv = max_cv
+        self.min_rounds = min_rounds
+        self.max_rounds = max(max_rounds, min_rounds)
+        self.samples: List[float] = []
+
+    def add(self, throughput: float) -> None:
+        self.samples.append(throughput)
+
+    def window_cv(self) -> float:
+        """Coefficient of variation of the last window rounds, infinite until there are enough of them"""
+        if len(self.samples) < self.window:
+            return float("inf")
+        recent: List[float] = self.samples[-self.window :]
+        mean: float = statistics.fmean(recent)
+        return statistics.stdev(recent) / mean if mean > 0 else float("inf")
+
+    def is_steady(self) -> bool:
+        return len(self.samples) >= self.min_rounds and self.window_cv() <= self.max_cv
+
+    def is_done(self) -> bool:
+        return self.is_steady() or len(self.samples) >= self.max_rounds
+
+    def report(self) -> Dict[str, Any]:
+        """The warmup rounds, reported apart from the measured results"""
+        cv: float = self.window_cv()
+        return {
+            "rounds": len(self.samples),
+            "throughput": self.samples,
+            "steady": self.is_steady(),
+            "window_cv": cv if cv != float("inf") else None,
+            "window": self.window,
+            "max_cv": self.max_cv,
+        }
+
+
+def throughput_result(
+    label: str, loadgen: Dict[str, Any], received: Dict[str, Any], dispatcher_cpu_s: float = 0.0
+) -> Dict[str, Any]:
+    """Combines the "loadgen" response of the publisher and the "bench_results" response of the subscriber
+
+    :param label: Names the measured configuration, e.g. the payload size
+    :param loadgen: Response data of the publishing Test Agent
+    :param received: Response data of the subscribing Test Agent
+    :param dispatcher_cpu_s: CPU time the Dispatcher spent forwarding, if it runs on this machine
+    :return: Throughput, latency and CPU cost of the run
+    """
+    duration_s: float = max((received["last_receive_ns"] - loadgen["start_ns"]) / 1e9, 1e-9)
+    cpu_s: float = loadgen["cpu_s"] + received["cpu_s"] + dispatcher_cpu_s
+    gigabytes: float = received["bytes"] / 1e9
+    return {
+        "label": label,
+        "messages": received["count"],
+        "bytes": received["bytes"],
+        "duration_s": duration_s,
+        "messages_per_s": received["count"] / duration_s,
+        "throughput_mb_s": received["bytes"] / 1e6 / duration_s,
+        "latency_mean_ms": received.get("latency_sum_ns", 0) / 1e6 / max(received["count"], 1),
+        "latency_max_ms": received.get("latency_max_ns", 0) / 1e6,
+        "cpu_s": cpu_s,
+        "cpu_s_per_gb": cpu_s / gigabytes if gigabytes > 0 else None,
+        "listener_dispatch": received.get("listener_dispatch", {}),
+    }
+
+
+def record_result(context, result: Dict[str, Any]):
+    """Appends a result to the benchmark report of the running feature file
+
+    :param context: Holds contextual information, the results are kept in context.benchmark_results
+    :param result: One measured configuration
+    """
+    # Makes results comparable across machines and pinnings
+    result["topology"] = affinityutils.topology(context.cpu_plan, context.transport.get("dispatcher"))
+    if not hasattr(context, "benchmark_results"):
+        context.benchmark_results = {}
+    report_name: str = os.path.splitext(os.path.basename(context.feature.filename))[0]
+    results = context.benchmark_results.setdefault(report_name, [])
+    results.append(result)
+
+    os.makedirs(BENCHMARK_REPORT_DIR, exist_ok=True)
+    with open(os.path.join(BENCHMARK_REPORT_DIR, report_name + ".json"), "w") as report:
+        json.dump(results, report, indent=2)
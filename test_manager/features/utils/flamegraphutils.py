@@ -0,0 +1,117 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import html
+import os
+import zlib
+from typing import Any, Dict, List
+
+# Flamegraphs are written next to the behave reports
+FLAMEGRAPH_REPORT_DIR = os.path.join("reports", "flamegraphs")
+IMAGE_WIDTH: int = 1200
+FRAME_HEIGHT: int = 16
+HEADER_HEIGHT: int = 32
+# Frames narrower than this are left out, they could not be told apart anyway
+MIN_FRAME_WIDTH: float = 0.1
+
+
+def parse_collapsed(collapsed: str) -> Dict[str, int]:
+    """Parses collapsed stacks, one per line followed by its number of samples, as answered by "profile" """
+    stacks: Dict[str, int] = {}
+    for line in collapsed.splitlines():
+        stack, _, count = line.rpartition(" ")
+        if stack and count.isdigit():
+            stacks[stack] = stacks.get(stack, 0) + int(count)
+    return stacks
+
+
+def build_tree(stacks: Dict[str, int]) -> Dict[str, Any]:
+    """Merges the stacks into a tree of frames, each counting the samples it appears in"""
+    root: Dict[str, Any] = {"name": "all", "count": 0, "children": {}}
+    for stack, count in stacks.items():
+        root["count"] += count
+        node = root
+        for frame in stack.split(";"):
+            node = node["children"].setdefault(frame, {"name": frame, "count": 0, "children": {}})
+            node["count"] += count
+    return root
+
+
+def frame_color(name: str) -> str:
+    """Warm colors as usual for flamegraphs, stable per frame name so that graphs can be compared"""
+    seed: int = zlib.crc32(name.encode("utf-8"))
+    return f"rgb({205 + seed % 50},{(seed >> 8) % 230},{(seed >> 16) % 55})"
+
+
+def render_svg(stacks: Dict[str, int], title: str) -> str:
+    """
+    Renders collapsed stacks as a flamegraph: the outermost frames at the bottom, each frame as wide as the share
+    of samples it appears in, its callees above it in alphabetical order.
+
+    :param stacks: Collapsed stack -> number of samples.
+    :param title: Shown above the graph.
+    :return: A standalone SVG image, hovering a frame shows its samples.
+    """
+    root: Dict[str, Any] = build_tree(stacks)
+    depth: int = max((stack.count(";") + 2 for stack in stacks), default=1)
+    height: int = HEADER_HEIGHT + depth * FRAME_HEIGHT
+    pixels_per_sample: float = IMAGE_WIDTH / max(root["count"], 1)
+
+    rects: List[str] = []
+
+    def render(node: Dict[str, Any], x: float, level: int):
+        width: float = node["count"] * pixels_per_sample
+        if width < MIN_FRAME_WIDTH:
+            return
+        y: int = height - (level + 1) * FRAME_HEIGHT
+        percent: float = 100 * node["count"] / max(root["count"], 1)
+        name: str = html.escape(node["name"])
+        # Roughly 7 pixels per character of the 12 pixel font
+        label: str = html.escape(node["name"][: int(width / 7)]) if width > 21 else ""
+        rects.append(
+            f'<g><title>{name} ({node["count"]} samples, {percent:.2f}%)</title>'
+            f'<rect x="{x:.1f}" y="{y}" width="{width:.1f}" height="{FRAME_HEIGHT - 1}" '
+            f'fill="{frame_color(node["name"])}" rx="2"/>'
+            f'<text x="{x + 3:.1f}" y="{y + FRAME_HEIGHT - 4}">{label}</text></g>'
+        )
+        for child_name in sorted(node["children"]):
+            child = node["children"][child_name]
+            render(child, x, level + 1)
+            x += child["count"] * pixels_per_sample
+
+    render(root, 0.0, 0)
+    return (
+        f'<svg xmlns="http://www.w3.org/2000/svg" width="{IMAGE_WIDTH}" height="{height}" '
+        f'viewBox="0 0 {IMAGE_WIDTH} {height}" font-family="Verdana" font-size="12">'
+        f'<rect width="100%" height="100%" fill="#f8f8f8"/>'
+        f'<text x="{IMAGE_WIDTH / 2}" y="20" text-anchor="middle" font-size="16">{html.escape(title)}</text>'
+        f'{"".join(rects)}</svg>'
+    )
+
+
+def write_flamegraph(report_name: str, collapsed: str, title: str) -> str:
+    """Writes the collapsed stacks and their flamegraph as <report_name>.collapsed and <report_name>.svg
+
+    :return: Path of the flamegraph
+    """
+    os.makedirs(FLAMEGRAPH_REPORT_DIR, exist_ok=True)
+    with open(os.path.join(FLAMEGRAPH_REPORT_DIR, report_name + ".collapsed"), "w") as collapsed_file:
+        collapsed_file.write(collapsed)
+    svg_path: str = os.path.join(FLAMEGRAPH_REPORT_DIR, report_name + ".svg")
+    with open(svg_path, "w") as svg_file:
+        svg_file.write(render_svg(parse_collapsed(collapsed), title))
+    return svg_path
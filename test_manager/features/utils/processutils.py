@@ -0,0 +1,77 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import os
+import socket
+import subprocess
+import sys
+import time
+from typing import List, Optional, Set
+
+from dispatcher.dispatcher import DISPATCHER_ADDR
+from test_manager.features.utils import affinityutils
+
+# Paths from the repository root
+PYTHON_TA_PATH = "/test_agent/python/testagent.py"
+PYTHON_TA_SERVER_PATH = "/test_agent/python/agentserver.py"
+JAVA_TA_PATH = "/test_agent/java/target/tck-test-agent-java-jar-with-dependencies.jar"
+# Written by "mvn package -Pappcds", used by the JVM when present
+JAVA_TA_CDS_ARCHIVE_PATH = "/test_agent/java/target/tck-test-agent-java.jsa"
+RUST_TA_PATH = "/test_agent/rust/target/debug/rust_tck"
+CPP_TA_PATH = "/test_agent/cpp/build/cpp_tck"
+DISPATCHER_PATH = "/dispatcher/dispatcher.py"
+# The repository root, three levels above this file
+REPO_ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..", ".."))
+
+
+def create_subprocess(command: List[str], cpus: Optional[Set[int]] = None) -> subprocess.Popen:
+    """Spawns a process, pinned to the given CPUs before it executes the command so all its threads inherit them"""
+    if sys.platform == "win32":
+        process = subprocess.Popen(command, shell=True)
+    elif cpus is not None:
+        process = subprocess.Popen(command, preexec_fn=lambda: os.sched_setaffinity(0, cpus))
+    elif sys.platform == "linux" or sys.platform == "linux2" or sys.platform == "darwin":
+        process = subprocess.Popen(command)
+    else:
+        print(sys.platform)
+        raise Exception("only handle Windows and Linux commands for now")
+    return process
+
+
+class DispatcherProcess:
+    """The Dispatcher run as a process of its own, closed like the Dispatcher thread"""
+
+    def __init__(self, process: subprocess.Popen):
+        self.process = process
+
+    def wait_until_listening(self, timeout_s: float = 30):
+        deadline: float = time.time() + timeout_s
+        while True:
+            try:
+                socket.create_connection(DISPATCHER_ADDR, timeout=1).close()
+                return
+            except OSError:
+                if self.process.poll() is not None or time.time() > deadline:
+                    raise RuntimeError("Dispatcher process is not running")
+                time.sleep(0.01)
+
+    def cpu_seconds(self) -> float:
+        return affinityutils.process_cpu_seconds(self.process.pid)
+
+    def close(self):
+        self.process.terminate()
+        self.process.wait()
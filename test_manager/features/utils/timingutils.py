@@ -0,0 +1,231 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import html
+import json
+import os
+import time
+from collections import defaultdict
+from typing import Any, Dict, List, Optional
+
+from test_manager.testmanager import resolve_test_agent_alias
+
+# Not under reports/, where CI reads every JSON file as a behave result
+TIMING_REPORT_DIR = "reports_timing"
+SLOWEST_STEPS: int = 20
+# Step arguments naming the Test Agent a step addresses
+TEST_AGENT_ARGUMENTS = ("sdk_name", "sender_sdk_name")
+
+
+class SuiteTimings:
+    def __init__(self) -> None:
+        """
+        Collects the monotonic durations of the steps, scenarios and features of a behave run, so the steps
+        dominating suite time can be told apart: spawning Test Agents, waiting, Test Manager round trips or
+        assertions.
+        """
+        self.steps: List[Dict[str, Any]] = []
+        # feature -> scenario -> duration
+        self.scenarios: Dict[str, Dict[str, float]] = defaultdict(dict)
+        self.features: Dict[str, float] = {}
+        self.feature_started_at: float = 0.0
+        self.scenario_started_at: float = 0.0
+        self.step_started_at: float = 0.0
+
+    def start_feature(self) -> None:
+        self.feature_started_at = time.perf_counter()
+
+    def end_feature(self, feature) -> None:
+        self.features[feature.name] = time.perf_counter() - self.feature_started_at
+
+    def start_scenario(self) -> None:
+        self.scenario_started_at = time.perf_counter()
+
+    def end_scenario(self, scenario) -> None:
+        self.scenarios[scenario.feature.name][scenario.name] = time.perf_counter() - self.scenario_started_at
+
+    def start_step(self) -> None:
+        self.step_started_at = time.perf_counter()
+
+    def end_step(self, context, step) -> None:
+        duration_s: float = time.perf_counter() - self.step_started_at
+        self.steps.append(
+            {
+                "feature": context.feature.name,
+                "scenario": context.scenario.name,
+                "step": f"{step.keyword} {step.name}",
+                "definition": step.match.func.__name__ if step.match is not None else None,
+                "location": str(step.location),
+                "status": step.status.name,
+                "test_agent": step_test_agent(context, step),
+                "duration_s": duration_s,
+            }
+        )
+
+    def report(self, request_timings: Dict[str, Dict[str, float]]) -> Dict[str, Any]:
+        """
+        Returns the slowest steps, and per feature its scenarios and the time spent in each step definition.
+        Per Test Agent the time of the steps addressing it and the round trips of its requests are summed up.
+
+        :param request_timings: Round trip times per Test Agent, from TestManager.get_request_timings()
+        """
+        features: Dict[str, Dict[str, Any]] = {}
+        test_agents: Dict[str, Dict[str, Any]] = defaultdict(lambda: {"steps": 0, "step_total_s": 0.0})
+        for step in self.steps:
+            feature = features.setdefault(
+                step["feature"],
+                {
+                    "duration_s": self.features.get(step["feature"]),
+                    "scenarios": self.scenarios.get(step["feature"], {}),
+                    "definitions": {},
+                },
+            )
+            definition = feature["definitions"].setdefault(
+                step["definition"] or "undefined", {"steps": 0, "total_s": 0.0, "max_s": 0.0}
+            )
+            definition["steps"] += 1
+            definition["total_s"] += step["duration_s"]
+            definition["max_s"] = max(definition["max_s"], step["duration_s"])
+
+            if step["test_agent"] is not None:
+                test_agents[step["test_agent"]]["steps"] += 1
+                test_agents[step["test_agent"]]["step_total_s"] += step["duration_s"]
+
+        for feature in features.values():
+            feature["definitions"] = dict(
+                sorted(feature["definitions"].items(), key=lambda item: item[1]["total_s"], reverse=True)
+            )
+        for test_agent_name, stats in request_timings.items():
+            test_agents[test_agent_name].update(stats)
+
+        return {
+            "total_s": sum(self.features.values()),
+            "slowest_steps": sorted(self.steps, key=lambda step: step["duration_s"], reverse=True)[:SLOWEST_STEPS],
+            "features": features,
+            "test_agents": dict(test_agents),
+        }
+
+
+def step_test_agent(context, step) -> Optional[str]:
+    """Returns the Test Agent a step addresses: the one named by the step, else the one of the previous steps"""
+    if step.match is not None:
+        for argument in step.match.arguments:
+            if argument.name in TEST_AGENT_ARGUMENTS:
+                return resolve_test_agent_alias(argument.value, context.config.userdata)
+    return getattr(context, "ue", None)
+
+
+def render_html(report: Dict[str, Any]) -> str:
+    """Renders the timing report as a standalone HTML page"""
+
+    def table(headers: List[str], rows: List[List[Any]]) -> str:
+        cells = "".join(f"<th>{html.escape(header)}</th>" for header in headers)
+        lines = [f"<tr>{cells}</tr>"]
+        for row in rows:
+            cells = "".join(
+                f"<td>{value:.3f}</td>" if isinstance(value, float) else f"<td>{html.escape(str(value))}</td>"
+                for value in row
+            )
+            lines.append(f"<tr>{cells}</tr>")
+        return "<table>" + "".join(lines) + "</table>"
+
+    sections: List[str] = [
+        f"<h1>Suite timing, {report['total_s']:.3f} s</h1>",
+        "<h2>Slowest steps</h2>",
+        table(
+            ["Duration (s)", "Step", "Scenario", "Feature", "Test Agent", "Status", "Location"],
+            [
+                [
+                    step["duration_s"],
+                    step["step"],
+                    step["scenario"],
+                    step["feature"],
+                    step["test_agent"] or "",
+                    step["status"],
+                    step["location"],
+                ]
+                for step in report["slowest_steps"]
+            ],
+        ),
+        "<h2>Test Agents</h2>",
+        table(
+            [
+                "Test Agent",
+                "Steps",
+                "Step total (s)",
+                "Requests",
+                "Round trip total (s)",
+                "Round trip max (s)",
+                "Timeouts",
+            ],
+            [
+                [
+                    name,
+                    stats["steps"],
+                    stats["step_total_s"],
+                    stats.get("requests", 0),
+                    stats.get("round_trip_total_s", 0.0),
+                    stats.get("round_trip_max_s", 0.0),
+                    stats.get("timeouts", 0),
+                ]
+                for name, stats in report["test_agents"].items()
+            ],
+        ),
+    ]
+    for name, feature in report["features"].items():
+        duration_s: Optional[float] = feature["duration_s"]
+        sections.append(f"<h2>{html.escape(name)}, {duration_s or 0.0:.3f} s</h2>")
+        sections.append(
+            table(
+                ["Step definition", "Steps", "Total (s)", "Max (s)"],
+                [
+                    [definition, stats["steps"], stats["total_s"], stats["max_s"]]
+                    for definition, stats in feature["definitions"].items()
+                ],
+            )
+        )
+        sections.append(
+            table(
+                ["Scenario", "Duration (s)"],
+                [[scenario, duration] for scenario, duration in feature["scenarios"].items()],
+            )
+        )
+    style = "table{border-collapse:collapse;margin-bottom:1em}td,th{border:1px solid #ccc;padding:2px 6px}"
+    return (
+        f"<!DOCTYPE html><html><head><meta charset='utf-8'><title>Suite timing</title><style>{style}</style></head>"
+        f"<body>{''.join(sections)}</body></html>"
+    )
+
+
+def run_name(config) -> str:
+    """Names the timing reports of a behave run after its first outfile, else after the paths it runs, so that the
+    runs of a CI job, one per feature, do not overwrite each other's reports
+    """
+    for outfile in getattr(config, "outfiles", None) or []:
+        if outfile and outfile != "-":
+            return os.path.splitext(os.path.basename(outfile))[0]
+    stems: List[str] = [os.path.splitext(os.path.basename(path.rstrip("/\\")))[0] for path in config.paths or []]
+    return "_".join(stems) or "features"
+
+
+def write_reports(report: Dict[str, Any], name: str):
+    """Writes the timing report as <name>.json and <name>.html to TIMING_REPORT_DIR"""
+    os.makedirs(TIMING_REPORT_DIR, exist_ok=True)
+    with open(os.path.join(TIMING_REPORT_DIR, f"{name}.json"), "w") as json_report:
+        json.dump(report, json_report, indent=2)
+    with open(os.path.join(TIMING_REPORT_DIR, f"{name}.html"), "w") as html_report:
+        html_report.write(render_html(report))
@@ -0,0 +1,577 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import argparse
+import base64
+import csv
+import json
+import logging
+import math
+import os
+import statistics
+import subprocess
+import sys
+import time
+from threading import Thread
+from typing import Any, Callable, Dict, List, Optional, Set, Tuple
+
+# The repository root, one level above this file
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..")))
+
+from test_manager.features.utils import affinityutils, benchutils
+from test_manager.features.utils.processutils import (
+    CPP_TA_PATH,
+    DISPATCHER_PATH,
+    JAVA_TA_CDS_ARCHIVE_PATH,
+    JAVA_TA_PATH,
+    PYTHON_TA_PATH,
+    REPO_ROOT,
+    RUST_TA_PATH,
+    DispatcherProcess,
+    create_subprocess,
+)
+from test_manager.testmanager import INSTANCE_SEPARATOR, TestManager
+
+logger = logging.getLogger("tck-bench")
+TM_ADDR = ("127.0.0.5", 12345)
+BENCH_REPORT_DIR = os.path.join("reports", "bench")
+TEST_AGENT_CONNECT_TIMEOUT_S: float = 60
+# Two-sided 95% quantiles of Student's t distribution by degrees of freedom, the normal quantile beyond 30
+T_95: Dict[int, float] = {
+    1: 12.706,
+    2: 4.303,
+    3: 3.182,
+    4: 2.776,
+    5: 2.571,
+    6: 2.447,
+    7: 2.365,
+    8: 2.306,
+    9: 2.262,
+    10: 2.228,
+    12: 2.179,
+    15: 2.131,
+    20: 2.086,
+    25: 2.060,
+    30: 2.042,
+}
+BENCH_TOPIC: Dict[str, Any] = {
+    "entity": {"name": "body.access", "id": "1234", "version_major": "1"},
+    "resource": {"name": "door", "id": "1234", "message": "Door"},
+}
+RPC_METHOD: Dict[str, Any] = {
+    "entity": {"name": "body.access", "id": "1234", "version_major": "1"},
+    "resource": {"name": "rpc", "instance": "bench", "id": "5"},
+}
+RPC_PAYLOAD: Dict[str, Any] = {
+    "format": "UPAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY",
+    "value": r"BYTES:.type.googleapis.com/google.protobuf.Int32Value\x12\x02\x08\x03",
+}
+# Request data of the serializer actions
+SERIALIZER_DATA: Dict[str, Any] = {
+    "uri_serialize": BENCH_TOPIC,
+    "micro_serialize_uri": BENCH_TOPIC,
+    "uri_deserialize": "/body.access/1/door#Door",
+    # The micro form of BENCH_TOPIC, one "iso-8859-1" character per byte
+    "micro_deserialize_uri": "\x01\x00\x00\x05\x04\xd2\x01\x00",
+}
+# The examples of long_uri_serializer.feature and long_uri_deserializer.feature, which "serializer_bulk" runs:
+# authority name, entity name, version major, resource name, instance, message and the long form
+LONG_URI_VECTORS: List[Tuple[str, str, str, str, str, str, str]] = [
+    ("", "neelam", "0", "rpc", "test", "", "/neelam//rpc.test"),
+    ("", "neelam", "0", "", "", "", "/neelam"),
+    ("", "neelam", "1", "", "", "", "/neelam/1"),
+    ("", "neelam", "0", "test", "", "", "/neelam//test"),
+    ("", "neelam", "1", "test", "", "", "/neelam/1/test"),
+    ("", "neelam", "0", "test", "front", "", "/neelam//test.front"),
+    ("", "neelam", "1", "test", "front", "", "/neelam/1/test.front"),
+    ("", "neelam", "0", "test", "front", "Test", "/neelam//test.front#Test"),
+    ("", "neelam", "1", "test", "front", "Test", "/neelam/1/test.front#Test"),
+    ("vcu.my_car_vin", "neelam", "0", "", "", "", "//vcu.my_car_vin/neelam"),
+    ("vcu.my_car_vin", "neelam", "1", "", "", "", "//vcu.my_car_vin/neelam/1"),
+    ("vcu.my_car_vin", "neelam", "1", "test", "", "", "//vcu.my_car_vin/neelam/1/test"),
+    ("vcu.my_car_vin", "neelam", "0", "test", "", "", "//vcu.my_car_vin/neelam//test"),
+    ("vcu.my_car_vin", "neelam", "1", "test", "front", "", "//vcu.my_car_vin/neelam/1/test.front"),
+    ("vcu.my_car_vin", "neelam", "0", "test", "front", "", "//vcu.my_car_vin/neelam//test.front"),
+    ("vcu.my_car_vin", "neelam", "1", "test", "front", "Test", "//vcu.my_car_vin/neelam/1/test.front#Test"),
+    ("vcu.my_car_vin", "neelam", "0", "test", "front", "Test", "//vcu.my_car_vin/neelam//test.front#Test"),
+    ("vcu.my_car_vin", "petapp", "0", "rpc", "response", "", "//vcu.my_car_vin/petapp//rpc.response"),
+]
+# The examples of micro_uri_serializer.feature and micro_uri_deserializer.feature that have a micro form:
+# authority id, entity id, version major, resource id and the base64 encoded micro form
+MICRO_URI_VECTORS: List[Tuple[str, str, str, str, str]] = [
+    ("", "1", "0", "1", "AQAAAQABAAA="),
+    ("", "1", "1", "1", "AQAAAQABAQA="),
+    ("", "2", "1", "3", "AQAAAwACAQA="),
+    ("", "0", "0", "0", "AQAAAAAAAAA="),
+    ("", "100", "1", "300", "AQABLABkAQA="),
+    ("", "255", "0", "255", "AQAA/wD/AAA="),
+    ("", "256", "1", "256", "AQABAAEAAQA="),
+    ("unique id 1234", "29999", "254", "99", "AQMAY3Uv/gAOdW5pcXVlIGlkIDEyMzQ="),
+]
+# Serializers the "run_vectors" action runs
+RUN_VECTORS_SERIALIZERS = ("uri_serialize", "uri_deserialize", "micro_serialize_uri", "micro_deserialize_uri")
+
+
+def t_quantile(degrees_of_freedom: int) -> float:
+    if degrees_of_freedom > max(T_95):
+        return 1.96
+    # Rounds down to the tabulated degrees of freedom, which widens the interval
+    return T_95[max(df for df in T_95 if df <= degrees_of_freedom)]
+
+
+def summarize(values: List[float]) -> Dict[str, float]:
+    """Mean and 95% confidence interval of the repetitions of a metric"""
+    mean: float = statistics.fmean(values)
+    stdev: float = statistics.stdev(values) if len(values) > 1 else 0.0
+    half_width: float = t_quantile(len(values) - 1) * stdev / math.sqrt(len(values)) if len(values) > 1 else 0.0
+    return {
+        "n": len(values),
+        "mean": mean,
+        "stdev": stdev,
+        "ci95_low": mean - half_width,
+        "ci95_high": mean + half_width,
+        "min": min(values),
+        "max": max(values),
+    }
+
+
+def test_agent_command(sdk_name: str, instance_id: str, transport: str) -> List[str]:
+    if sdk_name == "python":
+        command: List[str] = [sys.executable, REPO_ROOT + PYTHON_TA_PATH]
+    elif sdk_name == "java":
+        command = ["java"]
+        if os.path.isfile(REPO_ROOT + JAVA_TA_CDS_ARCHIVE_PATH):
+            command.append("-XX:SharedArchiveFile=" + REPO_ROOT + JAVA_TA_CDS_ARCHIVE_PATH)
+        command.extend(["-jar", REPO_ROOT + JAVA_TA_PATH])
+    elif sdk_name == "rust":
+        command = [REPO_ROOT + RUST_TA_PATH]
+    elif sdk_name == "cpp":
+        command = [REPO_ROOT + CPP_TA_PATH]
+    else:
+        raise ValueError("Invalid SDK name")
+    return command + ["--transport", transport, "--instance-id", instance_id]
+
+
+def expect_ok(response: Dict[str, Any], action: str):
+    if int(response["data"].get("code", 0)) != 0:
+        raise RuntimeError(f'"{action}" failed: {response["data"]}')
+
+
+class Bench:
+    def __init__(self, transport: str, plan: affinityutils.CpuPlan) -> None:
+        """
+        Runs the Test Manager, the Dispatcher and the Test Agents of one benchmark without behave.
+        The Dispatcher always runs as a process, so its CPU time can be measured like the Test Agents'.
+        """
+        self.transport = transport
+        self.plan = plan
+        self.tm: Optional[TestManager] = None
+        self.tm_thread: Optional[Thread] = None
+        self.dispatcher: Optional[DispatcherProcess] = None
+        self.test_agents: Dict[str, subprocess.Popen] = {}
+
+    def start(self):
+        self.plan.pin_current_process("tm")
+        self.tm = TestManager(None, *TM_ADDR)
+        self.tm_thread = Thread(target=self.tm.listen_for_incoming_events, daemon=True)
+        self.tm_thread.start()
+        if self.transport == "socket":
+            cpus: Optional[Set[int]] = self.plan.assign("dispatcher", self.plan.cpus_of("dispatcher"))
+            self.dispatcher = DispatcherProcess(create_subprocess([sys.executable, REPO_ROOT + DISPATCHER_PATH], cpus))
+            self.dispatcher.wait_until_listening()
+
+    def spawn_test_agents(self, test_agent_names: List[str]):
+        """Spawns the Test Agents, e.g. "python#1", and waits until all of them are connected"""
+        for test_agent_name in test_agent_names:
+            sdk_name, instance_id = test_agent_name.split(INSTANCE_SEPARATOR)
+            cpus: Optional[Set[int]] = self.plan.assign(
+                test_agent_name, self.plan.cpus_of_test_agent(test_agent_name, sdk_name)
+            )
+            command: List[str] = test_agent_command(sdk_name, instance_id, self.transport)
+            self.test_agents[test_agent_name] = create_subprocess(command, cpus)
+
+        deadline: float = time.time() + TEST_AGENT_CONNECT_TIMEOUT_S
+        for test_agent_name in test_agent_names:
+            while not self.tm.has_sdk_connection(test_agent_name):
+                if self.test_agents[test_agent_name].poll() is not None or time.time() > deadline:
+                    raise RuntimeError(f"Test Agent {test_agent_name} did not connect")
+                time.sleep(0.01)
+
+    def cpu_seconds(self) -> float:
+        """CPU time of the Test Agents and the Dispatcher so far, the Test Manager only waits meanwhile"""
+        cpu_s: float = sum(affinityutils.process_cpu_seconds(process.pid) for process in self.test_agents.values())
+        if self.dispatcher is not None:
+            cpu_s += self.dispatcher.cpu_seconds()
+        return cpu_s
+
+    def close(self):
+        if self.tm is not None:
+            for test_agent_name in self.tm.get_test_agent_names():
+                self.tm.close_test_agent(test_agent_name)
+            # Lets the event loop finish its select before the selector is closed
+            self.tm.exit_manager = True
+            self.tm_thread.join()
+            self.tm.close()
+        for process in self.test_agents.values():
+            process.terminate()
+        if self.dispatcher is not None:
+            self.dispatcher.close()
+
+
+def subscriber_names(args: argparse.Namespace) -> List[str]:
+    return [f"{args.subscriber}{INSTANCE_SEPARATOR}{instance}" for instance in range(1, args.subscribers + 1)]
+
+
+def publisher_name(args: argparse.Namespace) -> str:
+    # Instance 0 keeps the publisher apart from subscribers of the same SDK
+    return f"{args.publisher}{INSTANCE_SEPARATOR}0"
+
+
+def setup_publish(bench: Bench, args: argparse.Namespace):
+    bench.spawn_test_agents([publisher_name(args)] + subscriber_names(args))
+
+
+def run_publish(bench: Bench, args: argparse.Namespace) -> Dict[str, float]:
+    """Publishes count messages to every subscriber, "publish_throughput" with one and "fanout" with several"""
+    subscribers: List[str] = subscriber_names(args)
+    for subscriber in subscribers:
+        # Resets the counters of the subscriber
+        expect_ok(bench.tm.request(subscriber, "bench_subscribe", BENCH_TOPIC), "bench_subscribe")
+
+    cpu_start_s: float = bench.cpu_seconds()
+    loadgen: Dict[str, Any] = bench.tm.request(
+        publisher_name(args),
+        "loadgen",
+        {
+            "topic": BENCH_TOPIC,
+            "payload_size": str(args.payload_size),
+            "count": str(args.count),
+            "batch_bytes": str(args.batch_bytes),
+            "batch_delay_ms": str(args.batch_delay_ms),
+        },
+        timeout=args.timeout,
+    )["data"]
+
+    deadline: float = time.time() + args.timeout
+    received: Dict[str, Dict[str, Any]] = {}
+    for subscriber in subscribers:
+        while True:
+            received[subscriber] = bench.tm.request(subscriber, "bench_results", {})["data"]
+            if received[subscriber]["count"] >= loadgen["count"] or time.time() > deadline:
+                break
+            time.sleep(0.05)
+    cpu_s: float = bench.cpu_seconds() - cpu_start_s
+
+    messages: int = sum(results["count"] for results in received.values())
+    last_receive_ns: int = max(results["last_receive_ns"] for results in received.values())
+    duration_s: float = max((last_receive_ns - loadgen["start_ns"]) / 1e9, 1e-9)
+    return {
+        "messages_per_s": messages / duration_s,
+        "throughput_mb_s": sum(results["bytes"] for results in received.values()) / 1e6 / duration_s,
+        "latency_mean_ms": sum(results["latency_sum_ns"] for results in received.values()) / 1e6 / max(messages, 1),
+        "latency_max_ms": max(results["latency_max_ns"] for results in received.values()) / 1e6,
+        "lost": loadgen["count"] * len(subscribers) - messages,
+        "cpu_s": cpu_s,
+    }
+
+
+def setup_rpc(bench: Bench, args: argparse.Namespace):
+    bench.spawn_test_agents([publisher_name(args)] + subscriber_names(args)[:1])
+    expect_ok(bench.tm.request(subscriber_names(args)[0], "registerlistener", RPC_METHOD), "registerlistener")
+
+
+def run_rpc(bench: Bench, args: argparse.Namespace) -> Dict[str, float]:
+    """Invokes the method of the server count times, one after another, and times each round trip through the
+    Test Manager, so the latencies include the hops between the Test Manager and the client
+    """
+    request: Dict[str, Any] = dict(RPC_METHOD, payload=RPC_PAYLOAD)
+    latencies_s: List[float] = []
+    cpu_start_s: float = bench.cpu_seconds()
+    start_s: float = time.perf_counter()
+    for _ in range(args.count):
+        call_start_s: float = time.perf_counter()
+        response: Dict[str, Any] = bench.tm.request(publisher_name(args), "invokemethod", request)
+        latencies_s.append(time.perf_counter() - call_start_s)
+        if "payload" not in response["data"]:
+            raise RuntimeError(f'"invokemethod" failed: {response["data"]}')
+    duration_s: float = time.perf_counter() - start_s
+
+    latencies_s.sort()
+    return {
+        "calls_per_s": args.count / duration_s,
+        "latency_mean_ms": statistics.fmean(latencies_s) * 1e3,
+        "latency_p50_ms": latencies_s[len(latencies_s) // 2] * 1e3,
+        "latency_p99_ms": latencies_s[min(int(len(latencies_s) * 0.99), len(latencies_s) - 1)] * 1e3,
+        "latency_max_ms": latencies_s[-1] * 1e3,
+        "cpu_s": bench.cpu_seconds() - cpu_start_s,
+    }
+
+
+def setup_serializer(bench: Bench, args: argparse.Namespace):
+    bench.spawn_test_agents(subscriber_names(args)[:1])
+
+
+def run_serializer(bench: Bench, args: argparse.Namespace) -> Dict[str, float]:
+    """Sends count serializer requests, up to pipeline of them outstanding at once, so the Test Agent rather than
+    the round trips bounds the rate
+    """
+    test_agent_name: str = subscriber_names(args)[0]
+    data: Any = SERIALIZER_DATA[args.serializer]
+    cpu_start_s: float = bench.cpu_seconds()
+    start_s: float = time.perf_counter()
+    remaining: int = args.count
+    while remaining > 0:
+        test_ids: List[str] = []
+        for _ in range(min(args.pipeline, remaining)):
+            test_ids.extend(bench.tm.request_nowait(test_agent_name, args.serializer, data))
+        bench.tm.wait_for_responses(test_agent_name, args.serializer, test_ids, args.timeout)
+        remaining -= len(test_ids)
+    duration_s: float = time.perf_counter() - start_s
+    return {
+        "ops_per_s": args.count / duration_s,
+        "cpu_s": bench.cpu_seconds() - cpu_start_s,
+    }
+
+
+def long_uri_data(vector: Tuple[str, ...]) -> Dict[str, Any]:
+    """The UUri of a vector as the serializer features send it, without the fields they leave blank"""
+    authority, entity, version_major, resource, instance, message, _ = vector
+    uri: Dict[str, Any] = {"entity": {"name": entity, "version_major": version_major}}
+    if authority:
+        uri["authority"] = {"name": authority}
+    resource_fields = {"name": resource, "instance": instance, "message": message}
+    if any(resource_fields.values()):
+        uri["resource"] = {field: value for field, value in resource_fields.items() if value}
+    return uri
+
+
+def micro_uri_data(vector: Tuple[str, ...]) -> Dict[str, Any]:
+    """The UUri of a micro vector as micro_uri_serializer.feature sends it"""
+    authority_id, entity_id, version_major, resource_id, _ = vector
+    uri: Dict[str, Any] = {"entity": {"id": entity_id, "version_major": version_major}, "resource": {"id": resource_id}}
+    if authority_id:
+        uri["authority"] = {"id": "BYTES:" + authority_id}
+    return uri
+
+
+def micro_uri_of(vector: Tuple[str, ...]) -> str:
+    """The micro form of a micro vector as the micro features send it, one "iso-8859-1" character per byte"""
+    return base64.b64decode(vector[4]).decode("iso-8859-1")
+
+
+def vector_inputs(serializer: str) -> Tuple[List[Tuple[str, ...]], List[Any]]:
+    """The vectors a serializer runs and its inputs, as "run_vectors" takes them"""
+    if serializer == "uri_serialize":
+        return LONG_URI_VECTORS, [long_uri_data(vector) for vector in LONG_URI_VECTORS]
+    if serializer == "uri_deserialize":
+        return LONG_URI_VECTORS, [vector[6] for vector in LONG_URI_VECTORS]
+    if serializer == "micro_serialize_uri":
+        return MICRO_URI_VECTORS, [micro_uri_data(vector) for vector in MICRO_URI_VECTORS]
+    return MICRO_URI_VECTORS, [micro_uri_of(vector) for vector in MICRO_URI_VECTORS]
+
+
+def check_vector_results(serializer: str, vectors: List[Tuple[str, ...]], results: List[Any]):
+    """Fails the run if a result of the Test Agent differs from the vector, so the rates of conforming serializers
+    are compared only"""
+    if len(results) != len(vectors):
+        raise RuntimeError(f"{serializer} returned {len(results)} results for {len(vectors)} vectors")
+    for vector, result in zip(vectors, results):
+        if serializer == "uri_serialize":
+            expected: Any = vector[6]
+            actual: Any = result
+        elif serializer == "uri_deserialize":
+            expected = vector[:6]
+            actual = (
+                result["authority"]["name"],
+                result["entity"]["name"],
+                str(result["entity"]["version_major"]),
+                result["resource"]["name"],
+                result["resource"]["instance"],
+                result["resource"]["message"],
+            )
+        elif serializer == "micro_serialize_uri":
+            expected = micro_uri_of(vector)
+            actual = result
+        else:
+            expected = vector[:4]
+            actual = (
+                result["authority"]["id"],
+                str(result["entity"]["id"]),
+                str(result["entity"]["version_major"]),
+                str(result["resource"]["id"]),
+            )
+        if actual != expected:
+            raise RuntimeError(f'{serializer} of "{vector[-1]}" returned {actual}, expected {expected}')
+
+
+def run_serializer_bulk(bench: Bench, args: argparse.Namespace) -> Dict[str, float]:
+    """Has the Test Agent run the serializer over the URI vectors of the TCK with "run_vectors" until about count
+    operations are done, timed by the Test Agent itself, so the rate is the serializer's alone
+    """
+    vectors, inputs = vector_inputs(args.serializer)
+    cpu_start_s: float = bench.cpu_seconds()
+    response: Dict[str, Any] = bench.tm.request(
+        subscriber_names(args)[0],
+        "run_vectors",
+        {"action": args.serializer, "inputs": inputs, "repeat": str(max(args.count // len(inputs), 1))},
+        timeout=args.timeout,
+    )["data"]
+    if "results" not in response:
+        raise RuntimeError(f'"run_vectors" failed: {response}')
+    check_vector_results(args.serializer, vectors, response["results"])
+    return {
+        "ops_per_s": response["ops_per_s"],
+        "ns_per_op": response["elapsed_ns"] / response["ops"],
+        "cpu_s": bench.cpu_seconds() - cpu_start_s,
+    }
+
+
+# Workload -> setup once, run once per warmup round and repetition, throughput metric that has to be steady
+WORKLOADS: Dict[str, Tuple[Callable[[Bench, argparse.Namespace], None], Callable[..., Dict[str, float]], str]] = {
+    "publish_throughput": (setup_publish, run_publish, "messages_per_s"),
+    "fanout": (setup_publish, run_publish, "messages_per_s"),
+    "rpc_latency": (setup_rpc, run_rpc, "calls_per_s"),
+    "serializer": (setup_serializer, run_serializer, "ops_per_s"),
+    "serializer_bulk": (setup_serializer, run_serializer_bulk, "ops_per_s"),
+}
+
+
+def write_reports(name: str, report: Dict[str, Any]):
+    """Writes <name>.json with the configuration, runs and summary and <name>.csv with one row per run"""
+    os.makedirs(BENCH_REPORT_DIR, exist_ok=True)
+    with open(os.path.join(BENCH_REPORT_DIR, name + ".json"), "w") as json_report:
+        json.dump(report, json_report, indent=2)
+
+    metrics: List[str] = list(report["summary"])
+    with open(os.path.join(BENCH_REPORT_DIR, name + ".csv"), "w", newline="") as csv_report:
+        writer = csv.writer(csv_report)
+        writer.writerow(["run"] + metrics)
+        for index, run in enumerate(report["runs"], start=1):
+            writer.writerow([index] + [run[metric] for metric in metrics])
+        for statistic in ("mean", "ci95_low", "ci95_high"):
+            writer.writerow([statistic] + [report["summary"][metric][statistic] for metric in metrics])
+
+
+def parse_args(argv: Optional[List[str]] = None) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(
+        prog="tck-bench", description="Runs a benchmark workload on the Test Agents without behave"
+    )
+    parser.add_argument("workload", choices=sorted(WORKLOADS))
+    parser.add_argument("--name", help="Names the reports in reports/bench, the workload by default")
+    parser.add_argument("--transport", default="socket")
+    parser.add_argument("--publisher", default="python", help="SDK of the publishing or invoking Test Agent")
+    parser.add_argument("--subscriber", default="python", help="SDK of the receiving or serving Test Agents")
+    parser.add_argument("--subscribers", type=int, help="Receiving Test Agents, 1 by default and 4 for fanout")
+    parser.add_argument("--count", type=int, default=10000, help="Messages, calls or operations per run")
+    parser.add_argument("--payload-size", type=int, default=64)
+    parser.add_argument("--batch-bytes", type=int, default=0)
+    parser.add_argument("--batch-delay-ms", type=int, default=0)
+    parser.add_argument("--serializer", choices=sorted(SERIALIZER_DATA), default="uri_serialize")
+    parser.add_argument("--pipeline", type=int, default=100, help="Outstanding serializer requests")
+    parser.add_argument("--warmup", type=int, default=1, help="Unmeasured runs before the measured ones, at least")
+    parser.add_argument(
+        "--steady",
+        action="store_true",
+        help="Warms up until the throughput of the last --steady-window runs varies by at most --steady-cv",
+    )
+    parser.add_argument("--steady-window", type=int, default=benchutils.STEADY_WINDOW)
+    parser.add_argument("--steady-cv", type=float, default=benchutils.STEADY_MAX_CV)
+    parser.add_argument("--max-warmup", type=int, default=benchutils.MAX_WARMUP_ROUNDS, help="Warmup runs at most")
+    parser.add_argument("--repeat", type=int, default=5, help="Measured runs")
+    parser.add_argument(
+        "--timeout", type=float, default=120, help="Seconds to wait for the messages and responses of a run"
+    )
+    parser.add_argument(
+        "--cpus",
+        action="append",
+        default=[],
+        metavar="PROCESS=CPUS",
+        help="Pins a process like --define cpus_<process> of behave, e.g. tm=0, dispatcher=1 or agents=2-5",
+    )
+    parser.add_argument("--verbose", action="store_true", help="Logs every Test Manager request")
+    args = parser.parse_args(argv)
+    if args.subscribers is None:
+        args.subscribers = 4 if args.workload == "fanout" else 1
+    if args.repeat < 1:
+        parser.error("--repeat must be at least 1")
+    if args.workload == "serializer_bulk" and args.serializer not in RUN_VECTORS_SERIALIZERS:
+        parser.error(f"serializer_bulk runs {' or '.join(RUN_VECTORS_SERIALIZERS)}")
+    if args.workload.startswith("serializer") and args.subscriber == "rust":
+        # The Rust Test Agent answers the serializer actions with UNIMPLEMENTED
+        parser.error(f"the rust Test Agent does not implement the serializer actions {args.workload} needs")
+    return args
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    args = parse_args(argv)
+    logging.basicConfig(format="%(levelname)s| %(filename)s:%(lineno)s %(message)s")
+    logger.setLevel(logging.INFO)
+    if not args.verbose:
+        # The Test Manager and the Dispatcher log every message on this logger
+        logging.getLogger("File:Line# Debugger").setLevel(logging.WARNING)
+
+    userdata: Dict[str, str] = {}
+    for assignment in args.cpus:
+        process_name, cpu_list = assignment.split("=", 1)
+        userdata[affinityutils.CPUS_PREFIX + process_name] = cpu_list
+    bench = Bench(args.transport, affinityutils.CpuPlan(userdata))
+    setup, run, throughput_metric = WORKLOADS[args.workload]
+    # Without --steady the warmup ends after --warmup runs
+    detector = benchutils.SteadyStateDetector(
+        args.steady_window, args.steady_cv, args.warmup, args.max_warmup if args.steady else args.warmup
+    )
+
+    warmup_runs: List[Dict[str, float]] = []
+    runs: List[Dict[str, float]] = []
+    try:
+        bench.start()
+        setup(bench, args)
+        while not detector.is_done():
+            result: Dict[str, float] = run(bench, args)
+            logger.info(f"warmup {len(warmup_runs) + 1}: {result}")
+            warmup_runs.append(result)
+            detector.add(result[throughput_metric])
+        if args.steady and not detector.is_steady():
+            logger.warning(f"No steady state after {len(warmup_runs)} warmup runs, measuring anyway")
+        for index in range(args.repeat):
+            result = run(bench, args)
+            logger.info(f"run {index + 1}: {result}")
+            runs.append(result)
+    finally:
+        bench.close()
+
+    name: str = args.name or args.workload
+    summary: Dict[str, Dict[str, float]] = {metric: summarize([run[metric] for run in runs]) for metric in runs[0]}
+    write_reports(
+        name,
+        {
+            "workload": args.workload,
+            "config": {key: value for key, value in vars(args).items() if key not in ("cpus", "verbose")},
+            "topology": affinityutils.topology(bench.plan, "process" if args.transport == "socket" else None),
+            "warmup": {"runs": warmup_runs, "steady_state": detector.report()},
+            "runs": runs,
+            "summary": summary,
+        },
+    )
+    for metric, stats in summary.items():
+        print(f"{metric:>16} {stats['mean']:14.3f}  95% CI [{stats['ci95_low']:.3f}, {stats['ci95_high']:.3f}]")
+    print(f"Reports written to {os.path.join(BENCH_REPORT_DIR, name)}.json and .csv")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
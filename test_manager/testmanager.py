@@ -15,15 +15,17 @@ SPDX-FileType: SOURCE
 SPDX-License-Identifier: Apache-2.0
 """
 
+import codecs
 import json
 import logging
 import selectors
 import socket
 import sys
+import time
 import uuid
 from collections import defaultdict, deque
-from threading import Lock
-from typing import Any, Deque, Dict, Tuple
+from threading import Condition, Lock
+from typing import Any, Deque, Dict, List, Mapping, Set, Tuple, Union
 from typing import Any as AnyType
 
 from multimethod import multimethod
@@ -32,6 +34,12 @@ logging.basicConfig(format="%(levelname)s| %(filename)s:%(lineno)s %(message)s")
 logger = logging.getLogger("File:Line# Debugger")
 logger.setLevel(logging.DEBUG)
 BYTES_MSG_LENGTH: int = 32767
+INSTANCE_SEPARATOR: str = "#"
+GROUP_PREFIX: str = "all "
+# Seconds to wait for the response of a Test Agent, so a step fails instead of hanging when the agent died
+REQUEST_TIMEOUT_S: float = 60.0
+# Step arguments standing for the Test Agents a feature is run with
+TEST_AGENT_ALIASES = ("uE1", "uE2")
 
 
 def convert_json_to_jsonstring(j: Dict[str, AnyType]) -> str:
@@ -50,18 +58,45 @@ def is_close_socket_signal(received_data: bytes) -> bool:
     return received_data == b""
 
 
+def split_test_agent_name(test_agent_name: str) -> Tuple[str, str]:
+    """Splits a Test Agent name such as "python#7" into its SDK name and instance id"""
+    sdk_name, _, instance_id = test_agent_name.partition(INSTANCE_SEPARATOR)
+    return sdk_name, instance_id
+
+
+def is_test_agent_group(test_agent_name: str) -> bool:
+    return test_agent_name.startswith(GROUP_PREFIX)
+
+
+def resolve_test_agent_alias(test_agent_name: str, userdata: Mapping[str, str]) -> str:
+    """Returns the Test Agent a "uE1" or "uE2" step argument stands for, given with --define, other names as they are"""
+    if test_agent_name in TEST_AGENT_ALIASES:
+        return userdata[test_agent_name]
+    return test_agent_name
+
+
 class TestAgentConnectionDatabase:
     def __init__(self) -> None:
         self.test_agent_address_to_name: Dict[tuple[str, int], str] = defaultdict(str)
         self.test_agent_name_to_address: Dict[str, socket.socket] = {}
+        self.sdk_to_test_agent_names: Dict[str, Set[str]] = defaultdict(set)
+        self.test_agent_name_to_info: Dict[str, Dict[str, Any]] = {}
+        # time.perf_counter() when the initialize message of a Test Agent arrived
+        self.test_agent_name_to_initialized_at: Dict[str, float] = {}
         self.lock = Lock()
 
-    def add(self, test_agent_socket: socket.socket, test_agent_name: str):
+    def add(self, test_agent_socket: socket.socket, test_agent_name: str, info: Dict[str, Any]):
         test_agent_address: tuple[str, int] = test_agent_socket.getpeername()
+        sdk_name, instance_id = split_test_agent_name(test_agent_name)
 
+        initialized_at: float = time.perf_counter()
         with self.lock:
+            self.test_agent_name_to_initialized_at[test_agent_name] = initialized_at
             self.test_agent_address_to_name[test_agent_address] = test_agent_name
             self.test_agent_name_to_address[test_agent_name] = test_agent_socket
+            self.test_agent_name_to_info[test_agent_name] = info
+            if instance_id != "":
+                self.sdk_to_test_agent_names[sdk_name].add(test_agent_name)
 
     @multimethod
     def get(self, address: Tuple[str, int]) -> socket.socket:
@@ -72,6 +107,27 @@ class TestAgentConnectionDatabase:
     def get(self, name: str) -> socket.socket:
         return self.test_agent_name_to_address[name]
 
+    def get_group(self, sdk_name: str) -> List[str]:
+        """Returns the names of all connected Test Agent instances of one SDK (ex: python#1, python#2).
+        The default Test Agent without instance id (ex: python) is not part of the group.
+        """
+        with self.lock:
+            return sorted(self.sdk_to_test_agent_names.get(sdk_name, set()))
+
+    def get_names(self) -> List[str]:
+        with self.lock:
+            return list(self.test_agent_name_to_address.keys())
+
+    def get_info(self, test_agent_name: str) -> Dict[str, Any]:
+        """Returns the data a Test Agent sent in its initialize message, e.g. its runtime configuration"""
+        with self.lock:
+            return self.test_agent_name_to_info.get(test_agent_name, {})
+
+    def get_initialized_at(self, test_agent_name: str) -> float:
+        """Returns the time.perf_counter() value when the Test Agent sent its initialize message"""
+        with self.lock:
+            return self.test_agent_name_to_initialized_at[test_agent_name]
+
     def contains(self, test_agent_name: str):
         return test_agent_name in self.test_agent_name_to_address
 
@@ -90,9 +146,13 @@ class TestAgentConnectionDatabase:
         if test_agent_name is None:
             return
 
+        sdk_name, _ = split_test_agent_name(test_agent_name)
         with self.lock:
             del self.test_agent_address_to_name[test_agent_address]
             del self.test_agent_name_to_address[test_agent_name]
+            self.test_agent_name_to_info.pop(test_agent_name, None)
+            self.test_agent_name_to_initialized_at.pop(test_agent_name, None)
+            self.sdk_to_test_agent_names[sdk_name].discard(test_agent_name)
 
         test_agent_socket.close()
 
@@ -101,27 +161,104 @@ class DictWithQueue:
     def __init__(self) -> None:
         self.key_to_queue: Dict[str, Deque[Dict[str, Any]]] = defaultdict(deque)
         self.lock = Lock()
+        self.new_item = Condition(self.lock)
 
     def append(self, key: str, msg: Dict[str, Any]) -> None:
         with self.lock:
             self.key_to_queue[key].append(msg)
             logger.info(f"self.key_to_queue append {self.key_to_queue}")
+            self.new_item.notify_all()
+
+    def pop_matching(self, key: str, inner_key: str, inner_expected_value: str, deadline: float) -> Dict[str, Any]:
+        """Blocks until a message whose inner_key equals inner_expected_value is queued under key, then removes it.
+        The whole queue is searched, so responses of concurrent requests may arrive in any order.
+        Raises TimeoutError if no such message is queued by deadline, a time.monotonic() value.
+        """
+        with self.lock:
+            while True:
+                queue: Deque[Dict[str, Any]] = self.key_to_queue[key]
+                for response_json in queue:
+                    if response_json.get(inner_key) == inner_expected_value:
+                        queue.remove(response_json)
+                        logger.info(f'self.key_to_queue pop {response_json["action"]} {self.key_to_queue}')
+                        return response_json
+                remaining_s: float = deadline - time.monotonic()
+                if remaining_s <= 0:
+                    raise TimeoutError(f'No "{key}" message with {inner_key} {inner_expected_value} arrived in time')
+                self.new_item.wait(remaining_s)
+
+
+class JsonStreamDecoder:
+    """
+    Splits the byte stream of a Test Agent into JSON messages.
+    Test Agents write messages back to back without delimiters, so one recv may return several of them
+    or only part of one.
+    """
+
+    def __init__(self) -> None:
+        self.utf8_decoder = codecs.getincrementaldecoder("utf-8")()
+        self.json_decoder = json.JSONDecoder()
+        self.buffer: str = ""
+
+    def feed(self, data: bytes) -> List[Dict[str, Any]]:
+        self.buffer += self.utf8_decoder.decode(data)
+        messages: List[Dict[str, Any]] = []
+        pos: int = 0
+        while True:
+            while pos < len(self.buffer) and self.buffer[pos].isspace():
+                pos += 1
+            if pos == len(self.buffer):
+                break
+            try:
+                message, pos = self.json_decoder.raw_decode(self.buffer, pos)
+            except json.JSONDecodeError:
+                # The rest of the message has not been received yet
+                break
+            messages.append(message)
+        self.buffer = self.buffer[pos:]
+        return messages
+
+
+class RequestTimings:
+    def __init__(self) -> None:
+        """Round trip times of the requests to each Test Agent, so a slow step can be attributed to the agent"""
+        self.lock = Lock()
+        # test_id -> Test Agent name and time.perf_counter() of sending the request
+        self.pending: Dict[str, Tuple[str, float]] = {}
+        # Test Agent name -> number, total and maximum of the round trip times, and number of requests timed out
+        self.test_agent_name_to_stats: Dict[str, Dict[str, float]] = {}
 
-    def contains(self, key: str, inner_key: str, inner_expected_value: str) -> bool:
-        queue: Deque[Dict[str, Any]] = self.key_to_queue[key]
-        if len(queue) == 0:
-            return False
+    def sent(self, test_agent_name: str, test_id: str) -> None:
+        with self.lock:
+            self.pending[test_id] = (test_agent_name, time.perf_counter())
 
-        response_json: Dict[str, Any] = queue[0]
-        incoming_req_id: str = response_json[inner_key]
+    def received(self, test_id: str) -> None:
+        received_at: float = time.perf_counter()
+        with self.lock:
+            test_agent_name, sent_at = self.pending.pop(test_id, (None, received_at))
+            if test_agent_name is None:
+                return
+            stats = self._stats_of(test_agent_name)
+            stats["requests"] += 1
+            stats["round_trip_total_s"] += received_at - sent_at
+            stats["round_trip_max_s"] = max(stats["round_trip_max_s"], received_at - sent_at)
+
+    def expired(self, test_id: str) -> None:
+        """Forgets a request whose response did not arrive in time, a late response is not counted"""
+        with self.lock:
+            test_agent_name, _ = self.pending.pop(test_id, (None, 0.0))
+            if test_agent_name is not None:
+                self._stats_of(test_agent_name)["timeouts"] += 1
 
-        return incoming_req_id == inner_expected_value
+    def _stats_of(self, test_agent_name: str) -> Dict[str, float]:
+        # Called with lock held
+        return self.test_agent_name_to_stats.setdefault(
+            test_agent_name, {"requests": 0, "round_trip_total_s": 0.0, "round_trip_max_s": 0.0, "timeouts": 0}
+        )
 
-    def popleft(self, key: str) -> Any:
+    def get_stats(self) -> Dict[str, Dict[str, float]]:
         with self.lock:
-            onreceive: Any = self.key_to_queue[key].popleft()
-            logger.info(f'self.key_to_queue popleft {onreceive["action"]} {self.key_to_queue}')
-        return onreceive
+            return {name: dict(stats) for name, stats in self.test_agent_name_to_stats.items()}
 
 
 class TestManager:
@@ -129,8 +266,10 @@ class TestManager:
         self.exit_manager = False
         self.socket_event_receiver = selectors.DefaultSelector()
         self.connected_test_agent_sockets: Dict[str, socket.socket] = {}
+        self.test_agent_streams: Dict[socket.socket, JsonStreamDecoder] = {}
         self.test_agent_database = TestAgentConnectionDatabase()
         self.action_type_to_response_queue = DictWithQueue()
+        self.request_timings = RequestTimings()
         self.lock = Lock()
         self.bdd_context = bdd_context
 
@@ -170,16 +309,20 @@ class TestManager:
         if is_close_socket_signal(recv_data):
             self.close_test_agent(test_agent)
             return
-        json_data = json.loads(recv_data.decode("utf-8"))
-        logger.info("Received from test agent: %s", json_data)
-        if json_data.get("test_id") is not None:
-            json_data["test_id"] = json_data["test_id"].strip('"')
-        self._process_receive_message(json_data, test_agent)
+        stream: JsonStreamDecoder = self.test_agent_streams.setdefault(test_agent, JsonStreamDecoder())
+        for json_data in stream.feed(recv_data):
+            logger.info("Received from test agent: %s", json_data)
+            if json_data.get("test_id") is not None:
+                json_data["test_id"] = json_data["test_id"].strip('"')
+            self._process_receive_message(json_data, test_agent)
 
     def _process_receive_message(self, response_json: Dict[str, Any], ta_socket: socket.socket):
         if response_json["action"] == "initialize":
-            test_agent_sdk: str = response_json["data"]["SDK_name"].lower().strip()
-            self.test_agent_database.add(ta_socket, test_agent_sdk)
+            test_agent_name: str = response_json["data"]["SDK_name"].lower().strip()
+            instance_id = response_json["data"].get("instance_id")
+            if instance_id is not None and str(instance_id).strip() != "":
+                test_agent_name += INSTANCE_SEPARATOR + str(instance_id).strip()
+            self.test_agent_database.add(ta_socket, test_agent_name, response_json["data"])
             return
 
         action_type: str = response_json["action"]
@@ -188,6 +331,34 @@ class TestManager:
     def has_sdk_connection(self, test_agent_name: str) -> bool:
         return self.test_agent_database.contains(test_agent_name)
 
+    def resolve_test_agents(self, test_agent_name: str) -> List[str]:
+        """Resolves a Test Agent address to connected Test Agent names.
+        "python#7" addresses a single instance, "all python" every connected python#<instance_id>.
+        Raises LookupError if a group addresses no connected Test Agent, e.g. a misspelled one, so that steps addressing
+        it cannot pass without checking anything.
+        """
+        test_agent_name = test_agent_name.lower().strip()
+        if is_test_agent_group(test_agent_name):
+            test_agent_names: List[str] = self.test_agent_database.get_group(
+                test_agent_name[len(GROUP_PREFIX) :].strip()
+            )
+            if not test_agent_names:
+                raise LookupError(f'No connected Test Agent belongs to "{test_agent_name}"')
+            return test_agent_names
+        return [test_agent_name]
+
+    def get_test_agent_names(self) -> List[str]:
+        return self.test_agent_database.get_names()
+
+    def get_test_agent_info(self, test_agent_name: str) -> Dict[str, Any]:
+        return self.test_agent_database.get_info(test_agent_name)
+
+    def get_test_agent_initialized_at(self, test_agent_name: str) -> float:
+        return self.test_agent_database.get_initialized_at(test_agent_name)
+
+    def get_request_timings(self) -> Dict[str, Dict[str, float]]:
+        return self.request_timings.get_stats()
+
     def listen_for_incoming_events(self):
         """
         Listens for Test Agent connections and messages, then creates a thread to start the init process
@@ -206,10 +377,61 @@ class TestManager:
         action: str,
         data: Dict[str, AnyType],
         payload: Dict[str, AnyType] = None,
-    ):
-        """Sends a blocking request message to sdk Test Agent (ex: Java, Rust, C++ Test Agent)"""
+        entity: str = None,
+        timeout: float = REQUEST_TIMEOUT_S,
+    ) -> Union[Dict[str, Any], List[Dict[str, Any]]]:
+        """Sends a blocking request message to sdk Test Agent (ex: Java, Rust, C++ Test Agent)
+        If test_agent_name addresses a group (ex: "all python"), the request is broadcast to every member first and
+        the responses are gathered afterwards, so the Test Agents process it concurrently. A list is returned then.
+        entity selects the virtual uEntities of a multi-entity Test Agent, either an index or "all".
+        Raises TimeoutError if the responses have not arrived within timeout seconds.
+        """
+        test_ids: List[str] = self.request_nowait(test_agent_name, action, data, payload, entity)
+        return self.wait_for_responses(test_agent_name, action, test_ids, timeout)
+
+    def request_nowait(
+        self,
+        test_agent_name: str,
+        action: str,
+        data: Dict[str, AnyType],
+        payload: Dict[str, AnyType] = None,
+        entity: str = None,
+    ) -> List[str]:
+        """Sends a request message like request() without waiting for the responses, e.g. to advance the clock of a
+        Test Agent before its response is due. Returns the test ids to pass to wait_for_responses().
+        """
+        test_agent_names: List[str] = self.resolve_test_agents(test_agent_name)
+        return [self._send_request(name, action, data, payload, entity) for name in test_agent_names]
+
+    def wait_for_responses(
+        self, test_agent_name: str, action: str, test_ids: List[str], timeout: float = REQUEST_TIMEOUT_S
+    ) -> Union[Dict[str, Any], List[Dict[str, Any]]]:
+        """Waits for the responses to a request sent with request_nowait(), returned like by request().
+        Raises TimeoutError if they have not all arrived within timeout seconds.
+        """
+        deadline: float = time.monotonic() + timeout
+        responses: List[Dict[str, Any]] = []
+        try:
+            for test_id in test_ids:
+                responses.append(self._wait_for_response(action, test_id, deadline))
+        except TimeoutError:
+            for test_id in test_ids[len(responses) :]:
+                self.request_timings.expired(test_id)
+            raise
+
+        if is_test_agent_group(test_agent_name.lower().strip()):
+            return responses
+        return responses[0]
+
+    def _send_request(
+        self,
+        test_agent_name: str,
+        action: str,
+        data: Dict[str, AnyType],
+        payload: Dict[str, AnyType] = None,
+        entity: str = None,
+    ) -> str:
         # Get Test Agent's socket
-        test_agent_name = test_agent_name.lower().strip()
         test_agent_socket: socket.socket = self.test_agent_database.get(test_agent_name)
 
         # Create a request json to send to specific Test Agent
@@ -217,37 +439,37 @@ class TestManager:
         request_json = {"data": data, "action": action, "test_id": test_id}
         if payload is not None:
             request_json["payload"] = payload
+        if entity is not None:
+            request_json["entity"] = entity
 
         # Pack json as binary
         request_str: str = convert_json_to_jsonstring(request_json)
         request_bytes: bytes = convert_str_to_bytes(request_str)
 
+        self.request_timings.sent(test_agent_name, test_id)
         send_socket_data(test_agent_socket, request_bytes)
-        logger.info(f"Sent to TestAgent{request_json}")
+        logger.info(f"Sent to TestAgent {test_agent_name} {request_json}")
+        return test_id
 
-        # Wait until get response
+    def _wait_for_response(self, action: str, test_id: str, deadline: float) -> Dict[str, Any]:
         logger.info(f"Waiting test_id {test_id}")
-        while not self.action_type_to_response_queue.contains(action, "test_id", test_id):
-            pass
+        response_json: Dict[str, Any] = self.action_type_to_response_queue.pop_matching(
+            action, "test_id", test_id, deadline
+        )
+        self.request_timings.received(test_id)
         logger.info(f"Received test_id {test_id}")
-
-        # Get response
-        response_json: Dict[str, Any] = self.action_type_to_response_queue.popleft(action)
         return response_json
 
-    def _wait_for_onreceive(self, test_agent_name: str):
-        while not self.action_type_to_response_queue.contains("onreceive", "ue", test_agent_name):
-            pass
-
-    def get_onreceive(self, test_agent_name: str) -> Dict[str, Any]:
-        self._wait_for_onreceive(test_agent_name)
-
-        return self.action_type_to_response_queue.popleft("onreceive")
+    def get_onreceive(self, test_agent_name: str, timeout: float = REQUEST_TIMEOUT_S) -> Dict[str, Any]:
+        return self.action_type_to_response_queue.pop_matching(
+            "onreceive", "ue", test_agent_name, time.monotonic() + timeout
+        )
 
     @multimethod
     def close_test_agent(self, test_agent_socket: socket.socket):
         # Stop monitoring socket/fileobj. A file object shall be unregistered prior to being closed.
         self.socket_event_receiver.unregister(test_agent_socket)
+        self.test_agent_streams.pop(test_agent_socket, None)
         self.test_agent_database.close(test_agent_socket)
 
     @multimethod
@@ -0,0 +1,40 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import java.util.concurrent.Future;
+
+/**
+ * Schedules the RPC timeouts of a transport. Transports run them in real time unless given a {@link VirtualClock},
+ * which only moves when it is advanced.
+ */
+@FunctionalInterface
+public interface Clock {
+    /**
+     * Runs a task once delayMs milliseconds of the clock have passed.
+     *
+     * @param task    The task to run.
+     * @param delayMs The delay in milliseconds.
+     * @return The scheduled task, cancelling it keeps it from running.
+     */
+    Future<?> schedule(Runnable task, long delayMs);
+}
@@ -0,0 +1,69 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import java.nio.ByteBuffer;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/**
+ * Recycles the direct buffers frames are serialized into, so that the channel writes them without copying and
+ * sending allocates no direct memory in the steady state.
+ * Frames larger than {@link #BUFFER_SIZE} get a heap buffer of their own, which is not pooled.
+ */
+final class DirectBufferPool {
+    static final int BUFFER_SIZE = 16 * 1024;
+    private static final int MAX_POOLED_BUFFERS = 256;
+
+    private final ConcurrentLinkedQueue<ByteBuffer> buffers = new ConcurrentLinkedQueue<>();
+    private final AtomicInteger pooled = new AtomicInteger();
+
+    /**
+     * Returns a cleared buffer of at least the given capacity.
+     */
+    ByteBuffer acquire(int capacity) {
+        if (capacity > BUFFER_SIZE) {
+            return ByteBuffer.allocate(capacity);
+        }
+        ByteBuffer buffer = buffers.poll();
+        if (buffer == null) {
+            return ByteBuffer.allocateDirect(BUFFER_SIZE);
+        }
+        pooled.decrementAndGet();
+        return buffer;
+    }
+
+    /**
+     * Returns a buffer to the pool once it has been written.
+     */
+    void release(ByteBuffer buffer) {
+        if (!buffer.isDirect() || buffer.capacity() != BUFFER_SIZE) {
+            return;
+        }
+        if (pooled.incrementAndGet() > MAX_POOLED_BUFFERS) {
+            pooled.decrementAndGet();
+            return;
+        }
+        buffer.clear();
+        buffers.offer(buffer);
+    }
+}
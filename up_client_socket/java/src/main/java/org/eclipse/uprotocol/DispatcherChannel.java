@@ -0,0 +1,332 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import java.io.IOException;
+import java.net.InetSocketAddress;
+import java.nio.ByteBuffer;
+import java.nio.channels.ClosedChannelException;
+import java.nio.channels.SelectionKey;
+import java.nio.channels.Selector;
+import java.nio.channels.SocketChannel;
+import java.util.ArrayDeque;
+import java.util.Arrays;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicBoolean;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.logging.Level;
+import java.util.logging.Logger;
+
+/**
+ * Non-blocking connection to the Dispatcher, served by a single I/O thread.
+ * Senders hand their frames to the I/O thread through a lock-free queue, so sending never blocks on the socket and
+ * frames of concurrent senders never interleave. The I/O thread writes all queued frames with one gathering write
+ * and passes every received UMessage to the frame handler.
+ * While batching, queued frames are written once batchBytes are pending, the oldest of them waited for
+ * batchDelayMs, an urgent frame is queued or the channel is flushed.
+ */
+final class DispatcherChannel {
+    private static final Logger logger = Logger.getLogger("JavaSocketUTransport");
+    private static final int READ_BUFFER_SIZE = 64 * 1024;
+    private static final int MAX_GATHERED_FRAMES = 64;
+    // Sending fails rather than queuing more than this while the Dispatcher does not keep up
+    private static final long MAX_QUEUED_BYTES = 64L * 1024 * 1024;
+
+    /**
+     * Consumes the serialized UMessages received from the Dispatcher, on the I/O thread.
+     */
+    interface FrameHandler {
+        void onFrame(byte[] umsg) throws IOException;
+    }
+
+    private final SocketChannel channel;
+    private final Selector selector;
+    private final SelectionKey key;
+    private final FrameHandler frameHandler;
+    private final DirectBufferPool bufferPool = new DirectBufferPool();
+    private final ConcurrentLinkedQueue<ByteBuffer> outbound = new ConcurrentLinkedQueue<>();
+    // Bytes of all frames queued and not yet accepted by the socket
+    private final AtomicLong queuedBytes = new AtomicLong();
+    private final AtomicBoolean wakeupPending = new AtomicBoolean();
+    private volatile boolean open = true;
+    private volatile boolean flushRequested;
+    private volatile boolean batchStarted;
+    private volatile int batchBytes;
+    private volatile long batchDelayNs;
+
+    // Only accessed by the I/O thread
+    private final ArrayDeque<ByteBuffer> inFlight = new ArrayDeque<>();
+    private final ByteBuffer[] gathered = new ByteBuffer[MAX_GATHERED_FRAMES];
+    private final ByteBuffer readBuffer = ByteBuffer.allocateDirect(READ_BUFFER_SIZE);
+    private ByteBuffer largeFrame;
+    private long batchDeadlineNs;
+    private boolean awaitingWritable;
+
+    private DispatcherChannel(SocketChannel channel, FrameHandler frameHandler) throws IOException {
+        this.channel = channel;
+        this.frameHandler = frameHandler;
+        selector = Selector.open();
+        channel.configureBlocking(false);
+        key = channel.register(selector, SelectionKey.OP_READ);
+    }
+
+    /**
+     * Connects to the Dispatcher and starts the I/O thread.
+     *
+     * @param address      The address of the Dispatcher.
+     * @param frameHandler Consumes the received UMessages.
+     * @return The connected channel.
+     * @throws IOException If the Dispatcher cannot be reached.
+     */
+    static DispatcherChannel open(InetSocketAddress address, FrameHandler frameHandler) throws IOException {
+        DispatcherChannel dispatcherChannel = new DispatcherChannel(SocketChannel.open(address), frameHandler);
+        new Thread(dispatcherChannel::run, "DispatcherChannel-io").start();
+        return dispatcherChannel;
+    }
+
+    /**
+     * Returns a buffer for a frame of the given length, to be passed to {@link #write} once filled.
+     */
+    ByteBuffer allocateFrame(int frameLength) {
+        return bufferPool.acquire(frameLength);
+    }
+
+    /**
+     * Returns the bytes of all frames queued and not yet accepted by the socket.
+     */
+    long queuedBytes() {
+        return queuedBytes.get();
+    }
+
+    /**
+     * Batches frames up to batchBytes, delaying none of them longer than batchDelayMs.
+     *
+     * @param batchBytes   Pending bytes that trigger writing the batch, 0 disables batching.
+     * @param batchDelayMs The longest a batched frame waits to be written.
+     * @throws ClosedChannelException If the connection to the Dispatcher is closed.
+     */
+    void setBatching(int batchBytes, long batchDelayMs) throws ClosedChannelException {
+        this.batchDelayNs = TimeUnit.MILLISECONDS.toNanos(batchDelayMs);
+        this.batchBytes = batchBytes;
+        flush();
+    }
+
+    /**
+     * Queues a frame, filled up to its position, for the I/O thread.
+     *
+     * @param frame  The frame, which is owned by the channel from now on.
+     * @param urgent Whether the frame must not be delayed by batching.
+     * @throws IOException If the channel is closed or the Dispatcher does not keep up.
+     */
+    void write(ByteBuffer frame, boolean urgent) throws IOException {
+        if (!open) {
+            throw new ClosedChannelException();
+        }
+        frame.flip();
+        int frameLength = frame.remaining();
+        long queued = queuedBytes.addAndGet(frameLength);
+        if (queued - frameLength > MAX_QUEUED_BYTES) {
+            queuedBytes.addAndGet(-frameLength);
+            bufferPool.release(frame);
+            throw new IOException("Dispatcher does not keep up, " + (queued - frameLength) + " bytes are queued");
+        }
+        outbound.offer(frame);
+
+        int batch = batchBytes;
+        if (batch == 0) {
+            wakeup();
+        } else if (urgent || frameLength >= batch || queued >= batch) {
+            flushRequested = true;
+            wakeup();
+        } else if (!batchStarted) {
+            // Lets the I/O thread start the delay of a new batch
+            wakeup();
+        }
+    }
+
+    /**
+     * Has the I/O thread write all queued frames now.
+     *
+     * @throws ClosedChannelException If the connection to the Dispatcher is closed.
+     */
+    void flush() throws ClosedChannelException {
+        if (!open) {
+            throw new ClosedChannelException();
+        }
+        flushRequested = true;
+        wakeup();
+    }
+
+    private void wakeup() {
+        if (wakeupPending.compareAndSet(false, true)) {
+            selector.wakeup();
+        }
+    }
+
+    private void run() {
+        try {
+            while (open) {
+                if (!batchStarted) {
+                    selector.select();
+                } else {
+                    long remainingNs = batchDeadlineNs - System.nanoTime();
+                    if (remainingNs > 0) {
+                        selector.select(Math.max(1, TimeUnit.NANOSECONDS.toMillis(remainingNs)));
+                    } else {
+                        selector.selectNow();
+                    }
+                }
+                wakeupPending.set(false);
+
+                if (selector.selectedKeys().remove(key)) {
+                    if (key.isReadable()) {
+                        readFrames();
+                    }
+                    if (key.isValid() && key.isWritable()) {
+                        writeInFlight();
+                    }
+                }
+                if (open) {
+                    writeQueued();
+                }
+            }
+        } catch (IOException e) {
+            logger.log(Level.SEVERE, "Error while communicating with the Dispatcher: " + e.getMessage(), e);
+        } finally {
+            close();
+        }
+    }
+
+    private void readFrames() throws IOException {
+        // A UMessage larger than the read buffer is read directly into a buffer of its own
+        ByteBuffer target = largeFrame != null ? largeFrame : readBuffer;
+        if (channel.read(target) < 0) {
+            open = false;
+            return;
+        }
+        if (largeFrame != null) {
+            if (!largeFrame.hasRemaining()) {
+                byte[] umsg = largeFrame.array();
+                largeFrame = null;
+                deliver(umsg);
+            }
+            return;
+        }
+
+        readBuffer.flip();
+        int headerLength = SocketUTransport.FRAME_HEADER_LENGTH;
+        while (readBuffer.remaining() >= headerLength) {
+            int umsgLength = readBuffer.getInt(readBuffer.position());
+            if (readBuffer.remaining() - headerLength >= umsgLength) {
+                readBuffer.position(readBuffer.position() + headerLength);
+                byte[] umsg = new byte[umsgLength];
+                readBuffer.get(umsg);
+                deliver(umsg);
+            } else if (headerLength + umsgLength > readBuffer.capacity()) {
+                readBuffer.position(readBuffer.position() + headerLength);
+                largeFrame = ByteBuffer.allocate(umsgLength);
+                largeFrame.put(readBuffer);
+            } else {
+                break;
+            }
+        }
+        readBuffer.compact();
+    }
+
+    private void deliver(byte[] umsg) throws IOException {
+        try {
+            frameHandler.onFrame(umsg);
+        } catch (RuntimeException e) {
+            // A failing listener must not take down the connection of every uEntity sharing it
+            logger.log(Level.SEVERE, "Error while handling a received message: " + e.getMessage(), e);
+        }
+    }
+
+    private void writeQueued() throws IOException {
+        if (outbound.isEmpty()) {
+            return;
+        }
+        int batch = batchBytes;
+        boolean due = batch == 0 || flushRequested || queuedBytes.get() >= batch
+                || (batchStarted && System.nanoTime() - batchDeadlineNs >= 0);
+        if (!due) {
+            if (!batchStarted) {
+                batchDeadlineNs = System.nanoTime() + batchDelayNs;
+                batchStarted = true;
+            }
+            return;
+        }
+
+        // Cleared before taking the frames, so a frame queued meanwhile either is taken or wakes the thread again
+        flushRequested = false;
+        batchStarted = false;
+        ByteBuffer frame;
+        while ((frame = outbound.poll()) != null) {
+            inFlight.add(frame);
+        }
+        if (!awaitingWritable) {
+            writeInFlight();
+        }
+    }
+
+    private void writeInFlight() throws IOException {
+        while (!inFlight.isEmpty()) {
+            int count = 0;
+            for (ByteBuffer frame : inFlight) {
+                gathered[count++] = frame;
+                if (count == gathered.length) {
+                    break;
+                }
+            }
+            long written = channel.write(gathered, 0, count);
+            queuedBytes.addAndGet(-written);
+            boolean socketFull = gathered[count - 1].hasRemaining();
+            Arrays.fill(gathered, 0, count, null);
+
+            while (!inFlight.isEmpty() && !inFlight.peekFirst().hasRemaining()) {
+                bufferPool.release(inFlight.pollFirst());
+            }
+            if (socketFull) {
+                awaitingWritable = true;
+                key.interestOps(SelectionKey.OP_READ | SelectionKey.OP_WRITE);
+                return;
+            }
+        }
+        if (awaitingWritable) {
+            awaitingWritable = false;
+            key.interestOps(SelectionKey.OP_READ);
+        }
+    }
+
+    private void close() {
+        open = false;
+        outbound.clear();
+        inFlight.clear();
+        try {
+            selector.close();
+            channel.close();
+        } catch (IOException e) {
+            logger.log(Level.SEVERE, "Error while closing the Dispatcher connection: " + e.getMessage(), e);
+        }
+    }
+}
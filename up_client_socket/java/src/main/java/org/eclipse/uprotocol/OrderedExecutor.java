@@ -0,0 +1,162 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import java.util.ArrayDeque;
+import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Semaphore;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.logging.Level;
+import java.util.logging.Logger;
+
+/**
+ * Runs tasks on a delegate executor, one at a time and in submission order per key, e.g. per topic.
+ * Tasks of different keys run in parallel. A key only holds a queue while it has pending tasks, so keys such as
+ * request ids can be used without the map growing.
+ * At most maxPending tasks wait or run, submitting blocks beyond that, so a slow consumer pushes back on its
+ * producer instead of growing memory.
+ */
+public final class OrderedExecutor implements Executor {
+    private static final Logger logger = Logger.getLogger("JavaSocketUTransport");
+
+    private final Executor delegate;
+    // The queue of a key exists exactly while one of its tasks is pending or running, it is only changed under
+    // compute() of that key
+    private final ConcurrentHashMap<Object, SerialQueue> queues = new ConcurrentHashMap<>();
+    private final Semaphore pendingPermits;
+    private final int maxPending;
+    private final AtomicLong submitted = new AtomicLong();
+    private final AtomicLong completed = new AtomicLong();
+    private final AtomicLong failed = new AtomicLong();
+    private final AtomicLong pendingHighWater = new AtomicLong();
+    private final AtomicLong blocked = new AtomicLong();
+    private final AtomicLong blockedNs = new AtomicLong();
+
+    public OrderedExecutor(Executor delegate) {
+        this(delegate, Integer.MAX_VALUE);
+    }
+
+    public OrderedExecutor(Executor delegate, int maxPending) {
+        this.delegate = delegate;
+        this.maxPending = maxPending;
+        pendingPermits = new Semaphore(maxPending);
+    }
+
+    /**
+     * Runs a task without ordering it after any other.
+     *
+     * @param task The task to run.
+     */
+    @Override
+    public void execute(Runnable task) {
+        execute(new Object(), task);
+    }
+
+    /**
+     * Runs a task after all tasks submitted before for the same key.
+     *
+     * @param key  Orders the tasks, compared with equals().
+     * @param task The task to run.
+     */
+    public void execute(Object key, Runnable task) {
+        if (!pendingPermits.tryAcquire()) {
+            blocked.incrementAndGet();
+            long blockedStart = System.nanoTime();
+            pendingPermits.acquireUninterruptibly();
+            blockedNs.addAndGet(System.nanoTime() - blockedStart);
+        }
+        submitted.incrementAndGet();
+        pendingHighWater.accumulateAndGet(maxPending - pendingPermits.availablePermits(), Math::max);
+
+        SerialQueue[] started = new SerialQueue[1];
+        queues.compute(key, (k, queue) -> {
+            if (queue == null) {
+                queue = new SerialQueue(k);
+                started[0] = queue;
+            }
+            queue.tasks.add(task);
+            return queue;
+        });
+        if (started[0] != null) {
+            delegate.execute(started[0]);
+        }
+    }
+
+    /**
+     * Returns the counters of the executor, e.g. how often and how long submitting blocked on a full queue.
+     */
+    public Map<String, Long> getMetrics() {
+        return Map.of("submitted", submitted.get(), "completed", completed.get(), "failed", failed.get(),
+                "pending", (long) (maxPending - pendingPermits.availablePermits()), "pending_high_water",
+                pendingHighWater.get(), "blocked", blocked.get(), "blocked_ns", blockedNs.get());
+    }
+
+    private final class SerialQueue implements Runnable {
+        private final Object key;
+        private final ArrayDeque<Runnable> tasks = new ArrayDeque<>();
+
+        private SerialQueue(Object key) {
+            this.key = key;
+        }
+
+        @Override
+        public void run() {
+            Runnable task = head();
+            while (task != null) {
+                try {
+                    task.run();
+                } catch (RuntimeException e) {
+                    failed.incrementAndGet();
+                    logger.log(Level.SEVERE, "Error in a task ordered by " + key + ": " + e.getMessage(), e);
+                }
+                completed.incrementAndGet();
+                pendingPermits.release();
+                task = next();
+            }
+        }
+
+        private Runnable head() {
+            Runnable[] head = new Runnable[1];
+            queues.computeIfPresent(key, (k, queue) -> {
+                head[0] = queue.tasks.peek();
+                return queue;
+            });
+            return head[0];
+        }
+
+        /**
+         * Removes the task that has run and returns the next one, or removes the queue once it is drained.
+         * The running task stays queued so that tasks submitted meanwhile are not started by another thread.
+         */
+        private Runnable next() {
+            Runnable[] next = new Runnable[1];
+            queues.computeIfPresent(key, (k, queue) -> {
+                queue.tasks.poll();
+                next[0] = queue.tasks.peek();
+                return next[0] != null ? queue : null;
+            });
+            return next[0];
+        }
+    }
+}
@@ -0,0 +1,153 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.channels.FileLock;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.Paths;
+import java.nio.file.StandardOpenOption;
+import java.util.concurrent.Executors;
+import java.util.concurrent.ScheduledExecutorService;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.logging.Level;
+import java.util.logging.Logger;
+
+/**
+ * Stores large payloads in shared memory segments that any transport on the host can map.
+ * A segment is a file named after its handle, (pid << 32) | sequence number, which travels in UPayload.reference.
+ * It starts with a 16 byte header (magic "UPSH", refcount as big-endian int, payload length as big-endian long)
+ * followed by the payload. The refcount is only changed under an fcntl record lock on the header, the lock
+ * FileChannel takes, and the segment is deleted when the count drops to zero.
+ */
+public class SharedMemoryPayloadStore {
+    private static final Logger logger = Logger.getLogger("JavaSharedMemoryPayloadStore");
+    /** Payloads of at least this many bytes are sent by reference when a transport has a payload store. */
+    public static final int SHM_PAYLOAD_THRESHOLD = 64 * 1024;
+    /** How long the sender keeps its reference, receivers have this long to acquire their own. */
+    public static final long SHM_RETENTION_MS = 10000;
+    private static final int SEGMENT_MAGIC = 0x55505348; // "UPSH"
+    private static final int SEGMENT_HEADER_LENGTH = 16;
+
+    private final Path directory;
+    private final AtomicInteger sequence = new AtomicInteger();
+    private final ScheduledExecutorService releaseScheduler = Executors.newSingleThreadScheduledExecutor(runnable -> {
+        Thread thread = new Thread(runnable, "shm-payload-release");
+        thread.setDaemon(true);
+        return thread;
+    });
+
+    public SharedMemoryPayloadStore() throws IOException {
+        // Segments live in tmpfs on Linux, so writing and mapping them never touches a disk
+        Path shm = Paths.get("/dev/shm");
+        directory = Files.isDirectory(shm) ? shm.resolve("uprotocol-tck")
+                : Paths.get(System.getProperty("java.io.tmpdir"), "uprotocol-tck");
+        Files.createDirectories(directory);
+    }
+
+    private Path segmentPath(long handle) {
+        return directory.resolve(String.format("%016x.payload", handle));
+    }
+
+    /**
+     * Writes data into a new segment and returns its handle. The sender's reference is released after retentionMs.
+     *
+     * @param data        The payload.
+     * @param retentionMs How long to keep the sender's reference.
+     * @return The handle to send in UPayload.reference.
+     * @throws IOException If the segment cannot be written.
+     */
+    public long put(byte[] data, long retentionMs) throws IOException {
+        long handle = (ProcessHandle.current().pid() << 32) | (sequence.incrementAndGet() & 0xFFFFFFFFL);
+        ByteBuffer header = ByteBuffer.allocate(SEGMENT_HEADER_LENGTH);
+        header.putInt(SEGMENT_MAGIC).putInt(1).putLong(data.length).flip();
+        try (FileChannel channel = FileChannel.open(segmentPath(handle), StandardOpenOption.CREATE_NEW,
+                StandardOpenOption.WRITE)) {
+            channel.write(new ByteBuffer[]{header, ByteBuffer.wrap(data)});
+        }
+        releaseScheduler.schedule(() -> release(handle), retentionMs, TimeUnit.MILLISECONDS);
+        return handle;
+    }
+
+    /**
+     * Maps the segment of handle read-only and takes a reference on it. Call {@link #release(long)} when done.
+     *
+     * @param handle The handle received in UPayload.reference.
+     * @return A read-only view of the payload, or null if the segment is gone.
+     */
+    public ByteBuffer acquire(long handle) {
+        try (FileChannel channel = FileChannel.open(segmentPath(handle), StandardOpenOption.READ,
+                StandardOpenOption.WRITE)) {
+            long length = addReference(channel, 1, handle);
+            if (length < 0) {
+                return null;
+            }
+            MappedByteBuffer mapping = channel.map(FileChannel.MapMode.READ_ONLY, SEGMENT_HEADER_LENGTH, length);
+            return mapping.asReadOnlyBuffer();
+        } catch (IOException e) {
+            logger.log(Level.SEVERE, "Shared payload " + Long.toHexString(handle) + " is not available", e);
+            return null;
+        }
+    }
+
+    /**
+     * Drops one reference on the segment of handle and deletes it once none are left.
+     *
+     * @param handle The handle of the segment.
+     */
+    public void release(long handle) {
+        try (FileChannel channel = FileChannel.open(segmentPath(handle), StandardOpenOption.READ,
+                StandardOpenOption.WRITE)) {
+            addReference(channel, -1, handle);
+        } catch (IOException e) {
+            logger.log(Level.FINE, "Shared payload " + Long.toHexString(handle) + " already released", e);
+        }
+    }
+
+    // FileChannel locks do not exclude threads of one process, the synchronized does
+    private synchronized long addReference(FileChannel channel, int delta, long handle) throws IOException {
+        try (FileLock ignored = channel.lock(0, SEGMENT_HEADER_LENGTH, false)) {
+            ByteBuffer header = ByteBuffer.allocate(SEGMENT_HEADER_LENGTH);
+            channel.read(header, 0);
+            header.flip();
+            int magic = header.getInt();
+            int refcount = header.getInt();
+            long length = header.getLong();
+            if (magic != SEGMENT_MAGIC || refcount == 0) {
+                return -1;
+            }
+            refcount = Math.max(refcount + delta, 0);
+            ByteBuffer refcountBuffer = ByteBuffer.allocate(Integer.BYTES).putInt(refcount);
+            refcountBuffer.flip();
+            channel.write(refcountBuffer, Integer.BYTES);
+            if (refcount == 0 && delta < 0) {
+                Files.deleteIfExists(segmentPath(handle));
+            }
+            return length;
+        }
+    }
+}
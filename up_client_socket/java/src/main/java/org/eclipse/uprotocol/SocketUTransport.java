@@ -26,17 +26,20 @@ import org.eclipse.uprotocol.transport.UListener;
 import org.eclipse.uprotocol.transport.UTransport;
 import org.eclipse.uprotocol.transport.builder.UAttributesBuilder;
 import org.eclipse.uprotocol.uri.factory.UResourceBuilder;
+import org.eclipse.uprotocol.uri.serializer.MicroUriSerializer;
 import org.eclipse.uprotocol.uri.validator.UriValidator;
 import org.eclipse.uprotocol.v1.*;
 import org.eclipse.uprotocol.validation.ValidationResult;
 
+import com.google.protobuf.CodedOutputStream;
+
 import java.io.IOException;
-import java.io.InputStream;
-import java.io.OutputStream;
-import java.net.Socket;
+import java.net.InetSocketAddress;
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
-import java.util.Arrays;
+import java.util.Map;
 import java.util.concurrent.*;
+import java.util.concurrent.atomic.AtomicReference;
 import java.util.logging.Level;
 import java.util.logging.Logger;
 
@@ -44,77 +47,214 @@ public class SocketUTransport implements UTransport, RpcClient {
     private static final Logger logger = Logger.getLogger("JavaSocketUTransport");
     private static final String DISPATCHER_IP = "127.0.0.1";
     private static final Integer DISPATCHER_PORT = 44444;
-    private static final int BYTES_MSG_LENGTH = 32767;
+    // Every frame starts with the length of the serialized UMessage and the id of the sending uEntity, followed by a
+    // routing header: message type, priority, lengths of the micro-URI forms of source and sink, ttl and both
+    // micro-URIs, zero-padded to MICRO_URI_MAX_LENGTH bytes
+    static final int FRAME_HEADER_LENGTH = 64;
+    private static final int MICRO_URI_MAX_LENGTH = 24;
+    private static final int SOURCE_OFFSET = 16;
+    // Control frames carry no UMessage, they tell the Dispatcher which UUris the connection listens on
+    private static final int CONTROL_LISTEN = 0x80;
+    private static final int CONTROL_UNLISTEN = 0x81;
     private static final UUri RESPONSE_URI;
+    // RPC timeouts of all transports share one thread instead of sleeping on a thread per request
+    private static final ScheduledThreadPoolExecutor TIMEOUTS = newTimeoutScheduler();
+    private static final Clock SYSTEM_CLOCK = (task, delayMs) -> TIMEOUTS.schedule(task, delayMs,
+            TimeUnit.MILLISECONDS);
+    // Threads of a connection calling listeners by default, a slow topic occupies only one of them
+    private static final int CALLBACK_THREADS = 4;
+    // Callbacks that may be pending before the I/O thread stops reading from the Dispatcher
+    private static final int MAX_PENDING_CALLBACKS = 10000;
 
     static {
         RESPONSE_URI = UUri.newBuilder().setEntity(UEntity.newBuilder().setName("test_agent_java").setVersionMajor(1))
                 .setResource(UResourceBuilder.forRpcResponse()).build();
     }
 
-    private final Socket socket;
+    private final DispatcherChannel channel;
     private final ConcurrentHashMap<UUID, CompletionStage<UMessage>> reqid_to_future;
     private final ConcurrentHashMap<UUri, ArrayList<UListener>> uri_to_listener;
-    private final Object lock = new Object();
+    private final Object lock;
+    // Runs listener callbacks and completes RPC futures, null to do so on the I/O thread of the connection
+    private final AtomicReference<OrderedExecutor> callbackExecutor;
+    private final TransportStats stats;
+    private final int entityId;
+    private final UUri responseUri;
+    private volatile SharedMemoryPayloadStore payloadStore;
+    // Resolves the payloads received by reference, whether or not this transport sends any
+    private final SharedMemoryPayloadStore receivePayloadStore;
+    private volatile Clock clock = SYSTEM_CLOCK;
 
 
     public SocketUTransport() throws IOException {
         reqid_to_future = new ConcurrentHashMap<>();
         uri_to_listener = new ConcurrentHashMap<>();
-        socket = new Socket(DISPATCHER_IP, DISPATCHER_PORT);
-        ExecutorService executor = Executors.newFixedThreadPool(5);
-        executor.submit(this::listen);
-        executor.shutdown();
+        lock = new Object();
+        callbackExecutor = new AtomicReference<>(new OrderedExecutor(Executors.newFixedThreadPool(CALLBACK_THREADS,
+                runnable -> {
+                    Thread thread = new Thread(runnable, "SocketUTransport-callbacks");
+                    thread.setDaemon(true);
+                    return thread;
+                }), MAX_PENDING_CALLBACKS));
+        stats = new TransportStats();
+        receivePayloadStore = openReceivePayloadStore();
+        entityId = 0;
+        responseUri = RESPONSE_URI;
+        channel = DispatcherChannel.open(new InetSocketAddress(DISPATCHER_IP, DISPATCHER_PORT), this::handleFrame);
+    }
+
+    /**
+     * Creates a transport for another uEntity which shares the Dispatcher connection of an existing transport.
+     * Incoming messages are demultiplexed locally to the listeners of every uEntity sharing the connection.
+     *
+     * @param session  The transport whose connection is shared.
+     * @param entityId Identifies this uEntity in the frames it sends.
+     */
+    public SocketUTransport(SocketUTransport session, int entityId) {
+        reqid_to_future = session.reqid_to_future;
+        uri_to_listener = session.uri_to_listener;
+        lock = session.lock;
+        callbackExecutor = session.callbackExecutor;
+        stats = session.stats;
+        channel = session.channel;
+        payloadStore = session.payloadStore;
+        receivePayloadStore = session.receivePayloadStore;
+        clock = session.clock;
+        this.entityId = entityId;
+        responseUri = UUri.newBuilder().setEntity(RESPONSE_URI.getEntity().toBuilder().setId(entityId))
+                .setResource(UResourceBuilder.forRpcResponse()).build();
+    }
+
+    private static SharedMemoryPayloadStore openReceivePayloadStore() {
+        try {
+            return new SharedMemoryPayloadStore();
+        } catch (IOException e) {
+            logger.log(Level.SEVERE, "Shared payloads cannot be received: " + e.getMessage(), e);
+            return null;
+        }
+    }
+
+    private static ScheduledThreadPoolExecutor newTimeoutScheduler() {
+        ScheduledThreadPoolExecutor scheduler = new ScheduledThreadPoolExecutor(1, runnable -> {
+            Thread thread = new Thread(runnable, "SocketUTransport-timeouts");
+            thread.setDaemon(true);
+            return thread;
+        });
+        // Most requests are answered, their timeouts must not pile up in the queue until they expire
+        scheduler.setRemoveOnCancelPolicy(true);
+        return scheduler;
+    }
+
+    /**
+     * Runs listener callbacks and completes RPC response futures on the given executor instead of the
+     * {@value #CALLBACK_THREADS} threads of the connection, for every uEntity sharing it. Callbacks of one topic
+     * still run one at a time and in the order the messages were received, callbacks of different topics run in
+     * parallel. Once {@value #MAX_PENDING_CALLBACKS} callbacks are pending, reading from the Dispatcher waits.
+     *
+     * @param executor The executor, e.g. one starting a virtual thread per task, or null to run callbacks on the
+     *                 I/O thread.
+     */
+    public void setCallbackExecutor(Executor executor) {
+        callbackExecutor.set(executor != null ? new OrderedExecutor(executor, MAX_PENDING_CALLBACKS) : null);
+    }
+
+    /**
+     * Returns the counters of the callback dispatch, empty if callbacks run on the I/O thread.
+     */
+    public Map<String, Long> getCallbackMetrics() {
+        OrderedExecutor executor = callbackExecutor.get();
+        return executor != null ? executor.getMetrics() : Map.of();
+    }
+
+    /**
+     * Returns what the Dispatcher connection has done so far, see {@link TransportStats}, together with the requests
+     * still waiting for their response and the depths of the send and callback queues.
+     */
+    public Map<String, Object> getStats() {
+        Map<String, Object> stats = this.stats.snapshot();
+        stats.put("pending_rpc", reqid_to_future.size());
+        Map<String, Long> callbackMetrics = getCallbackMetrics();
+        stats.put("queue_depths", Map.of("send_queued_bytes", channel.queuedBytes(), "listener_dispatch_pending",
+                callbackMetrics.getOrDefault("pending", 0L), "listener_dispatch_pending_high_water",
+                callbackMetrics.getOrDefault("pending_high_water", 0L)));
+        return stats;
+    }
+
+    /**
+     * Sends payloads of at least {@link SharedMemoryPayloadStore#SHM_PAYLOAD_THRESHOLD} bytes by reference
+     * through the given store.
+     *
+     * @param payloadStore The store, or null to send every payload by value.
+     */
+    public void setPayloadStore(SharedMemoryPayloadStore payloadStore) {
+        this.payloadStore = payloadStore;
+    }
+
+    /**
+     * Times out RPC requests on the given clock instead of in real time, e.g. on a {@link VirtualClock}.
+     *
+     * @param clock The clock of the RPC timeouts.
+     */
+    public void setClock(Clock clock) {
+        this.clock = clock;
+    }
+
+    /**
+     * Moves a large payload into shared memory, the returned message only carries its reference and length.
+     *
+     * @param message The message to be sent.
+     * @return The message to serialize.
+     * @throws IOException If the payload cannot be written to shared memory.
+     */
+    private UMessage withPayloadReference(UMessage message) throws IOException {
+        SharedMemoryPayloadStore store = payloadStore;
+        UPayload payload = message.getPayload();
+        if (store == null || !payload.hasValue()
+                || payload.getValue().size() < SharedMemoryPayloadStore.SHM_PAYLOAD_THRESHOLD) {
+            return message;
+        }
+        int ttl = message.getAttributes().getTtl();
+        long retentionMs = ttl > 0 ? ttl : SharedMemoryPayloadStore.SHM_RETENTION_MS;
+        long handle = store.put(payload.getValue().toByteArray(), retentionMs);
+        return message.toBuilder().setPayload(payload.toBuilder().setReference(handle)
+                .setLength(payload.getValue().size())).build();
     }
 
     /**
-     * Listens for incoming messages on the socket input stream from dispatcher.
+     * Handles a UMessage received from the dispatcher, on the I/O thread of the connection.
      * Messages are processed based on their type: PUBLISH, REQUEST, or RESPONSE.
      * Handles each message accordingly by invoking corresponding handler methods.
      */
-    private void listen() {
+    private void handleFrame(byte[] buffer) throws IOException {
+        // Only the attributes are needed to find a consumer, the payload is decoded once one exists
+        UMessageWire umsg;
         try {
-            while (true) {
-                byte[] buffer = new byte[BYTES_MSG_LENGTH];
-                InputStream inputStream = socket.getInputStream();
-                int readSize = inputStream.read(buffer);
-
-                if (readSize < 0) {
-                    if (!socket.isClosed()) {
-                        socket.close();
-                    }
-                    return;
-                }
-                UMessage umsg = UMessage.parseFrom(Arrays.copyOfRange(buffer, 0, readSize));
-                UAttributes attributes = umsg.getAttributes();
-                String logMessage = " Received uMessage";
-
-                switch (attributes.getType()) {
-                    case UMESSAGE_TYPE_PUBLISH:
-                        handlePublishMessage(umsg);
-                        break;
-                    case UMESSAGE_TYPE_REQUEST:
-                        handleRequestMessage(umsg);
-                        break;
-                    case UMESSAGE_TYPE_RESPONSE:
-                        handleResponseMessage(umsg);
-                        break;
-                    default:
-                        logger.warning(logMessage + " with unknown message type.");
-                }
-
-                logger.info(logMessage);
-            }
+            umsg = UMessageWire.split(buffer);
         } catch (IOException e) {
-            try {
-                if (!socket.isClosed()) {
-                    socket.close();
-                }
-            } catch (IOException ioException) {
-                logger.log(Level.SEVERE, "Error while closing socket: " + ioException.getMessage(), ioException);
-            }
-            logger.log(Level.SEVERE, "Error while listening for messages: " + e.getMessage(), e);
+            stats.recordParseError();
+            logger.log(Level.SEVERE, "Error while parsing a received message: " + e.getMessage(), e);
+            return;
+        }
+        UAttributes attributes = umsg.getAttributes();
+        String logMessage = " Received uMessage";
+        stats.recordReceived(attributes.getType() == UMessageType.UMESSAGE_TYPE_PUBLISH ? attributes.getSource()
+                : attributes.getSink(), buffer.length);
+
+        switch (attributes.getType()) {
+            case UMESSAGE_TYPE_PUBLISH:
+                handlePublishMessage(umsg);
+                break;
+            case UMESSAGE_TYPE_REQUEST:
+                handleRequestMessage(umsg);
+                break;
+            case UMESSAGE_TYPE_RESPONSE:
+                handleResponseMessage(umsg);
+                break;
+            default:
+                logger.warning(logMessage + " with unknown message type.");
         }
+
+        logger.info(logMessage);
     }
 
     /**
@@ -122,7 +262,7 @@ public class SocketUTransport implements UTransport, RpcClient {
      *
      * @param umsg The publish message to handle.
      */
-    private void handlePublishMessage(UMessage umsg) {
+    private void handlePublishMessage(UMessageWire umsg) throws IOException {
         UUri uri = umsg.getAttributes().getSource();
         notifyListeners(uri, umsg);
     }
@@ -132,7 +272,7 @@ public class SocketUTransport implements UTransport, RpcClient {
      *
      * @param umsg The request message to handle.
      */
-    private void handleRequestMessage(UMessage umsg) {
+    private void handleRequestMessage(UMessageWire umsg) throws IOException {
         UUri uri = umsg.getAttributes().getSink();
         notifyListeners(uri, umsg);
     }
@@ -143,20 +283,50 @@ public class SocketUTransport implements UTransport, RpcClient {
      * @param uri  The URI for which listeners are to be notified.
      * @param umsg The message to be delivered to the listeners.
      */
-    private void notifyListeners(UUri uri, UMessage umsg) {
+    private void notifyListeners(UUri uri, UMessageWire umsg) throws IOException {
+        OrderedExecutor executor = callbackExecutor.get();
+        if (executor != null) {
+            ArrayList<UListener> listeners;
+            synchronized (lock) {
+                listeners = uri_to_listener.get(uri);
+                listeners = listeners != null ? new ArrayList<>(listeners) : null;
+            }
+            if (listeners == null) {
+                logger.info(getClass().getSimpleName() + " Uri not found in Listener Map, discarding...");
+                return;
+            }
+            ArrayList<UListener> topicListeners = listeners;
+            executor.execute(uri, () -> notifyListeners(topicListeners, umsg));
+            return;
+        }
 
         synchronized (lock) {
 
             ArrayList<UListener> listeners = uri_to_listener.get(uri);
             if (listeners != null) {
                 logger.info("Handle Uri");
-                listeners.forEach(listener -> listener.onReceive(umsg));
+                UMessage message = umsg.toUMessage(receivePayloadStore);
+                stats.recordListenerInvocations(listeners.size());
+                listeners.forEach(listener -> listener.onReceive(message));
             } else {
                 logger.info(getClass().getSimpleName() + " Uri not found in Listener Map, discarding...");
             }
         }
     }
 
+    private void notifyListeners(ArrayList<UListener> listeners, UMessageWire umsg) {
+        UMessage message;
+        try {
+            message = umsg.toUMessage(receivePayloadStore);
+        } catch (IOException e) {
+            stats.recordParseError();
+            logger.log(Level.SEVERE, "Error while decoding a received message: " + e.getMessage(), e);
+            return;
+        }
+        stats.recordListenerInvocations(listeners.size());
+        listeners.forEach(listener -> listener.onReceive(message));
+    }
+
     /**
      * Handles the response message received from the server.
      * Completes the CompletableFuture associated with the request ID
@@ -164,25 +334,112 @@ public class SocketUTransport implements UTransport, RpcClient {
      *
      * @param umsg The response message to handle.
      */
-    private void handleResponseMessage(UMessage umsg) {
+    private void handleResponseMessage(UMessageWire umsg) throws IOException {
         UUID requestId = umsg.getAttributes().getReqid();
         CompletionStage<UMessage> responseFuture = reqid_to_future.remove(requestId);
         if (responseFuture != null) {
-            responseFuture.toCompletableFuture().complete(umsg);
+            UMessage response = umsg.toUMessage(receivePayloadStore);
+            complete(() -> responseFuture.toCompletableFuture().complete(response));
+        }
+    }
+
+    /**
+     * Completes an RPC response future, on the callback executor if there is one, so that the callbacks of the
+     * future run there as well.
+     */
+    private void complete(Runnable completion) {
+        OrderedExecutor executor = callbackExecutor.get();
+        if (executor != null) {
+            executor.execute(completion);
+        } else {
+            completion.run();
+        }
+    }
+
+    /**
+     * Returns the micro-URI form of a UUri for the routing header, or an empty array if it has none that fits,
+     * in which case the Dispatcher cannot route on it.
+     */
+    private static byte[] microUri(UUri uri) {
+        byte[] microUri = MicroUriSerializer.instance().serialize(uri);
+        return microUri.length <= MICRO_URI_MAX_LENGTH ? microUri : new byte[0];
+    }
+
+    /**
+     * Takes a pooled buffer for a frame with a UMessage of the given length and fills in its header.
+     */
+    private ByteBuffer newFrame(int umsgLength, int messageType, int priority, int ttl, byte[] source, byte[] sink) {
+        ByteBuffer frame = channel.allocateFrame(FRAME_HEADER_LENGTH + umsgLength);
+        frame.putInt(umsgLength).putInt(entityId);
+        frame.put((byte) messageType).put((byte) priority).put((byte) source.length).put((byte) sink.length);
+        frame.putInt(ttl).put(source);
+        frame.position(SOURCE_OFFSET + MICRO_URI_MAX_LENGTH);
+        frame.put(sink);
+        frame.position(FRAME_HEADER_LENGTH);
+        return frame;
+    }
+
+    /**
+     * Batches the frames sent over this transport's Dispatcher connection, by every uEntity sharing it,
+     * until batchBytes are pending or the oldest of them waited for batchDelayMs.
+     * Messages of priority CS5 and CS6 are never delayed.
+     *
+     * @param batchBytes   Pending bytes that trigger sending the batch, 0 disables batching.
+     * @param batchDelayMs The longest a batched message waits to be sent.
+     * @throws IOException If the connection to the Dispatcher is closed.
+     */
+    public void setBatching(int batchBytes, long batchDelayMs) throws IOException {
+        channel.setBatching(batchBytes, batchDelayMs);
+    }
+
+    /**
+     * Sends all batched messages now.
+     *
+     * @return A status indicating the outcome of the flush.
+     */
+    public UStatus flush() {
+        try {
+            channel.flush();
+            return UStatus.newBuilder().setCode(UCode.OK).setMessage("OK").build();
+        } catch (IOException e) {
+            logger.log(Level.SEVERE, "INTERNAL ERROR: ", e);
+            return UStatus.newBuilder().setCode(UCode.INTERNAL).setMessage("INTERNAL ERROR: " + e.getMessage()).build();
+        }
+    }
+
+    /**
+     * Tells the Dispatcher to add or remove the given UUri as a route to this connection.
+     */
+    private void sendControl(int controlType, UUri topic) {
+        try {
+            channel.write(newFrame(0, controlType, 0, 0, new byte[0], microUri(topic)), true);
+        } catch (IOException e) {
+            logger.log(Level.SEVERE, "Error while updating the Dispatcher routes: " + e.getMessage(), e);
         }
     }
 
     /**
      * Sends the provided message over the socket connection.
+     * The message is serialized into a pooled buffer and queued, the I/O thread of the connection writes it.
      *
      * @param message The message to be sent.
      * @return A status indicating the outcome of the send operation.
      */
     public UStatus send(UMessage message) {
-        byte[] umsgSerialized = message.toByteArray();
         try {
-            OutputStream outputStream = socket.getOutputStream();
-            outputStream.write(umsgSerialized);
+            UMessage umsg = withPayloadReference(message);
+            int umsgLength = umsg.getSerializedSize();
+            UAttributes attributes = message.getAttributes();
+            ByteBuffer frame = newFrame(umsgLength, attributes.getTypeValue(), attributes.getPriorityValue(),
+                    attributes.getTtl(), microUri(attributes.getSource()), microUri(attributes.getSink()));
+            CodedOutputStream output = CodedOutputStream.newInstance(frame);
+            umsg.writeTo(output);
+            output.flush();
+            frame.position(FRAME_HEADER_LENGTH + umsgLength);
+            boolean urgent = attributes.getPriorityValue() >= UPriority.UPRIORITY_CS5_VALUE;
+            channel.write(frame, urgent);
+            stats.recordSent(attributes.getType() == UMessageType.UMESSAGE_TYPE_PUBLISH ? attributes.getSource()
+                    : attributes.getSink(), umsgLength);
             logger.info("uMessage Sent to dispatcher fron java socket transport");
             return UStatus.newBuilder().setCode(UCode.OK).setMessage("OK").build();
         } catch (IOException e) {
@@ -204,6 +461,7 @@ public class SocketUTransport implements UTransport, RpcClient {
             return result.toStatus();
         }
         uri_to_listener.computeIfAbsent(topic, k -> new ArrayList<>()).add(listener);
+        sendControl(CONTROL_LISTEN, topic);
         return UStatus.newBuilder().setCode(UCode.OK).setMessage("OK").build();
     }
 
@@ -224,6 +482,7 @@ public class SocketUTransport implements UTransport, RpcClient {
             if (listeners.isEmpty()) {
                 uri_to_listener.remove(topic);
             }
+            sendControl(CONTROL_UNLISTEN, topic);
             return UStatus.newBuilder().setCode(UCode.OK).setMessage("OK").build();
         }
         return UStatus.newBuilder().setCode(UCode.NOT_FOUND).setMessage("Listener not found for the given UUri")
@@ -239,14 +498,15 @@ public class SocketUTransport implements UTransport, RpcClient {
      * @return A CompletableFuture that will hold the response message for the request.
      */
     public CompletionStage<UMessage> invokeMethod(UUri methodUri, UPayload requestPayload, CallOptions options) {
-        UAttributes attributes = UAttributesBuilder.request(RESPONSE_URI, methodUri, UPriority.UPRIORITY_CS4,
+        UAttributes attributes = UAttributesBuilder.request(responseUri, methodUri, UPriority.UPRIORITY_CS4,
                 options.getTtl()).build();
         UUID requestId = attributes.getId();
         CompletableFuture<UMessage> responseFuture = new CompletableFuture<>();
         reqid_to_future.put(requestId, responseFuture);
 
-        Thread timeoutThread = new Thread(() -> timeoutCounter(responseFuture, requestId, options.getTtl()));
-        timeoutThread.start();
+        int timeout = options.getTtl();
+        Future<?> timeoutTask = clock.schedule(() -> expireRequest(responseFuture, requestId, timeout), timeout);
+        responseFuture.whenComplete((response, exception) -> timeoutTask.cancel(false));
 
         UMessage umsg = UMessage.newBuilder().setPayload(requestPayload).setAttributes(attributes).build();
         send(umsg);
@@ -254,21 +514,18 @@ public class SocketUTransport implements UTransport, RpcClient {
     }
 
     /**
-     * Waits for the specified timeout and completes the CompletableFuture exceptionally if no response is received.
+     * Completes the CompletableFuture exceptionally if no response has been received within the timeout.
      *
      * @param responseFuture The CompletableFuture to complete exceptionally.
      * @param requestId      The request ID associated with the response.
      * @param timeout        The timeout duration.
      */
-    private void timeoutCounter(CompletableFuture<UMessage> responseFuture, UUID requestId, int timeout) {
-        try {
-            Thread.sleep(timeout);
-            if (!responseFuture.isDone()) {
-                responseFuture.completeExceptionally(new TimeoutException(
-                        "Not received response for request " + requestId.toString() + " within " + timeout + " ms"));
-            }
-        } catch (InterruptedException e) {
-            Thread.currentThread().interrupt();
+    private void expireRequest(CompletableFuture<UMessage> responseFuture, UUID requestId, int timeout) {
+        if (reqid_to_future.remove(requestId, responseFuture)) {
+            stats.recordRpcTimeout();
+            TimeoutException exception = new TimeoutException(
+                    "Not received response for request " + requestId.toString() + " within " + timeout + " ms");
+            complete(() -> responseFuture.completeExceptionally(exception));
         }
     }
 }
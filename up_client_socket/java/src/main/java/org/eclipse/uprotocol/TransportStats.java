@@ -0,0 +1,108 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import org.eclipse.uprotocol.uri.serializer.LongUriSerializer;
+import org.eclipse.uprotocol.v1.UUri;
+
+import java.util.HashMap;
+import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.atomic.LongAdder;
+
+/**
+ * Counts what a Dispatcher connection has done: messages and bytes sent and received per topic, received frames that
+ * could not be parsed, listener invocations and requests that timed out.
+ * Counting is contention free, so that it can stay enabled while benchmarking.
+ */
+final class TransportStats {
+    private final TopicCounters sent = new TopicCounters();
+    private final TopicCounters received = new TopicCounters();
+    private final LongAdder parseErrors = new LongAdder();
+    private final LongAdder listenerInvocations = new LongAdder();
+    private final LongAdder rpcTimeouts = new LongAdder();
+
+    void recordSent(UUri topic, int length) {
+        sent.add(topic, length);
+    }
+
+    void recordReceived(UUri topic, int length) {
+        received.add(topic, length);
+    }
+
+    void recordParseError() {
+        parseErrors.increment();
+    }
+
+    void recordListenerInvocations(int count) {
+        listenerInvocations.add(count);
+    }
+
+    void recordRpcTimeout() {
+        rpcTimeouts.increment();
+    }
+
+    Map<String, Object> snapshot() {
+        Map<String, Object> stats = new HashMap<>();
+        stats.put("sent", sent.snapshot());
+        stats.put("received", received.snapshot());
+        stats.put("parse_errors", parseErrors.sum());
+        stats.put("listener_invocations", listenerInvocations.sum());
+        stats.put("rpc_timeouts", rpcTimeouts.sum());
+        return stats;
+    }
+
+    private static final class Counter {
+        private final LongAdder messages = new LongAdder();
+        private final LongAdder bytes = new LongAdder();
+    }
+
+    private static final class TopicCounters {
+        private final ConcurrentHashMap<UUri, Counter> topics = new ConcurrentHashMap<>();
+
+        void add(UUri topic, int length) {
+            Counter counter = topics.computeIfAbsent(topic, k -> new Counter());
+            counter.messages.increment();
+            counter.bytes.add(length);
+        }
+
+        Map<String, Object> snapshot() {
+            // Topics are reported by their long form, which several UUris may share
+            Map<String, long[]> byName = new HashMap<>();
+            for (Map.Entry<UUri, Counter> topic : topics.entrySet()) {
+                long[] counts = byName.computeIfAbsent(LongUriSerializer.instance().serialize(topic.getKey()),
+                        k -> new long[2]);
+                counts[0] += topic.getValue().messages.sum();
+                counts[1] += topic.getValue().bytes.sum();
+            }
+            Map<String, Object> topicStats = new HashMap<>();
+            long messages = 0;
+            long bytes = 0;
+            for (Map.Entry<String, long[]> topic : byName.entrySet()) {
+                topicStats.put(topic.getKey(), Map.of("messages", topic.getValue()[0], "bytes", topic.getValue()[1]));
+                messages += topic.getValue()[0];
+                bytes += topic.getValue()[1];
+            }
+            return Map.of("messages", messages, "bytes", bytes, "topics", topicStats);
+        }
+    }
+}
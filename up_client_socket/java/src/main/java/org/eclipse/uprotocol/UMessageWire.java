@@ -0,0 +1,121 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import com.google.protobuf.ByteString;
+import com.google.protobuf.CodedInputStream;
+import com.google.protobuf.InvalidProtocolBufferException;
+import com.google.protobuf.WireFormat;
+import org.eclipse.uprotocol.v1.UAttributes;
+import org.eclipse.uprotocol.v1.UMessage;
+import org.eclipse.uprotocol.v1.UPayload;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.logging.Logger;
+
+/**
+ * Splits a serialized UMessage into its attributes and payload without decoding either, so that the payload
+ * is only decoded for messages that have a consumer.
+ */
+public final class UMessageWire {
+    private static final Logger logger = Logger.getLogger("JavaSocketUTransport");
+    // Field numbers of UMessage
+    private static final int UMESSAGE_ATTRIBUTES_FIELD = 1;
+    private static final int UMESSAGE_PAYLOAD_FIELD = 2;
+
+    private final UAttributes attributes;
+    private final ByteString payload;
+
+    private UMessageWire(UAttributes attributes, ByteString payload) {
+        this.attributes = attributes;
+        this.payload = payload;
+    }
+
+    /**
+     * Decodes the attributes of a serialized UMessage and keeps a view of its serialized payload.
+     * Occurrences of a field repeated on the wire are concatenated, which protobuf defines as merging them.
+     *
+     * @param data The serialized UMessage.
+     * @return The split message.
+     * @throws IOException If data is not a well-formed protobuf message.
+     */
+    public static UMessageWire split(byte[] data) throws IOException {
+        CodedInputStream input = CodedInputStream.newInstance(data);
+        // Length-delimited fields are returned as views of data instead of copies
+        input.enableAliasing(true);
+        ByteString attributes = ByteString.EMPTY;
+        ByteString payload = ByteString.EMPTY;
+        int tag;
+        while ((tag = input.readTag()) != 0) {
+            int fieldNumber = WireFormat.getTagFieldNumber(tag);
+            boolean lengthDelimited = WireFormat.getTagWireType(tag) == WireFormat.WIRETYPE_LENGTH_DELIMITED;
+            if (lengthDelimited && fieldNumber == UMESSAGE_ATTRIBUTES_FIELD) {
+                attributes = attributes.concat(input.readBytes());
+            } else if (lengthDelimited && fieldNumber == UMESSAGE_PAYLOAD_FIELD) {
+                payload = payload.concat(input.readBytes());
+            } else if (!input.skipField(tag)) {
+                break;
+            }
+        }
+        return new UMessageWire(UAttributes.parseFrom(attributes), payload);
+    }
+
+    public UAttributes getAttributes() {
+        return attributes;
+    }
+
+    /**
+     * Decodes the payload and completes the message, once a consumer for it is known.
+     * A payload sent by reference is copied out of shared memory, consumers always get its value.
+     *
+     * @param payloadStore The store resolving payloads sent by reference, or null if shared memory is unavailable.
+     * @return The complete UMessage.
+     * @throws InvalidProtocolBufferException If the payload is malformed.
+     */
+    public UMessage toUMessage(SharedMemoryPayloadStore payloadStore) throws InvalidProtocolBufferException {
+        UMessage.Builder builder = UMessage.newBuilder().setAttributes(attributes);
+        if (!payload.isEmpty()) {
+            UPayload decoded = UPayload.parseFrom(payload);
+            builder.setPayload(decoded.hasReference() ? resolveReference(decoded, payloadStore) : decoded);
+        }
+        return builder.build();
+    }
+
+    private static UPayload resolveReference(UPayload payload, SharedMemoryPayloadStore payloadStore) {
+        long handle = payload.getReference();
+        if (payloadStore == null) {
+            logger.severe("Shared payload " + Long.toHexString(handle) + " received without shared memory support");
+            return payload.toBuilder().setValue(ByteString.EMPTY).build();
+        }
+        // acquire logs why a segment is not available
+        ByteBuffer data = payloadStore.acquire(handle);
+        if (data == null) {
+            return payload.toBuilder().setValue(ByteString.EMPTY).build();
+        }
+        try {
+            return payload.toBuilder().setValue(ByteString.copyFrom(data)).build();
+        } finally {
+            payloadStore.release(handle);
+        }
+    }
+}
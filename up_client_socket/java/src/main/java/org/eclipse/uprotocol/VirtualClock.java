@@ -0,0 +1,98 @@
+/**
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+package org.eclipse.uprotocol;
+
+import java.util.PriorityQueue;
+import java.util.concurrent.Future;
+import java.util.concurrent.FutureTask;
+
+/**
+ * Clock which stands still until it is advanced, e.g. by the "advance_clock" command of the Test Manager.
+ * Tasks which become due run on the advancing thread in due order, so expiry and timeout scenarios run instantly
+ * and deterministically.
+ */
+public final class VirtualClock implements Clock {
+    private final PriorityQueue<Timer> timers = new PriorityQueue<>();
+    private long nowMs;
+    private long sequence;
+
+    @Override
+    public Future<?> schedule(Runnable task, long delayMs) {
+        FutureTask<Void> future = new FutureTask<>(task, null);
+        synchronized (this) {
+            timers.add(new Timer(nowMs + delayMs, sequence++, future));
+        }
+        return future;
+    }
+
+    /**
+     * Moves the clock forward and runs the tasks due until then.
+     *
+     * @param ms The milliseconds to advance by.
+     */
+    public void advance(long ms) {
+        long targetMs;
+        synchronized (this) {
+            targetMs = nowMs + ms;
+        }
+        while (true) {
+            Timer timer;
+            synchronized (this) {
+                timer = timers.peek();
+                if (timer == null || timer.dueMs > targetMs) {
+                    nowMs = targetMs;
+                    return;
+                }
+                timers.poll();
+                nowMs = timer.dueMs;
+            }
+            // A cancelled task does not run
+            timer.task.run();
+        }
+    }
+
+    /**
+     * Returns the milliseconds the clock has been advanced by.
+     */
+    public synchronized long nowMs() {
+        return nowMs;
+    }
+
+    private static final class Timer implements Comparable<Timer> {
+        private final long dueMs;
+        // Orders tasks due at the same time by scheduling
+        private final long sequence;
+        private final FutureTask<Void> task;
+
+        private Timer(long dueMs, long sequence, FutureTask<Void> task) {
+            this.dueMs = dueMs;
+            this.sequence = sequence;
+            this.task = task;
+        }
+
+        @Override
+        public int compareTo(Timer other) {
+            int byDue = Long.compare(dueMs, other.dueMs);
+            return byDue != 0 ? byDue : Long.compare(sequence, other.sequence);
+        }
+    }
+}
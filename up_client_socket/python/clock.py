@@ -0,0 +1,128 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import heapq
+import itertools
+import logging
+import time
+from threading import Condition, Lock, Thread
+from typing import Callable, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+
+class ScheduledCall:
+    def __init__(self, callback: Callable[[], None]):
+        self.callback = callback
+        self.cancelled: bool = False
+
+    def cancel(self):
+        """
+        Keeps the callback from running if it has not run yet.
+        """
+        self.cancelled = True
+
+    def run(self):
+        if self.cancelled:
+            return
+        try:
+            self.callback()
+        except Exception as e:
+            logger.error(f"Scheduled callback failed: {e}")
+
+
+class Clock:
+    def __init__(self):
+        """
+        Schedules the timeouts of transports and Test Agents in real time.
+        All timers of a clock run on one daemon thread, so pending timeouts cost no thread each.
+        """
+        self.lock = Lock()
+        self.changed = Condition(self.lock)
+        # (due, sequence, call) ordered by due time, calls due at the same time in scheduling order; guarded by lock
+        self.timers: List[Tuple[float, int, ScheduledCall]] = []
+        self.sequence = itertools.count()
+        self.thread: Optional[Thread] = None
+
+    def now(self) -> float:
+        """
+        Returns the time of the clock in seconds, only differences between two values are meaningful.
+        """
+        return time.monotonic()
+
+    def call_later(self, delay_s: float, callback: Callable[[], None]) -> ScheduledCall:
+        """
+        Runs a callback once delay_s seconds of the clock have passed.
+
+        :return: The scheduled call, which can be cancelled.
+        """
+        call = ScheduledCall(callback)
+        with self.lock:
+            heapq.heappush(self.timers, (self.now() + delay_s, next(self.sequence), call))
+            self._timer_added()
+        return call
+
+    def _timer_added(self):
+        if self.thread is None:
+            self.thread = Thread(target=self._run, name="clock-timers", daemon=True)
+            self.thread.start()
+        self.changed.notify()
+
+    def _run(self):
+        while True:
+            with self.lock:
+                while not self.timers or self.timers[0][0] > self.now():
+                    self.changed.wait(self.timers[0][0] - self.now() if self.timers else None)
+                _, _, call = heapq.heappop(self.timers)
+            call.run()
+
+
+class VirtualClock(Clock):
+    def __init__(self):
+        """
+        Stands still until it is advanced, e.g. by the "advance_clock" command of the Test Manager.
+        Timers which become due run on the advancing thread in due order, so expiry and timeout scenarios run
+        instantly and deterministically.
+        """
+        super().__init__()
+        self.virtual_now: float = 0.0
+
+    def now(self) -> float:
+        return self.virtual_now
+
+    def _timer_added(self):
+        # Due timers only run in advance()
+        pass
+
+    def advance(self, seconds: float):
+        """
+        Moves the clock forward and runs the timers due until then.
+        """
+        with self.lock:
+            target = self.virtual_now + seconds
+        while True:
+            with self.lock:
+                if not self.timers or self.timers[0][0] > target:
+                    self.virtual_now = target
+                    return
+                due, _, call = heapq.heappop(self.timers)
+                self.virtual_now = due
+            call.run()
+
+
+# Shared by all transports which are not given a clock of their own
+REAL_CLOCK = Clock()
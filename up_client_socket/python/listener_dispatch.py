@@ -0,0 +1,113 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import logging
+import time
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+from threading import Condition, Lock
+from typing import Any, Callable, Deque, Dict, Hashable
+
+logger = logging.getLogger(__name__)
+
+DISPATCH_WORKERS: int = 4
+MAX_PENDING_CALLBACKS: int = 10000
+
+
+class OrderedDispatcher:
+    def __init__(self, workers: int = DISPATCH_WORKERS, max_pending: int = MAX_PENDING_CALLBACKS):
+        """
+        Runs listener callbacks off the socket reader thread, one at a time and in submission order per key,
+        e.g. per topic, while the callbacks of different keys run in parallel.
+        At most max_pending callbacks wait or run, submitting blocks beyond that, so a slow listener pushes back on
+        the Dispatcher through TCP instead of growing memory.
+
+        :param workers: Threads running callbacks, a slow key occupies only one of them.
+        :param max_pending: Callbacks that may be pending before submit blocks.
+        """
+        self.executor = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="listener-dispatch")
+        self.max_pending = max_pending
+        self.lock = Lock()
+        self.not_full = Condition(self.lock)
+        # key -> callbacks of the key, the first of them is running; guarded by lock
+        self.queues: Dict[Hashable, Deque[Callable[[], None]]] = {}
+        self.pending: int = 0
+        self.pending_high_water: int = 0
+        self.submitted: int = 0
+        self.completed: int = 0
+        self.failed: int = 0
+        self.blocked: int = 0
+        self.blocked_s: float = 0.0
+
+    def submit(self, key: Hashable, callback: Callable[[], None]):
+        """
+        Runs a callback after all callbacks submitted before for the same key.
+        """
+        with self.lock:
+            if self.pending >= self.max_pending:
+                self.blocked += 1
+                blocked_start = time.perf_counter()
+                while self.pending >= self.max_pending:
+                    self.not_full.wait()
+                self.blocked_s += time.perf_counter() - blocked_start
+            self.pending += 1
+            self.submitted += 1
+            self.pending_high_water = max(self.pending_high_water, self.pending)
+            queue = self.queues.get(key)
+            if queue is not None:
+                queue.append(callback)
+                return
+            self.queues[key] = deque([callback])
+        self.executor.submit(self._run, key)
+
+    def submit_unordered(self, callback: Callable[[], None]):
+        """
+        Runs a callback without ordering it after any other.
+        """
+        self.submit(object(), callback)
+
+    def _run(self, key: Hashable):
+        while True:
+            with self.lock:
+                callback = self.queues[key][0]
+            try:
+                callback()
+            except Exception as e:
+                logger.error(f"Listener callback failed: {e}")
+                with self.lock:
+                    self.failed += 1
+            with self.lock:
+                queue = self.queues[key]
+                queue.popleft()
+                self.pending -= 1
+                self.completed += 1
+                self.not_full.notify()
+                if not queue:
+                    del self.queues[key]
+                    return
+
+    def metrics(self) -> Dict[str, Any]:
+        with self.lock:
+            return {
+                "submitted": self.submitted,
+                "completed": self.completed,
+                "failed": self.failed,
+                "pending": self.pending,
+                "pending_high_water": self.pending_high_water,
+                "blocked": self.blocked,
+                "blocked_s": self.blocked_s,
+            }
@@ -0,0 +1,167 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+import logging
+import mmap
+import os
+import struct
+import tempfile
+from threading import Lock
+from typing import Optional, Union
+
+from uprotocol.proto.upayload_pb2 import UPayload
+
+from up_client_socket.python.clock import REAL_CLOCK
+
+try:
+    import fcntl
+except ImportError:  # Shared memory payloads need a POSIX host
+    fcntl = None
+
+logger = logging.getLogger(__name__)
+# Segments live in tmpfs on Linux, so writing and mapping them never touches a disk
+SHM_DIR: str = (
+    "/dev/shm/uprotocol-tck" if os.path.isdir("/dev/shm") else os.path.join(tempfile.gettempdir(), "uprotocol-tck")
+)
+# Payloads of at least this many bytes are sent by reference when a transport enables shared memory
+SHM_PAYLOAD_THRESHOLD: int = 64 * 1024
+# How long the sender keeps its reference, receivers have this long to acquire their own
+SHM_RETENTION_S: float = 10.0
+# magic, refcount, payload length
+SEGMENT_HEADER = struct.Struct(">4sIQ")
+SEGMENT_MAGIC: bytes = b"UPSH"
+
+
+def segment_path(handle: int) -> str:
+    return os.path.join(SHM_DIR, f"{handle:016x}.payload")
+
+
+class SharedPayload:
+    """A read-only mapping of a payload in shared memory, holding one reference until released"""
+
+    def __init__(self, store: "SharedMemoryPayloadStore", handle: int, mapping: mmap.mmap, length: int):
+        self.store = store
+        self.handle = handle
+        self.mapping = mapping
+        self.view = memoryview(mapping)[SEGMENT_HEADER.size : SEGMENT_HEADER.size + length]
+
+    def release(self):
+        if self.mapping is None:
+            return
+        self.view.release()
+        self.mapping.close()
+        self.mapping = None
+        self.store.release(self.handle)
+
+
+class SharedMemoryPayloadStore:
+    """
+    Stores large payloads in shared memory segments that any transport on the host can map.
+    A segment is named after its handle, (pid << 32) | sequence number, which travels in UPayload.reference.
+    Its refcount sits in the segment header and is only changed under an fcntl record lock,
+    the lock Java's FileChannel uses too; the segment is unlinked when the count drops to zero.
+    """
+
+    def __init__(self):
+        if fcntl is None:
+            raise OSError("Shared memory payloads are not supported on this platform")
+        os.makedirs(SHM_DIR, exist_ok=True)
+        self.lock = Lock()
+        self.sequence = 0
+
+    def put(self, data: Union[bytes, memoryview], retention_s: float = SHM_RETENTION_S) -> int:
+        """
+        Writes data into a new segment and returns its handle.
+        The sender's reference is released after retention_s.
+        """
+        with self.lock:
+            self.sequence = (self.sequence + 1) & 0xFFFFFFFF
+            handle = (os.getpid() << 32) | self.sequence
+        fd = os.open(segment_path(handle), os.O_RDWR | os.O_CREAT | os.O_EXCL, 0o644)
+        try:
+            os.write(fd, SEGMENT_HEADER.pack(SEGMENT_MAGIC, 1, len(data)))
+            view = memoryview(data)
+            while view:
+                view = view[os.write(fd, view) :]
+        finally:
+            os.close(fd)
+
+        # The timer thread of the clock releases every payload, rather than one thread per payload
+        REAL_CLOCK.call_later(retention_s, lambda: self.release(handle))
+        return handle
+
+    def acquire(self, handle: int) -> Optional[SharedPayload]:
+        """
+        Maps the segment of handle read-only and takes a reference on it, or returns None if it is gone.
+        """
+        try:
+            fd = os.open(segment_path(handle), os.O_RDWR)
+        except FileNotFoundError:
+            logger.error(f"Shared payload {handle:016x} no longer exists")
+            return None
+        try:
+            length = self._add_reference(fd, 1)
+            if length is None:
+                return None
+            mapping = mmap.mmap(fd, SEGMENT_HEADER.size + length, access=mmap.ACCESS_READ)
+        finally:
+            os.close(fd)
+        return SharedPayload(self, handle, mapping, length)
+
+    def release(self, handle: int):
+        """
+        Drops one reference on the segment of handle and unlinks it once none are left.
+        """
+        try:
+            fd = os.open(segment_path(handle), os.O_RDWR)
+        except FileNotFoundError:
+            return
+        try:
+            self._add_reference(fd, -1, unlink_handle=handle)
+        finally:
+            os.close(fd)
+
+    def _add_reference(self, fd: int, delta: int, unlink_handle: Optional[int] = None) -> Optional[int]:
+        # fcntl record locks do not exclude threads of one process, the store lock does
+        with self.lock:
+            fcntl.lockf(fd, fcntl.LOCK_EX, SEGMENT_HEADER.size)
+            try:
+                magic, refcount, length = SEGMENT_HEADER.unpack(os.pread(fd, SEGMENT_HEADER.size, 0))
+                if magic != SEGMENT_MAGIC or refcount == 0:
+                    return None
+                refcount += delta
+                os.pwrite(fd, SEGMENT_HEADER.pack(magic, refcount, length), 0)
+                if refcount == 0 and unlink_handle is not None:
+                    os.unlink(segment_path(unlink_handle))
+                return length
+            finally:
+                fcntl.lockf(fd, fcntl.LOCK_UN, SEGMENT_HEADER.size)
+
+
+def payload_bytes(store: SharedMemoryPayloadStore, payload: UPayload) -> bytes:
+    """
+    Returns the data of a payload, reading it from shared memory if it is sent by reference.
+    """
+    if payload.WhichOneof("data") != "reference":
+        return payload.value
+    shared_payload = store.acquire(payload.reference)
+    if shared_payload is None:
+        return b""
+    try:
+        return bytes(shared_payload.view)
+    finally:
+        shared_payload.release()
@@ -17,14 +17,17 @@ SPDX-License-Identifier: Apache-2.0
 
 import logging
 import socket
+import struct
 import threading
 import time
 from collections import defaultdict
 from concurrent.futures import Future
 from threading import Lock
+from typing import Any, Dict, List, Optional, Tuple
 
 from uprotocol.proto.uattributes_pb2 import (
     CallOptions,
+    UAttributes,
     UMessageType,
     UPriority,
 )
@@ -37,130 +40,490 @@ from uprotocol.transport.builder.uattributesbuilder import UAttributesBuilder
 from uprotocol.transport.ulistener import UListener
 from uprotocol.transport.utransport import UTransport
 from uprotocol.uri.factory.uresourcebuilder import UResourceBuilder
+from uprotocol.uri.serializer.microuriserializer import MicroUriSerializer
 from uprotocol.uri.validator.urivalidator import UriValidator
 from uprotocol.uuid.serializer.longuuidserializer import LongUuidSerializer
 
+from up_client_socket.python.clock import REAL_CLOCK, Clock
+from up_client_socket.python.listener_dispatch import DISPATCH_WORKERS, OrderedDispatcher
+from up_client_socket.python.shm_payload_store import (
+    SHM_PAYLOAD_THRESHOLD,
+    SHM_RETENTION_S,
+    SharedMemoryPayloadStore,
+    payload_bytes,
+)
+from up_client_socket.python.transport_stats import TransportStats
+
 logger = logging.getLogger(__name__)
 DISPATCHER_ADDR: tuple = ("127.0.0.1", 44444)
-BYTES_MSG_LENGTH: int = 32767
+# UMessages of at least this many bytes are gathered with their header instead of copied into one buffer
+GATHER_MIN_LENGTH: int = 32767
+# Every frame starts with the length of the serialized UMessage, the id of the sending uEntity and a routing header:
+# message type, priority, ttl and the lengths and micro-URI forms of source and sink
+FRAME_HEADER = struct.Struct(">IIBBBBI24s24s")
+MICRO_URI_MAX_LENGTH: int = 24
+# Control frames carry no UMessage, they tell the Dispatcher which UUris the connection listens on
+CONTROL_LISTEN: int = 0x80
+CONTROL_UNLISTEN: int = 0x81
+# Latency-sensitive messages are sent at once even while batching
+BATCH_BYPASS_PRIORITIES = (UPriority.UPRIORITY_CS5, UPriority.UPRIORITY_CS6)
+# Field numbers of UMessage
+UMESSAGE_ATTRIBUTES_FIELD: int = 1
+UMESSAGE_PAYLOAD_FIELD: int = 2
 RESPONSE_URI = UUri(
     entity=UEntity(name="test_agent_py", version_major=1),
     resource=UResourceBuilder.for_rpc_response(),
 )
 
 
-def timeout_counter(response, req_id, timeout):
-    time.sleep(timeout / 1000)
-    if not response.done():
-        response.set_exception(
-            TimeoutError(
-                "Not received response for request "
-                + LongUuidSerializer.instance().serialize(req_id)
-                + " within "
-                + str(timeout / 1000)
-                + " seconds"
-            )
-        )
+def micro_uri(uri: UUri) -> bytes:
+    """
+    Returns the micro-URI form of a UUri for the routing header,
+    or empty bytes if it has none that fits, in which case the Dispatcher cannot route on it.
+    """
+    data = MicroUriSerializer().serialize(uri)
+    return bytes(data) if len(data) <= MICRO_URI_MAX_LENGTH else b""
 
 
-class SocketUTransport(UTransport, RpcClient):
-    def __init__(self):
+def _read_varint(data: memoryview, pos: int) -> Tuple[int, int]:
+    result = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        result |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return result, pos
+        shift += 7
+
+
+def split_umessage(data: bytes) -> Tuple[bytes, memoryview]:
+    """
+    Splits a serialized UMessage into its serialized attributes and payload without decoding either.
+    Occurrences of a field repeated on the wire are concatenated, which protobuf defines as merging them.
+    """
+    view = memoryview(data)
+    fields: Tuple[List[memoryview], List[memoryview]] = ([], [])
+    pos = 0
+    while pos < len(view):
+        tag, pos = _read_varint(view, pos)
+        field_number, wire_type = tag >> 3, tag & 0x7
+        if wire_type == 2:
+            length, pos = _read_varint(view, pos)
+            if field_number in (UMESSAGE_ATTRIBUTES_FIELD, UMESSAGE_PAYLOAD_FIELD):
+                fields[field_number - 1].append(view[pos : pos + length])
+            pos += length
+        elif wire_type == 0:
+            _, pos = _read_varint(view, pos)
+        elif wire_type == 1:
+            pos += 8
+        elif wire_type == 5:
+            pos += 4
+        else:
+            raise ValueError(f"Unsupported wire type {wire_type} in UMessage")
+
+    attributes, payload = fields
+    return b"".join(attributes), payload[0] if len(payload) == 1 else memoryview(b"".join(payload))
+
+
+def build_umessage(
+    attributes: UAttributes, payload_data: memoryview, payload_store: Optional[SharedMemoryPayloadStore]
+) -> UMessage:
+    """
+    Completes a UMessage whose attributes are already decoded, once a consumer for it is known.
+    A payload sent by reference is copied out of shared memory, consumers always get its value.
+    """
+    umsg = UMessage(attributes=attributes)
+    if payload_data:
+        umsg.payload.ParseFromString(bytes(payload_data))
+        if umsg.payload.WhichOneof("data") == "reference":
+            if payload_store is None:
+                logger.error(f"Shared payload {umsg.payload.reference:x} received without shared memory support")
+                umsg.payload.value = b""
+            else:
+                umsg.payload.value = payload_bytes(payload_store, umsg.payload)
+    return umsg
+
+
+class SocketSession:
+    def __init__(self, batch_bytes: int = 0, batch_delay_s: float = 0.0, dispatch_workers: int = DISPATCH_WORKERS):
         """
-        Creates a uEntity with Socket Connection, as well as a map of registered topics.
+        Opens one connection to the Dispatcher that any number of uEntities can share.
+        Incoming UMessages are demultiplexed locally to the listeners of every attached uEntity.
+        Listeners are called off the reader thread, one at a time and in order per topic, topics in parallel.
+
+        :param batch_bytes: Batches sent frames up to this many bytes, see set_batching. 0 sends every frame at once.
+        :param batch_delay_s: The longest a batched frame waits to be sent.
+        :param dispatch_workers: Threads calling listeners and completing RPC futures,
+        0 calls them on the reader thread.
         """
 
         self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.socket.connect(DISPATCHER_ADDR)
 
         self.reqid_to_future = {}
+        # serialized UUri -> [(entity id, listener)]
         self.uri_to_listener = defaultdict(list)
         self.lock = Lock()
+        self.send_lock = Lock()
+        # Frames waiting to be sent in one call, guarded by send_lock
+        self.batch = bytearray()
+        self.batch_deadline: float = 0.0
+        self.batch_ready = threading.Condition(self.send_lock)
+        self.batch_bytes: int = 0
+        self.batch_delay_s: float = 0.0
+        self.batch_flusher: Optional[threading.Thread] = None
+        self.dispatcher: Optional[OrderedDispatcher] = OrderedDispatcher(dispatch_workers) if dispatch_workers else None
+        self.stats = TransportStats()
+        # Resolves the payloads received by reference, whether or not this session sends any
+        try:
+            self.payload_store: Optional[SharedMemoryPayloadStore] = SharedMemoryPayloadStore()
+        except OSError:
+            self.payload_store = None
         thread = threading.Thread(target=self.__listen)
-        thread.start()  # with ThreadPoolExecutor(max_workers=5) as executor:  #     executor.submit(self.__listen)
+        thread.start()
+        self.set_batching(batch_bytes, batch_delay_s)
+
+    def set_batching(self, batch_bytes: int, batch_delay_s: float):
+        """
+        Buffers sent frames and sends them in one call once batch_bytes are pending, batch_delay_s after the first
+        of them was buffered, or on flush(). Frames of priority CS5 and CS6 are never delayed.
+
+        :param batch_bytes: Pending bytes that trigger sending the batch, 0 disables batching.
+        :param batch_delay_s: The longest a batched frame waits to be sent.
+        """
+        with self.send_lock:
+            self._flush_batch()
+            self.batch_bytes = batch_bytes
+            self.batch_delay_s = batch_delay_s
+            if batch_bytes > 0 and self.batch_flusher is None:
+                self.batch_flusher = threading.Thread(target=self.__flush_batches, daemon=True)
+                self.batch_flusher.start()
+
+    def flush(self):
+        """
+        Sends all batched frames now.
+        """
+        with self.send_lock:
+            self._flush_batch()
+
+    def _flush_batch(self):
+        # Called with send_lock held
+        if self.batch:
+            self.socket.sendall(self.batch)
+            self.batch.clear()
+
+    def __flush_batches(self):
+        """
+        Sends every batch whose delay expired before it filled up.
+        """
+        with self.batch_ready:
+            while True:
+                if not self.batch:
+                    self.batch_ready.wait()
+                    continue
+                remaining_s: float = self.batch_deadline - time.monotonic()
+                if remaining_s > 0:
+                    self.batch_ready.wait(remaining_s)
+                    continue
+                try:
+                    self._flush_batch()
+                except OSError as e:
+                    logger.error(f"Error sending batched frames: {e}")
+                    self.batch.clear()
+
+    def send_frame(self, entity_id: int, attributes: UAttributes, umsg_serialized: bytes):
+        """
+        Sends one serialized UMessage on behalf of the given uEntity, with the routing header taken from its attributes.
+        Frames of uEntities sharing the session are never interleaved on the socket.
+        """
+        source: bytes = micro_uri(attributes.source)
+        sink: bytes = micro_uri(attributes.sink) if attributes.HasField("sink") else b""
+        header = FRAME_HEADER.pack(
+            len(umsg_serialized),
+            entity_id,
+            attributes.type,
+            attributes.priority,
+            len(source),
+            len(sink),
+            attributes.ttl,
+            source,
+            sink,
+        )
+        if attributes.type == UMessageType.UMESSAGE_TYPE_PUBLISH:
+            self.stats.record_sent(source, attributes.source, len(umsg_serialized))
+        else:
+            self.stats.record_sent(sink, attributes.sink, len(umsg_serialized))
+        with self.send_lock:
+            if (
+                self.batch_bytes > 0
+                and attributes.priority not in BATCH_BYPASS_PRIORITIES
+                and len(header) + len(umsg_serialized) < self.batch_bytes
+            ):
+                if not self.batch:
+                    self.batch_deadline = time.monotonic() + self.batch_delay_s
+                    self.batch_ready.notify()
+                self.batch += header
+                self.batch += umsg_serialized
+                if len(self.batch) >= self.batch_bytes:
+                    self._flush_batch()
+                return
+            # Frames sent at once must not overtake batched ones
+            self._flush_batch()
+            if len(umsg_serialized) < GATHER_MIN_LENGTH or not hasattr(self.socket, "sendmsg"):
+                self.socket.sendall(header + umsg_serialized)
+                return
+            # Gather the header and a large payload instead of copying both into one buffer
+            sent = self.socket.sendmsg([header, umsg_serialized])
+            if sent < len(header):
+                self.socket.sendall(header[sent:])
+                sent = len(header)
+            self.socket.sendall(memoryview(umsg_serialized)[sent - len(header) :])
+
+    def send_control(self, entity_id: int, control_type: int, topic: UUri):
+        """
+        Tells the Dispatcher to add or remove the given UUri as a route to this connection.
+        """
+        route: bytes = micro_uri(topic)
+        header = FRAME_HEADER.pack(0, entity_id, control_type, 0, 0, len(route), 0, b"", route)
+        with self.send_lock:
+            self._flush_batch()
+            self.socket.sendall(header)
+
+    def dispatch_metrics(self) -> Dict[str, Any]:
+        """
+        Returns the counters of the listener dispatch stage, empty if listeners are called on the reader thread.
+        """
+        return self.dispatcher.metrics() if self.dispatcher is not None else {}
+
+    def get_stats(self) -> Dict[str, Any]:
+        """
+        Returns what the session has done so far, see TransportStats, together with the requests still waiting for
+        their response and the depths of the send batch and the listener dispatch queue.
+        """
+        stats: Dict[str, Any] = self.stats.snapshot()
+        with self.lock:
+            stats["pending_rpc"] = len(self.reqid_to_future)
+        with self.send_lock:
+            batch_bytes: int = len(self.batch)
+        dispatch: Dict[str, Any] = self.dispatch_metrics()
+        stats["queue_depths"] = {
+            "send_batch_bytes": batch_bytes,
+            "listener_dispatch_pending": dispatch.get("pending", 0),
+            "listener_dispatch_pending_high_water": dispatch.get("pending_high_water", 0),
+        }
+        return stats
+
+    def add_listener(self, topic: UUri, entity_id: int, listener: UListener):
+        with self.lock:
+            self.uri_to_listener[topic.SerializeToString()].append((entity_id, listener))
+        self.send_control(entity_id, CONTROL_LISTEN, topic)
+
+    def remove_listener(self, topic: UUri, entity_id: int, listener: UListener) -> bool:
+        uri: bytes = topic.SerializeToString()
+        with self.lock:
+            listeners = self.uri_to_listener.get(uri, [])
+            if (entity_id, listener) not in listeners:
+                return False
+            listeners.remove((entity_id, listener))
+            if not listeners:
+                del self.uri_to_listener[uri]
+        self.send_control(entity_id, CONTROL_UNLISTEN, topic)
+        return True
+
+    def add_response_future(self, request_id: bytes, response: Future):
+        with self.lock:
+            self.reqid_to_future[request_id] = response
+
+    def remove_response_future(self, request_id: bytes, response: Future) -> bool:
+        """
+        Stops waiting for the response to a request.
+
+        :return: Whether the response was still pending, False once it has been received.
+        """
+        with self.lock:
+            if self.reqid_to_future.get(request_id) is not response:
+                return False
+            del self.reqid_to_future[request_id]
+            return True
+
+    def _recv_exact(self, length: int) -> Optional[bytearray]:
+        """
+        Reads exactly length bytes from the Dispatcher, or returns None once the connection is closed.
+        The data is received in place, so a large UMessage is not reassembled from chunks.
+        """
+        data = bytearray(length)
+        view = memoryview(data)
+        received = 0
+        while received < length:
+            chunk_length = self.socket.recv_into(view[received:])
+            if chunk_length == 0:
+                return None
+            received += chunk_length
+        return data
 
     def __listen(self):
         """
         Listens to UMessages incoming from the Dispatcher.
-        Handles incoming data if the Socket_UTransporter is registered to a UUri topic.
+        Handles incoming data if an attached uEntity is registered to a UUri topic.
         """
         while True:
             try:
-                recv_data = self.socket.recv(BYTES_MSG_LENGTH)
-
-                if not recv_data or recv_data == b"":
+                header = self._recv_exact(FRAME_HEADER.size)
+                if header is None:
+                    self.socket.close()
+                    return
+                header_fields = FRAME_HEADER.unpack(header)
+                umsg_length, sender_entity_id = header_fields[:2]
+                source_length, sink_length, _, source, sink = header_fields[4:]
+                recv_data = self._recv_exact(umsg_length)
+                if recv_data is None:
                     self.socket.close()
                     return
-                umsg = UMessage()
-                umsg.ParseFromString(recv_data)
+                # Only the attributes are needed to find a consumer, the payload is decoded once one exists
+                attributes_data, payload_data = split_umessage(recv_data)
+                attributes = UAttributes()
+                attributes.ParseFromString(attributes_data)
 
-                logger.info(f"{self.__class__.__name__} Received uMessage")
+                logger.info(f"{self.__class__.__name__} Received uMessage from entity {sender_entity_id}")
+                if attributes.type == UMessageType.UMESSAGE_TYPE_PUBLISH:
+                    self.stats.record_received(source[:source_length], attributes.source, umsg_length)
+                else:
+                    self.stats.record_received(sink[:sink_length], attributes.sink, umsg_length)
 
-                attributes = umsg.attributes
                 if attributes.type == UMessageType.UMESSAGE_TYPE_PUBLISH:
-                    self._handle_publish_message(umsg)
+                    self._handle_publish_message(attributes, payload_data)
                 elif attributes.type == UMessageType.UMESSAGE_TYPE_REQUEST:
-                    self._handle_request_message(umsg)
+                    self._handle_request_message(attributes, payload_data)
                 elif attributes.type == UMessageType.UMESSAGE_TYPE_RESPONSE:
-                    self._handle_response_message(umsg)
+                    self._handle_response_message(attributes, payload_data)
 
             except socket.error as e:
                 logger.error(f"Socket error: {e}")
                 self.socket.close()
                 break
             except Exception as e:
+                self.stats.record_parse_error()
                 logger.error(f"Unexpected error: {e}")
 
-    def _handle_publish_message(self, umsg):
+    def _handle_publish_message(self, attributes: UAttributes, payload_data: memoryview):
         """
         Handles incoming publish messages.
         """
-        uri = umsg.attributes.source.SerializeToString()
-        self._notify_listeners(uri, umsg)
+        uri = attributes.source.SerializeToString()
+        self._notify_listeners(uri, attributes, payload_data)
 
-    def _handle_request_message(self, umsg):
+    def _handle_request_message(self, attributes: UAttributes, payload_data: memoryview):
         """
         Handles incoming request messages.
         """
 
-        uri = umsg.attributes.sink.SerializeToString()
-        self._notify_listeners(uri, umsg)
+        uri = attributes.sink.SerializeToString()
+        self._notify_listeners(uri, attributes, payload_data)
 
-    def _notify_listeners(self, uri, umsg):
+    def _notify_listeners(self, uri, attributes: UAttributes, payload_data: memoryview):
         """
         Notifies listeners subscribed to the given URI about the incoming message.
         """
         with self.lock:
-            listeners = self.uri_to_listener.get(uri, [])
-            if listeners:
-                logger.info(f"{self.__class__.__name__} Handle Uri")
-                for listener in listeners:
-                    listener.on_receive(umsg)
+            listeners = list(self.uri_to_listener.get(uri, []))
+        if listeners:
+            logger.info(f"{self.__class__.__name__} Handle Uri")
+            if self.dispatcher is not None:
+                self.dispatcher.submit(uri, lambda: self._deliver(listeners, attributes, payload_data))
             else:
-                logger.info(f"{self.__class__.__name__} Uri not found in Listener Map, discarding...")
+                self._deliver(listeners, attributes, payload_data)
+        else:
+            logger.info(f"{self.__class__.__name__} Uri not found in Listener Map, discarding...")
 
-    def _handle_response_message(self, umsg):
+    def _deliver(self, listeners: List[Tuple[int, UListener]], attributes: UAttributes, payload_data: memoryview):
+        self.stats.record_listener_invocations(len(listeners))
+        umsg = build_umessage(attributes, payload_data, self.payload_store)
+        for _, listener in listeners:
+            listener.on_receive(umsg)
+
+    def _handle_response_message(self, attributes: UAttributes, payload_data: memoryview):
         """
         Handles incoming response messages.
         """
-        request_id = umsg.attributes.reqid.SerializeToString()
+        request_id = attributes.reqid.SerializeToString()
         with self.lock:
             response_future = self.reqid_to_future.pop(request_id, None)
-            if response_future:
-                response_future.set_result(umsg)
+        if response_future:
+            # The done callbacks of the future run where its result is set
+            if self.dispatcher is not None:
+                self.dispatcher.submit_unordered(
+                    lambda: response_future.set_result(build_umessage(attributes, payload_data, self.payload_store))
+                )
+            else:
+                response_future.set_result(build_umessage(attributes, payload_data, self.payload_store))
+
+
+class SocketUTransport(UTransport, RpcClient):
+    def __init__(
+        self,
+        session: Optional[SocketSession] = None,
+        entity_id: int = 0,
+        payload_store: Optional[SharedMemoryPayloadStore] = None,
+        clock: Optional[Clock] = None,
+    ):
+        """
+        Creates a uEntity with Socket Connection, as well as a map of registered topics.
+
+        :param session: An existing Dispatcher connection to multiplex this uEntity onto.
+        A new connection is opened when omitted.
+        :param entity_id: Identifies this uEntity in the frames it sends over a shared session.
+        :param payload_store: Sends payloads of at least SHM_PAYLOAD_THRESHOLD bytes by reference through this store.
+        :param clock: Times out RPC requests, the real clock when omitted.
+        """
+
+        self.session = session if session is not None else SocketSession()
+        self.entity_id = entity_id
+        self.payload_store = payload_store
+        self.clock = clock if clock is not None else REAL_CLOCK
+        self.response_uri = RESPONSE_URI
+        if entity_id:
+            self.response_uri = UUri(
+                entity=UEntity(name=RESPONSE_URI.entity.name, id=entity_id, version_major=1),
+                resource=UResourceBuilder.for_rpc_response(),
+            )
 
     def send(self, message: UMessage) -> UStatus:
         """
         Sends the provided UMessage over the socket connection.
         """
-        umsg_serialized: bytes = message.SerializeToString()
         try:
-            self.socket.sendall(umsg_serialized)
+            # Putting the payload into shared memory fails like a socket, e.g. on a full /dev/shm
+            if self.payload_store is not None and len(message.payload.value) >= SHM_PAYLOAD_THRESHOLD:
+                message = self._with_payload_reference(message)
+            umsg_serialized: bytes = message.SerializeToString()
+            self.session.send_frame(self.entity_id, message.attributes, umsg_serialized)
             logger.info("uMessage Sent to dispatcher from python socket transport")
         except OSError as e:
             logger.exception(f"INTERNAL ERROR: {e}")
             return UStatus(code=UCode.INTERNAL, message=f"INTERNAL ERROR: {e}")
         return UStatus(code=UCode.OK, message="OK")
 
+    def flush(self) -> UStatus:
+        """
+        Sends the messages batched by the session now.
+        """
+        try:
+            self.session.flush()
+        except OSError as e:
+            logger.exception(f"INTERNAL ERROR: {e}")
+            return UStatus(code=UCode.INTERNAL, message=f"INTERNAL ERROR: {e}")
+        return UStatus(code=UCode.OK, message="OK")
+
+    def _with_payload_reference(self, message: UMessage) -> UMessage:
+        """
+        Moves the payload into shared memory, the returned UMessage only carries its reference and length.
+        """
+        retention_s: float = message.attributes.ttl / 1000 if message.attributes.ttl > 0 else SHM_RETENTION_S
+        handle: int = self.payload_store.put(message.payload.value, retention_s)
+        payload = UPayload(reference=handle, length=len(message.payload.value), format=message.payload.format)
+        return UMessage(attributes=message.attributes, payload=payload)
+
     def register_listener(self, topic: UUri, listener: UListener) -> UStatus:
         """
         Registers a listener for the specified topic/method URI.
@@ -169,8 +532,7 @@ class SocketUTransport(UTransport, RpcClient):
         status = UriValidator.validate(topic)
         if status.is_failure():
             return status.to_status()
-        uri: bytes = topic.SerializeToString()
-        self.uri_to_listener[uri].append(listener)
+        self.session.add_listener(topic, self.entity_id, listener)
         return UStatus(code=UCode.OK, message="OK")
 
     def unregister_listener(self, topic: UUri, listener: UListener) -> UStatus:
@@ -181,14 +543,7 @@ class SocketUTransport(UTransport, RpcClient):
         status = UriValidator.validate(topic)
         if status.is_failure():
             return status.to_status()
-        uri: bytes = topic.SerializeToString()
-
-        listeners = self.uri_to_listener.get(uri, [])
-
-        if listener in listeners:
-            listeners.remove(listener)
-            if not listeners:
-                del self.uri_to_listener[uri]
+        if self.session.remove_listener(topic, self.entity_id, listener):
             return UStatus(code=UCode.OK, message="OK")
 
         return UStatus(
@@ -200,17 +555,36 @@ class SocketUTransport(UTransport, RpcClient):
         """
         Invokes a method with the provided URI, request payload, and options.
         """
-        attributes = UAttributesBuilder.request(RESPONSE_URI, method_uri, UPriority.UPRIORITY_CS4, options.ttl).build()
+        attributes = UAttributesBuilder.request(
+            self.response_uri, method_uri, UPriority.UPRIORITY_CS4, options.ttl
+        ).build()
         # Get uAttributes's request id
         request_id = attributes.id
 
         response = Future()
-        self.reqid_to_future[request_id.SerializeToString()] = response
-        # Start a thread to count the timeout
-        timeout_thread = threading.Thread(target=timeout_counter, args=(response, request_id, options.ttl))
-        timeout_thread.start()
+        self.session.add_response_future(request_id.SerializeToString(), response)
+        timeout = self.clock.call_later(
+            options.ttl / 1000, lambda: self._expire_request(response, request_id, options.ttl)
+        )
+        response.add_done_callback(lambda _: timeout.cancel())
 
         umsg = UMessage(payload=request_payload, attributes=attributes)
         self.send(umsg)
 
         return response
+
+    def _expire_request(self, response: Future, request_id, timeout_ms: int):
+        """
+        Fails the response future if no response has been received within the timeout.
+        """
+        if self.session.remove_response_future(request_id.SerializeToString(), response):
+            self.session.stats.record_rpc_timeout()
+            response.set_exception(
+                TimeoutError(
+                    "Not received response for request "
+                    + LongUuidSerializer.instance().serialize(request_id)
+                    + " within "
+                    + str(timeout_ms / 1000)
+                    + " seconds"
+                )
+            )
@@ -0,0 +1,100 @@
+"""
+SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+See the NOTICE file(s) distributed with this work for additional
+information regarding copyright ownership.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+SPDX-FileType: SOURCE
+SPDX-License-Identifier: Apache-2.0
+"""
+
+from threading import Lock
+from typing import Any, Dict, List
+
+from uprotocol.proto.uri_pb2 import UUri
+
+
+class TopicCounters:
+    def __init__(self):
+        """Messages and bytes per topic, keyed by the routing form of the topic so that counting stays cheap"""
+        # key -> [topic, messages, bytes]
+        self.topics: Dict[bytes, List[Any]] = {}
+        self.messages: int = 0
+        self.bytes: int = 0
+
+    def add(self, key: bytes, topic: UUri, length: int):
+        if not key:
+            # Topics without a micro-URI form are told apart by their serialized form
+            key = topic.SerializeToString()
+        counters = self.topics.get(key)
+        if counters is None:
+            # A copy, so that the message the topic belongs to is not kept alive
+            counters = self.topics[key] = [UUri(), 0, 0]
+            counters[0].CopyFrom(topic)
+        counters[1] += 1
+        counters[2] += length
+        self.messages += 1
+        self.bytes += length
+
+    def snapshot(self) -> Dict[str, Any]:
+        # Only imported when asked for, the counters are updated for every message
+        from uprotocol.uri.serializer.longuriserializer import LongUriSerializer
+
+        topics: Dict[str, Dict[str, int]] = {}
+        for topic, messages, length in self.topics.values():
+            name: str = LongUriSerializer().serialize(topic) or str(topic.entity.id)
+            counters = topics.setdefault(name, {"messages": 0, "bytes": 0})
+            counters["messages"] += messages
+            counters["bytes"] += length
+        return {"messages": self.messages, "bytes": self.bytes, "topics": topics}
+
+
+class TransportStats:
+    def __init__(self):
+        """
+        Counts what a session has done: messages and bytes sent and received per topic, received frames that could not
+        be parsed, listener invocations and requests that timed out.
+        """
+        self.lock = Lock()
+        self.sent = TopicCounters()
+        self.received = TopicCounters()
+        self.parse_errors: int = 0
+        self.listener_invocations: int = 0
+        self.rpc_timeouts: int = 0
+
+    def record_sent(self, key: bytes, topic: UUri, length: int):
+        with self.lock:
+            self.sent.add(key, topic, length)
+
+    def record_received(self, key: bytes, topic: UUri, length: int):
+        with self.lock:
+            self.received.add(key, topic, length)
+
+    def record_parse_error(self):
+        with self.lock:
+            self.parse_errors += 1
+
+    def record_listener_invocations(self, count: int):
+        with self.lock:
+            self.listener_invocations += count
+
+    def record_rpc_timeout(self):
+        with self.lock:
+            self.rpc_timeouts += 1
+
+    def snapshot(self) -> Dict[str, Any]:
+        with self.lock:
+            return {
+                "sent": self.sent.snapshot(),
+                "received": self.received.snapshot(),
+                "parse_errors": self.parse_errors,
+                "listener_invocations": self.listener_invocations,
+                "rpc_timeouts": self.rpc_timeouts,
+            }
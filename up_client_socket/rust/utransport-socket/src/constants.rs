@@ -22,5 +22,15 @@
 // Define constants for addresses
 pub const DISPATCHER_ADDR: (&str, u16) = ("127.0.0.1", 44444);
 
-// Define constant for maximum message length
-pub const BYTES_MSG_LENGTH: usize = 32_767;
+// Every frame starts with the length of the serialized UMessage and the id of the sending uEntity,
+// both as big-endian u32, followed by a routing header: message type (u8), priority (u8), lengths of
+// the micro-URI forms of source and sink (u8 each), ttl (big-endian u32) and both micro-URIs,
+// zero-padded to MICRO_URI_MAX_LENGTH bytes
+pub const FRAME_HEADER_LENGTH: usize = 64;
+pub const MICRO_URI_MAX_LENGTH: usize = 24;
+pub const SOURCE_OFFSET: usize = 16;
+pub const SINK_OFFSET: usize = SOURCE_OFFSET + MICRO_URI_MAX_LENGTH;
+
+// Control frames carry no UMessage, they tell the Dispatcher which UUris the connection listens on
+pub const CONTROL_LISTEN: u8 = 0x80;
+pub const CONTROL_UNLISTEN: u8 = 0x81;
@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//! Optional micro-batching of the frames written to the Dispatcher.
+//!
+//! While batching, frames are buffered until `batch_bytes` are pending, the delay of the oldest
+//! buffered frame expires or the batch is flushed, and are then written with one `write_all`.
+//! Urgent frames and frames that do not fit into a batch are written at once, after the batch.
+
+use std::io::{self, Write};
+use std::net::TcpStream;
+use std::time::Duration;
+
+pub struct FrameWriter {
+    stream: TcpStream,
+    batch: Vec<u8>,
+    batch_bytes: usize,
+    batch_delay: Duration,
+    flush_scheduled: bool,
+}
+
+impl FrameWriter {
+    pub fn new(stream: TcpStream) -> Self {
+        FrameWriter {
+            stream,
+            batch: Vec::new(),
+            batch_bytes: 0,
+            batch_delay: Duration::ZERO,
+            flush_scheduled: false,
+        }
+    }
+
+    /// Batches frames up to `batch_bytes`, delaying none of them longer than `batch_delay`.
+    /// A `batch_bytes` of 0 writes every frame at once.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the pending batch cannot be written
+    pub fn set_batching(&mut self, batch_bytes: usize, batch_delay: Duration) -> io::Result<()> {
+        self.flush()?;
+        self.batch_bytes = batch_bytes;
+        self.batch_delay = batch_delay;
+        Ok(())
+    }
+
+    /// Writes `frame`, or adds it to the batch unless it is `urgent`.
+    ///
+    /// Returns the delay after which [`FrameWriter::flush_delayed`] has to be called, when the frame
+    /// started a batch.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if writing to the Dispatcher fails
+    pub fn write_frame(&mut self, frame: &[u8], urgent: bool) -> io::Result<Option<Duration>> {
+        if self.batch_bytes == 0 || urgent || frame.len() >= self.batch_bytes {
+            // Frames written at once must not overtake batched ones
+            self.flush()?;
+            self.stream.write_all(frame)?;
+            return Ok(None);
+        }
+
+        self.batch.extend_from_slice(frame);
+        if self.batch.len() >= self.batch_bytes {
+            self.flush()?;
+        } else if !self.flush_scheduled {
+            self.flush_scheduled = true;
+            return Ok(Some(self.batch_delay));
+        }
+        Ok(None)
+    }
+
+    /// Returns the bytes of the frames batched and not yet written
+    pub fn batched_bytes(&self) -> usize {
+        self.batch.len()
+    }
+
+    /// Writes all batched frames.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if writing to the Dispatcher fails
+    pub fn flush(&mut self) -> io::Result<()> {
+        if self.batch.is_empty() {
+            return Ok(());
+        }
+        let result = self.stream.write_all(&self.batch);
+        self.batch.clear();
+        result
+    }
+
+    /// Flushes a batch whose delay expired, a batch started after it schedules the next flush.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if writing to the Dispatcher fails
+    pub fn flush_delayed(&mut self) -> io::Result<()> {
+        self.flush_scheduled = false;
+        self.flush()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::FrameWriter;
+    use std::io::Read;
+    use std::net::{TcpListener, TcpStream};
+    use std::time::Duration;
+
+    fn pending_bytes(reader: &mut TcpStream) -> usize {
+        let mut buffer = [0; 4096];
+        reader.read(&mut buffer).unwrap_or(0)
+    }
+
+    #[test]
+    fn test_batching() {
+        let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+        let mut writer =
+            FrameWriter::new(TcpStream::connect(listener.local_addr().unwrap()).unwrap());
+        let (mut reader, _) = listener.accept().unwrap();
+        reader
+            .set_read_timeout(Some(Duration::from_millis(50)))
+            .unwrap();
+
+        writer.set_batching(100, Duration::from_millis(5)).unwrap();
+        assert_eq!(
+            writer.write_frame(&[1; 40], false).unwrap(),
+            Some(Duration::from_millis(5))
+        );
+        assert_eq!(writer.write_frame(&[2; 40], false).unwrap(), None);
+        assert_eq!(pending_bytes(&mut reader), 0);
+
+        // An urgent frame flushes the batch before it
+        writer.write_frame(&[3; 10], true).unwrap();
+        assert_eq!(pending_bytes(&mut reader), 90);
+
+        writer.write_frame(&[4; 60], false).unwrap();
+        writer.write_frame(&[5; 60], false).unwrap();
+        assert_eq!(pending_bytes(&mut reader), 120);
+        writer.flush_delayed().unwrap();
+        assert_eq!(
+            writer.write_frame(&[6; 10], false).unwrap(),
+            Some(Duration::from_millis(5))
+        );
+    }
+}
@@ -20,21 +20,37 @@
  */
 
 mod constants;
+mod frame_writer;
+pub mod shm_payload;
+pub mod transport_stats;
+pub mod umessage_wire;
 
 use async_trait::async_trait;
 
-use up_rust::UListener;
+use up_rust::{Data, UListener};
+use up_rust::{MicroUriSerializer, UriSerializer};
+use up_rust::{
+    UAttributes, UCode, UMessage, UMessageType, UPayload, UPriority, UStatus, UTransport, UUri,
+};
 use up_rust::{UAttributesValidators, UriValidator};
-use up_rust::{UCode, UMessage, UMessageType, UStatus, UTransport, UUri};
 
-use crate::constants::BYTES_MSG_LENGTH;
 use crate::constants::DISPATCHER_ADDR;
+use crate::constants::{
+    CONTROL_LISTEN, CONTROL_UNLISTEN, FRAME_HEADER_LENGTH, MICRO_URI_MAX_LENGTH, SINK_OFFSET,
+    SOURCE_OFFSET,
+};
+use crate::frame_writer::FrameWriter;
+use crate::shm_payload::{SharedPayloadStore, SHM_PAYLOAD_THRESHOLD, SHM_RETENTION};
+use crate::transport_stats::TransportStats;
+use crate::umessage_wire::split_umessage;
 use log::{debug, error};
-use protobuf::Message;
+use protobuf::{Message, MessageField};
 use std::collections::hash_map::Entry;
 use std::collections::HashSet;
-use std::io::{Read, Write};
+use std::io::Read;
 use std::net::TcpStream;
+use std::thread;
+use std::time::Duration;
 use std::{
     collections::HashMap,
     sync::{Arc, Mutex},
@@ -42,19 +58,45 @@ use std::{
 use tokio::task;
 use up_rust::ComparableListener;
 
+fn dispatcher_error(err: &std::io::Error) -> UStatus {
+    UStatus::fail_with_code(
+        UCode::UNAVAILABLE,
+        format!("Dispatcher communication issue: {err:?}"),
+    )
+}
+
+/// A uTransport over one connection to the Dispatcher.
+///
+/// Several uEntities of a process can share that connection: [`UTransportSocket::attach_entity`]
+/// returns a transport for another uEntity which sends its frames over the same socket, while
+/// incoming messages are demultiplexed locally to the listeners of every attached uEntity.
 pub struct UTransportSocket {
     socket_sync: TcpStream,
+    writer: Arc<Mutex<FrameWriter>>,
     listener_map: Arc<Mutex<HashMap<UUri, HashSet<ComparableListener>>>>,
+    entity_id: u32,
+    payload_store: Option<Arc<SharedPayloadStore>>,
+    stats: Arc<TransportStats>,
 }
 
 impl UTransportSocket {
     pub fn new() -> Result<Self, UStatus> {
+        Self::new_for_entity(0)
+    }
+
+    /// Connects to the Dispatcher on behalf of the uEntity identified by `entity_id` in every frame it sends.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the Dispatcher cannot be reached
+    pub fn new_for_entity(entity_id: u32) -> Result<Self, UStatus> {
         let socket_sync = TcpStream::connect(DISPATCHER_ADDR).map_err(|e| {
             error!("Error connecting sync socket: {:?}", e);
             UStatus::fail_with_code(UCode::INTERNAL, "Issue in connecting sync socket")
         })?;
 
         let listener_map = Arc::new(Mutex::new(HashMap::new()));
+        let stats = Arc::new(TransportStats::default());
 
         let socket_clone = match socket_sync.try_clone() {
             Ok(socket) => socket,
@@ -66,9 +108,19 @@ impl UTransportSocket {
                 ));
             }
         };
+        let writer = Arc::new(Mutex::new(FrameWriter::new(
+            socket_clone.try_clone().map_err(|err| {
+                error!("Issue in cloning sync socket: {}", err);
+                UStatus::fail_with_code(UCode::INTERNAL, "Issue in cloning socket_sync")
+            })?,
+        )));
         let mut transport_socket = UTransportSocket {
             socket_sync: socket_clone,
+            writer: writer.clone(),
             listener_map: listener_map.clone(),
+            entity_id,
+            payload_store: None,
+            stats: stats.clone(),
         };
         if let Err(err) = transport_socket.socket_init() {
             let err_string = format!("Socket transport initialization failed: {err}");
@@ -79,10 +131,236 @@ impl UTransportSocket {
 
         Ok(UTransportSocket {
             socket_sync,
+            writer,
             listener_map,
+            entity_id,
+            payload_store: None,
+            stats,
+        })
+    }
+
+    /// Sends payloads of at least [`SHM_PAYLOAD_THRESHOLD`] bytes by reference through `payload_store`
+    #[must_use]
+    pub fn with_payload_store(mut self, payload_store: Arc<SharedPayloadStore>) -> Self {
+        self.payload_store = Some(payload_store);
+        self
+    }
+
+    /// Batches the frames sent over this transport's Dispatcher connection, by every uEntity sharing it,
+    /// until `batch_bytes` are pending or the oldest of them waited for `batch_delay`.
+    /// Messages of priority CS5 and CS6 are never delayed. A `batch_bytes` of 0 disables batching.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the pending batch cannot be sent
+    pub fn set_batching(&self, batch_bytes: usize, batch_delay: Duration) -> Result<(), UStatus> {
+        self.lock_writer()?
+            .set_batching(batch_bytes, batch_delay)
+            .map_err(|err| dispatcher_error(&err))
+    }
+
+    /// Sends all batched frames now.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the batch cannot be sent
+    pub fn flush(&self) -> Result<(), UStatus> {
+        self.lock_writer()?
+            .flush()
+            .map_err(|err| dispatcher_error(&err))
+    }
+
+    /// Returns the counters of this transport's Dispatcher connection, shared by every uEntity attached to it
+    #[must_use]
+    pub fn stats(&self) -> Arc<TransportStats> {
+        self.stats.clone()
+    }
+
+    /// Returns a transport for another uEntity which shares this transport's Dispatcher connection.
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the socket cannot be cloned
+    pub fn attach_entity(&self, entity_id: u32) -> Result<Self, UStatus> {
+        let socket_sync = self.socket_sync.try_clone().map_err(|err| {
+            error!("Issue in cloning sync socket: {}", err);
+            UStatus::fail_with_code(UCode::INTERNAL, "Issue in cloning socket_sync")
+        })?;
+
+        Ok(UTransportSocket {
+            socket_sync,
+            writer: self.writer.clone(),
+            listener_map: self.listener_map.clone(),
+            entity_id,
+            payload_store: self.payload_store.clone(),
+            stats: self.stats.clone(),
         })
     }
 
+    /// Moves a large payload into shared memory, leaving only its reference and length in the message
+    fn with_payload_reference(&self, mut message: UMessage) -> Result<UMessage, UStatus> {
+        let Some(payload_store) = &self.payload_store else {
+            return Ok(message);
+        };
+        let retention = message
+            .attributes
+            .ttl
+            .filter(|ttl| *ttl > 0)
+            .map_or(SHM_RETENTION, |ttl| Duration::from_millis(u64::from(ttl)));
+        let Some(payload) = message.payload.as_mut() else {
+            return Ok(message);
+        };
+        let handle = match &payload.data {
+            Some(Data::Value(value)) if value.len() >= SHM_PAYLOAD_THRESHOLD => {
+                payload.length = Some(i32::try_from(value.len()).unwrap_or(i32::MAX));
+                payload_store.put(value)?
+            }
+            _ => return Ok(message),
+        };
+        payload.data = Some(Data::Reference(handle));
+
+        // Receivers take their own references within the retention time
+        let payload_store = payload_store.clone();
+        task::spawn(async move {
+            tokio::time::sleep(retention).await;
+            if let Err(err) = payload_store.release(handle) {
+                error!("Error releasing shared payload {handle:016x}: {err:?}");
+            }
+        });
+        Ok(message)
+    }
+
+    /// Copies a payload received by reference out of shared memory, so that listeners always get its
+    /// value; the reference taken for the copy is released right after it
+    fn resolve_payload_reference(&self, payload: &mut UPayload) {
+        let Some(Data::Reference(handle)) = payload.data else {
+            return;
+        };
+        let value = match &self.payload_store {
+            Some(payload_store) => match payload_store.acquire(handle) {
+                Ok(shared_payload) => shared_payload.data().to_vec(),
+                Err(err) => {
+                    error!("Shared payload {handle:016x} is not available: {err:?}");
+                    Vec::new()
+                }
+            },
+            None => {
+                error!("Shared payload {handle:016x} received without shared memory support");
+                Vec::new()
+            }
+        };
+        payload.data = Some(Data::Value(value));
+    }
+
+    /// Returns the micro-URI form of `uri` for the routing header, or nothing if it has none that fits,
+    /// in which case the Dispatcher cannot route on it
+    fn micro_uri(uri: Option<&UUri>) -> Vec<u8> {
+        uri.and_then(|uri| MicroUriSerializer::serialize(uri).ok())
+            .filter(|micro_uri| micro_uri.len() <= MICRO_URI_MAX_LENGTH)
+            .unwrap_or_default()
+    }
+
+    fn frame_header(
+        &self,
+        umsg_length: u32,
+        message_type: u8,
+        priority: u8,
+        ttl: u32,
+        source: &[u8],
+        sink: &[u8],
+    ) -> [u8; FRAME_HEADER_LENGTH] {
+        let mut header = [0; FRAME_HEADER_LENGTH];
+        header[0..4].copy_from_slice(&umsg_length.to_be_bytes());
+        header[4..8].copy_from_slice(&self.entity_id.to_be_bytes());
+        // Both micro-URIs are at most MICRO_URI_MAX_LENGTH bytes long
+        header[8..12].copy_from_slice(&[
+            message_type,
+            priority,
+            source.len() as u8,
+            sink.len() as u8,
+        ]);
+        header[12..16].copy_from_slice(&ttl.to_be_bytes());
+        header[SOURCE_OFFSET..SOURCE_OFFSET + source.len()].copy_from_slice(source);
+        header[SINK_OFFSET..SINK_OFFSET + sink.len()].copy_from_slice(sink);
+        header
+    }
+
+    fn write_frame(&self, attributes: &UAttributes, umsg_serialized: &[u8]) -> Result<(), UStatus> {
+        let umsg_length = u32::try_from(umsg_serialized.len()).map_err(|_| {
+            UStatus::fail_with_code(UCode::INVALID_ARGUMENT, "uMessage is too large for a frame")
+        })?;
+        let source = Self::micro_uri(attributes.source.as_ref());
+        let sink = Self::micro_uri(attributes.sink.as_ref());
+        let header = self.frame_header(
+            umsg_length,
+            attributes.type_.value() as u8,
+            attributes.priority.value() as u8,
+            attributes.ttl.unwrap_or(0),
+            &source,
+            &sink,
+        );
+        if attributes.type_.enum_value_or_default() == UMessageType::UMESSAGE_TYPE_PUBLISH {
+            self.stats
+                .record_sent(&source, &attributes.source, umsg_serialized.len());
+        } else {
+            self.stats
+                .record_sent(&sink, &attributes.sink, umsg_serialized.len());
+        }
+        let mut frame = Vec::with_capacity(FRAME_HEADER_LENGTH + umsg_serialized.len());
+        frame.extend_from_slice(&header);
+        frame.extend_from_slice(umsg_serialized);
+        let urgent = attributes.priority.value() >= UPriority::UPRIORITY_CS5 as i32;
+        self.write_to_dispatcher(&frame, urgent)
+    }
+
+    /// Tells the Dispatcher to add or remove `topic` as a route to this connection
+    fn send_control(&self, control_type: u8, topic: &UUri) -> Result<(), UStatus> {
+        let header = self.frame_header(0, control_type, 0, 0, &[], &Self::micro_uri(Some(topic)));
+        self.write_to_dispatcher(&header, true)
+    }
+
+    fn lock_writer(&self) -> Result<std::sync::MutexGuard<'_, FrameWriter>, UStatus> {
+        self.writer.lock().map_err(|err| {
+            error!("Error acquiring lock: {}", err);
+            UStatus::fail_with_code(UCode::INTERNAL, "Issue in acquiring lock")
+        })
+    }
+
+    fn write_to_dispatcher(&self, frame: &[u8], urgent: bool) -> Result<(), UStatus> {
+        // Frames of uEntities sharing the connection must not interleave
+        let flush_delay = {
+            let mut writer = self.lock_writer()?;
+            let flush_delay = writer
+                .write_frame(frame, urgent)
+                .map_err(|err| dispatcher_error(&err))?;
+            self.stats.set_send_batch_bytes(writer.batched_bytes());
+            flush_delay
+        };
+
+        if let Some(flush_delay) = flush_delay {
+            let writer = self.writer.clone();
+            let stats = self.stats.clone();
+            task::spawn(async move {
+                tokio::time::sleep(flush_delay).await;
+                let result = match writer.lock() {
+                    Ok(mut writer) => {
+                        let result = writer.flush_delayed();
+                        stats.set_send_batch_bytes(writer.batched_bytes());
+                        result
+                    }
+                    Err(err) => {
+                        error!("Error acquiring lock: {}", err);
+                        return;
+                    }
+                };
+                if let Err(err) = result {
+                    error!("Error sending batched frames: {err:?}");
+                }
+            });
+        }
+        Ok(())
+    }
+
     fn socket_init(&mut self) -> Result<(), UStatus> {
         let socket_clone = match self.socket_sync.try_clone() {
             Ok(socket) => socket,
@@ -97,44 +375,98 @@ impl UTransportSocket {
 
         let listener_map_clone = self.listener_map.clone();
 
+        // The reader only uses its store to resolve the payloads received by reference, whether or
+        // not this transport sends any
+        let receive_payload_store = match SharedPayloadStore::new() {
+            Ok(payload_store) => Some(Arc::new(payload_store)),
+            Err(err) => {
+                error!("Shared payloads cannot be received: {err:?}");
+                None
+            }
+        };
         let mut self_copy = Self {
             socket_sync: socket_clone,
+            writer: self.writer.clone(),
             listener_map: listener_map_clone,
+            entity_id: self.entity_id,
+            payload_store: receive_payload_store,
+            stats: self.stats.clone(),
         };
-        task::spawn(async move { self_copy.dispatcher_listener().await });
+        // The socket reads block, so they get their own thread instead of a runtime worker; it
+        // enters the runtime so that listeners are still spawned onto it
+        let runtime = tokio::runtime::Handle::current();
+        thread::spawn(move || {
+            let _guard = runtime.enter();
+            self_copy.dispatcher_listener();
+        });
 
         Ok(())
     }
-    async fn dispatcher_listener(&mut self) {
+    fn dispatcher_listener(&mut self) {
         debug!("started listener for dispatcher");
         // Use `while let` to handle reads
 
-        let mut recv_data = [0; BYTES_MSG_LENGTH];
-
-        while let Ok(bytes_received) = self.socket_sync.read(&mut recv_data) {
-            // Check if no data is received
-            if bytes_received == 0 {
+        let mut frame_header = [0; FRAME_HEADER_LENGTH];
+        let mut recv_data = Vec::new();
+
+        while self.socket_sync.read_exact(&mut frame_header).is_ok() {
+            let umsg_length = u32::from_be_bytes([
+                frame_header[0],
+                frame_header[1],
+                frame_header[2],
+                frame_header[3],
+            ]) as usize;
+            recv_data.resize(umsg_length, 0);
+            if let Err(err) = self.socket_sync.read_exact(&mut recv_data) {
+                error!("Dispatcher closed the connection mid-frame: {}", err);
+                break;
+            }
+            // The frame body is read first, so that the next frame is still found after dropping this one
+            let source_length = usize::from(frame_header[10]);
+            let sink_length = usize::from(frame_header[11]);
+            if source_length > MICRO_URI_MAX_LENGTH || sink_length > MICRO_URI_MAX_LENGTH {
+                self.stats.record_parse_error();
+                error!(
+                    "Dropping frame with micro-URI lengths {source_length}/{sink_length} over {MICRO_URI_MAX_LENGTH}"
+                );
                 continue;
             }
 
-            let umessage_result = UMessage::parse_from_bytes(&recv_data[..bytes_received]);
-            let umessage = match umessage_result {
-                Ok(umsg) => umsg,
+            // Only the attributes are needed to find a consumer, the payload is decoded once one exists
+            let (attributes_data, payload_data) = match split_umessage(&recv_data) {
+                Ok(split) => split,
+                Err(err) => {
+                    self.stats.record_parse_error();
+                    error!("Failed to split message: {err:?}");
+                    continue;
+                }
+            };
+            let attributes = match UAttributes::parse_from_bytes(&attributes_data) {
+                Ok(attributes) => attributes,
                 Err(err) => {
-                    error!("Failed to parse message: {}", err);
+                    self.stats.record_parse_error();
+                    error!("Failed to parse message attributes: {}", err);
                     continue;
                 }
             };
+            if attributes.type_.enum_value_or_default() == UMessageType::UMESSAGE_TYPE_PUBLISH {
+                let source = &frame_header[SOURCE_OFFSET..SOURCE_OFFSET + source_length];
+                self.stats
+                    .record_received(source, &attributes.source, umsg_length);
+            } else {
+                let sink = &frame_header[SINK_OFFSET..SINK_OFFSET + sink_length];
+                self.stats
+                    .record_received(sink, &attributes.sink, umsg_length);
+            }
 
-            match umessage
-                .attributes
+            match attributes
                 .type_
                 .enum_value_or(UMessageType::UMESSAGE_TYPE_UNSPECIFIED)
             {
                 UMessageType::UMESSAGE_TYPE_PUBLISH => {
                     debug!("calling handle publish....");
                     if let Err(err) =
-                        self.check_all_listeners(&umessage.attributes.source.clone(), umessage)
+                        self.check_all_listeners(&attributes.source, &attributes, &payload_data)
                     {
                         error!("Error checking listeners: {err}");
                         continue;
@@ -147,7 +479,7 @@ impl UTransportSocket {
                 | UMessageType::UMESSAGE_TYPE_RESPONSE => debug!("Not implemented"),
                 UMessageType::UMESSAGE_TYPE_REQUEST => {
                     if let Err(err) =
-                        self.check_all_listeners(&umessage.attributes.sink.clone(), umessage)
+                        self.check_all_listeners(&attributes.sink, &attributes, &payload_data)
                     {
                         error!("Error checking listeners: {err}");
                         continue;
@@ -159,11 +491,18 @@ impl UTransportSocket {
         }
     }
 
+    /// Invokes the listeners registered for `uuri`; the payload is only decoded if there are any
+    ///
     /// # Errors
     ///
     /// Will return `Err` if no listeners registered for topic
-    pub fn check_all_listeners(&self, uuri: &UUri, umessage: UMessage) -> Result<(), UStatus> {
-        let mut topics_listeners = match self.listener_map.lock() {
+    pub fn check_all_listeners(
+        &self,
+        uuri: &UUri,
+        attributes: &UAttributes,
+        payload_data: &[u8],
+    ) -> Result<(), UStatus> {
+        let topics_listeners = match self.listener_map.lock() {
             Ok(lock) => lock,
             Err(err) => {
                 error!("Error acquiring lock: {}", err);
@@ -174,18 +513,15 @@ impl UTransportSocket {
             }
         };
 
-        let listeners = topics_listeners.entry(uuri.clone());
-
-        match listeners {
-            Entry::Vacant(_) => {
+        match topics_listeners.get(uuri) {
+            None => {
                 debug!("......vacant");
                 return Err(UStatus::fail_with_code(
                     UCode::NOT_FOUND,
                     format!("No listeners registered for topic: {:?}", &uuri),
                 ));
             }
-            Entry::Occupied(mut e) => {
-                let occupied = e.get_mut();
+            Some(occupied) => {
                 debug!("......occupied");
                 if occupied.is_empty() {
                     return Err(UStatus::fail_with_code(
@@ -193,7 +529,26 @@ impl UTransportSocket {
                         format!("No listeners registered for topic: {:?}", &uuri),
                     ));
                 }
+                let payload = if payload_data.is_empty() {
+                    MessageField::none()
+                } else {
+                    let mut payload = UPayload::parse_from_bytes(payload_data).map_err(|err| {
+                        self.stats.record_parse_error();
+                        UStatus::fail_with_code(
+                            UCode::INVALID_ARGUMENT,
+                            format!("Failed to parse message payload: {err}"),
+                        )
+                    })?;
+                    self.resolve_payload_reference(&mut payload);
+                    MessageField::some(payload)
+                };
+                let umessage = UMessage {
+                    attributes: MessageField::some(attributes.clone()),
+                    payload,
+                    ..Default::default()
+                };
                 debug!("invoking listner on receive..\n");
+                self.stats.record_listener_invocations(occupied.len());
                 for listener in occupied.iter() {
                     let task_listener = listener.clone();
                     let task_listener_error = listener.clone();
@@ -232,18 +587,7 @@ impl UTransport for UTransportSocket {
     ///
     /// Returns an error if the message could not be sent.
     async fn send(&self, message: UMessage) -> Result<(), UStatus> {
-        let mut socket_clone = match self.socket_sync.try_clone() {
-            Ok(socket) => socket,
-            Err(err) => {
-                error!("Error cloning socket: {}", err);
-
-                return Err(UStatus::fail_with_code(
-                    UCode::UNAVAILABLE,
-                    format!("socket_sync cloning issue: {err:?}"),
-                ));
-            }
-        };
-
+        let message = self.with_payload_reference(message)?;
         let umsg_serialized_result = message.clone().write_to_bytes();
         let umsg_serialized = match umsg_serialized_result {
             Ok(serialized) => serialized,
@@ -278,13 +622,7 @@ impl UTransport for UTransportSocket {
                         )
                     })?;
 
-                match socket_clone.write_all(&umsg_serialized) {
-                    Ok(()) => Ok(()),
-                    Err(err) => Err(UStatus::fail_with_code(
-                        UCode::UNAVAILABLE,
-                        format!("Dispatcher communication issue: {err:?}"),
-                    )),
-                }
+                self.write_frame(&attributes, &umsg_serialized)
             }
             UMessageType::UMESSAGE_TYPE_REQUEST => {
                 UAttributesValidators::Request
@@ -297,13 +635,7 @@ impl UTransport for UTransportSocket {
                         )
                     })?;
 
-                match socket_clone.write_all(&umsg_serialized) {
-                    Ok(()) => Ok(()),
-                    Err(err) => Err(UStatus::fail_with_code(
-                        UCode::UNAVAILABLE,
-                        format!("Dispatcher communication issue: {err:?}"),
-                    )),
-                }
+                self.write_frame(&attributes, &umsg_serialized)
             }
             UMessageType::UMESSAGE_TYPE_RESPONSE => {
                 UAttributesValidators::Response
@@ -315,13 +647,7 @@ impl UTransport for UTransportSocket {
                             format!("Wrong Response UAttributes {e:?}"),
                         )
                     })?;
-                match socket_clone.write_all(&umsg_serialized) {
-                    Ok(()) => Ok(()),
-                    Err(err) => Err(UStatus::fail_with_code(
-                        UCode::UNAVAILABLE,
-                        format!("Dispatcher communication issue: {err:?}"),
-                    )),
-                }
+                self.write_frame(&attributes, &umsg_serialized)
             }
             UMessageType::UMESSAGE_TYPE_NOTIFICATION => Err(UStatus::fail_with_code(
                 UCode::INTERNAL,
@@ -409,12 +735,13 @@ impl UTransport for UTransportSocket {
                 }
             };
 
-            let listeners = topics_listeners.entry(topic).or_default();
+            let listeners = topics_listeners.entry(topic.clone()).or_default();
             let identified_listener = ComparableListener::new(listener);
             let inserted = listeners.insert(identified_listener);
+            drop(topics_listeners);
             debug!("{inserted}");
             return if inserted {
-                Ok(())
+                self.send_control(CONTROL_LISTEN, &topic)
             } else {
                 Err(UStatus::fail_with_code(
                     UCode::ALREADY_EXISTS,
@@ -465,7 +792,7 @@ impl UTransport for UTransportSocket {
                 debug!("topic found Occupied");
                 debug!("{}", removed);
                 if removed {
-                    Ok(())
+                    self.send_control(CONTROL_UNLISTEN, &topic)
                 } else {
                     Err(UStatus::fail_with_code(
                         UCode::NOT_FOUND,
@@ -0,0 +1,250 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//! Payloads sent by reference through shared memory.
+//!
+//! A segment is a file named after its handle, `(pid << 32) | sequence number`, which travels in
+//! `UPayload.reference`. It starts with a 16 byte header (magic "UPSH", refcount as big-endian u32,
+//! payload length as big-endian u64) followed by the payload. The refcount is only changed under an
+//! fcntl record lock on the header, which the Python and Java transports take as well, and the
+//! segment is unlinked when the count drops to zero.
+
+use std::fs::{self, File, OpenOptions};
+use std::io::Write;
+use std::os::unix::fs::{FileExt, OpenOptionsExt};
+use std::os::unix::io::AsRawFd;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU32, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Duration;
+
+use log::error;
+use memmap2::{Mmap, MmapOptions};
+use up_rust::{UCode, UStatus};
+
+/// Payloads of at least this many bytes are sent by reference when a transport has a payload store
+pub const SHM_PAYLOAD_THRESHOLD: usize = 64 * 1024;
+/// How long the sender keeps its reference, receivers have this long to acquire their own
+pub const SHM_RETENTION: Duration = Duration::from_secs(10);
+
+const SEGMENT_MAGIC: &[u8; 4] = b"UPSH";
+const SEGMENT_HEADER_LENGTH: usize = 16;
+
+fn io_error(err: &std::io::Error) -> UStatus {
+    error!("Shared payload issue: {err}");
+    UStatus::fail_with_code(UCode::INTERNAL, format!("Shared payload issue: {err}"))
+}
+
+pub struct SharedPayloadStore {
+    directory: PathBuf,
+    sequence: AtomicU32,
+    // fcntl record locks do not exclude threads of one process, this lock does
+    lock: Mutex<()>,
+}
+
+/// A read-only mapping of a shared payload, holding one reference until dropped
+pub struct SharedPayload {
+    store: Arc<SharedPayloadStore>,
+    handle: u64,
+    mapping: Mmap,
+    length: usize,
+}
+
+impl SharedPayload {
+    pub fn data(&self) -> &[u8] {
+        &self.mapping[SEGMENT_HEADER_LENGTH..SEGMENT_HEADER_LENGTH + self.length]
+    }
+}
+
+impl Drop for SharedPayload {
+    fn drop(&mut self) {
+        if let Err(err) = self.store.release(self.handle) {
+            error!(
+                "Error releasing shared payload {:016x}: {err:?}",
+                self.handle
+            );
+        }
+    }
+}
+
+impl SharedPayloadStore {
+    /// # Errors
+    ///
+    /// Will return `Err` if the segment directory cannot be created
+    pub fn new() -> Result<Self, UStatus> {
+        // Segments live in tmpfs on Linux, so writing and mapping them never touches a disk
+        let directory = if Path::new("/dev/shm").is_dir() {
+            PathBuf::from("/dev/shm/uprotocol-tck")
+        } else {
+            std::env::temp_dir().join("uprotocol-tck")
+        };
+        fs::create_dir_all(&directory).map_err(|err| io_error(&err))?;
+
+        Ok(SharedPayloadStore {
+            directory,
+            sequence: AtomicU32::new(0),
+            lock: Mutex::new(()),
+        })
+    }
+
+    fn segment_path(&self, handle: u64) -> PathBuf {
+        self.directory.join(format!("{handle:016x}.payload"))
+    }
+
+    /// Writes data into a new segment holding the sender's reference and returns its handle
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the segment cannot be written
+    pub fn put(&self, data: &[u8]) -> Result<u64, UStatus> {
+        let sequence = self
+            .sequence
+            .fetch_add(1, Ordering::Relaxed)
+            .wrapping_add(1);
+        let handle = (u64::from(std::process::id()) << 32) | u64::from(sequence);
+
+        let mut header = [0; SEGMENT_HEADER_LENGTH];
+        header[..4].copy_from_slice(SEGMENT_MAGIC);
+        header[4..8].copy_from_slice(&1u32.to_be_bytes());
+        header[8..].copy_from_slice(&(data.len() as u64).to_be_bytes());
+
+        let mut file = OpenOptions::new()
+            .write(true)
+            .create_new(true)
+            .mode(0o644)
+            .open(self.segment_path(handle))
+            .map_err(|err| io_error(&err))?;
+        file.write_all(&header)
+            .and_then(|()| file.write_all(data))
+            .map_err(|err| io_error(&err))?;
+
+        Ok(handle)
+    }
+
+    /// Maps the segment of handle read-only and takes a reference on it
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the segment no longer exists or cannot be mapped
+    pub fn acquire(self: &Arc<Self>, handle: u64) -> Result<SharedPayload, UStatus> {
+        let file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .open(self.segment_path(handle))
+            .map_err(|err| io_error(&err))?;
+        let length = self.add_reference(&file, 1, None)?;
+
+        // SAFETY: the payload of a segment is never written after put, only its header changes
+        let mapping = unsafe {
+            MmapOptions::new()
+                .len(SEGMENT_HEADER_LENGTH + length)
+                .map(&file)
+        }
+        .map_err(|err| io_error(&err))?;
+
+        Ok(SharedPayload {
+            store: self.clone(),
+            handle,
+            mapping,
+            length,
+        })
+    }
+
+    /// Drops one reference on the segment of handle and unlinks it once none are left
+    ///
+    /// # Errors
+    ///
+    /// Will return `Err` if the segment header cannot be updated
+    pub fn release(&self, handle: u64) -> Result<(), UStatus> {
+        let Ok(file) = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .open(self.segment_path(handle))
+        else {
+            return Ok(());
+        };
+        self.add_reference(&file, -1, Some(handle)).map(|_| ())
+    }
+
+    fn add_reference(
+        &self,
+        file: &File,
+        delta: i64,
+        unlink_handle: Option<u64>,
+    ) -> Result<usize, UStatus> {
+        let _guard = self
+            .lock
+            .lock()
+            .map_err(|_| UStatus::fail_with_code(UCode::INTERNAL, "Issue in acquiring lock"))?;
+
+        lock_header(file, libc::F_WRLCK)?;
+        let result = self.update_refcount(file, delta, unlink_handle);
+        lock_header(file, libc::F_UNLCK)?;
+        result
+    }
+
+    fn update_refcount(
+        &self,
+        file: &File,
+        delta: i64,
+        unlink_handle: Option<u64>,
+    ) -> Result<usize, UStatus> {
+        let mut header = [0; SEGMENT_HEADER_LENGTH];
+        file.read_exact_at(&mut header, 0)
+            .map_err(|err| io_error(&err))?;
+        let refcount = u32::from_be_bytes([header[4], header[5], header[6], header[7]]);
+        if &header[..4] != SEGMENT_MAGIC || refcount == 0 {
+            return Err(UStatus::fail_with_code(
+                UCode::NOT_FOUND,
+                "Shared payload is no longer available",
+            ));
+        }
+
+        let refcount = u32::try_from(i64::from(refcount) + delta).unwrap_or(0);
+        file.write_all_at(&refcount.to_be_bytes(), 4)
+            .map_err(|err| io_error(&err))?;
+        if refcount == 0 {
+            if let Some(handle) = unlink_handle {
+                fs::remove_file(self.segment_path(handle)).map_err(|err| io_error(&err))?;
+            }
+        }
+
+        let mut length = [0; 8];
+        length.copy_from_slice(&header[8..]);
+        usize::try_from(u64::from_be_bytes(length))
+            .map_err(|_| UStatus::fail_with_code(UCode::INTERNAL, "Shared payload is too large"))
+    }
+}
+
+fn lock_header(file: &File, lock_type: libc::c_int) -> Result<(), UStatus> {
+    // SAFETY: flock is plain old data, all-zero is a valid value
+    let mut lock: libc::flock = unsafe { std::mem::zeroed() };
+    lock.l_type = lock_type as libc::c_short;
+    lock.l_whence = libc::SEEK_SET as libc::c_short;
+    lock.l_start = 0;
+    lock.l_len = SEGMENT_HEADER_LENGTH as libc::off_t;
+
+    // SAFETY: the descriptor is open for the lifetime of file and lock outlives the call
+    if unsafe { libc::fcntl(file.as_raw_fd(), libc::F_SETLKW, &lock) } == -1 {
+        return Err(io_error(&std::io::Error::last_os_error()));
+    }
+    Ok(())
+}
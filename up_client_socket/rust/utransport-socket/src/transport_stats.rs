@@ -0,0 +1,219 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//! Counters of what a Dispatcher connection has done: messages and bytes sent and received per
+//! topic, received frames that could not be parsed and listener invocations.
+//!
+//! Topics are counted by the micro-URI form of the routing header, which every frame carries
+//! anyway, and only named by their long form when a snapshot is taken.
+
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::Mutex;
+
+use serde::Serialize;
+use up_rust::{LongUriSerializer, UUri, UriSerializer};
+
+#[derive(Clone, Copy, Default, Serialize)]
+pub struct TopicStats {
+    pub messages: u64,
+    pub bytes: u64,
+}
+
+#[derive(Default, Serialize)]
+pub struct DirectionStats {
+    pub messages: u64,
+    pub bytes: u64,
+    pub topics: HashMap<String, TopicStats>,
+}
+
+impl DirectionStats {
+    fn merge(&mut self, other: DirectionStats) {
+        self.messages += other.messages;
+        self.bytes += other.bytes;
+        for (topic, stats) in other.topics {
+            let merged = self.topics.entry(topic).or_default();
+            merged.messages += stats.messages;
+            merged.bytes += stats.bytes;
+        }
+    }
+}
+
+/// What one or more Dispatcher connections have done so far, as answered to "`get_stats`"
+#[derive(Default, Serialize)]
+pub struct StatsSnapshot {
+    pub sent: DirectionStats,
+    pub received: DirectionStats,
+    pub parse_errors: u64,
+    pub listener_invocations: u64,
+    // The socket transport does not implement RPC, so no request is pending or times out
+    pub rpc_timeouts: u64,
+    pub pending_rpc: u64,
+    pub queue_depths: HashMap<String, u64>,
+}
+
+impl StatsSnapshot {
+    /// Adds the counters of another connection
+    pub fn merge(&mut self, other: StatsSnapshot) {
+        self.sent.merge(other.sent);
+        self.received.merge(other.received);
+        self.parse_errors += other.parse_errors;
+        self.listener_invocations += other.listener_invocations;
+        self.rpc_timeouts += other.rpc_timeouts;
+        self.pending_rpc += other.pending_rpc;
+        for (queue, depth) in other.queue_depths {
+            *self.queue_depths.entry(queue).or_default() += depth;
+        }
+    }
+}
+
+#[derive(Default)]
+struct TopicCounters {
+    // Routing form of the topic -> topic, messages, bytes
+    topics: HashMap<Vec<u8>, (UUri, TopicStats)>,
+    total: TopicStats,
+}
+
+impl TopicCounters {
+    fn add(&mut self, key: &[u8], topic: &UUri, length: usize) {
+        let length = length as u64;
+        // Topics without a micro-URI form share the empty key, the first of them names it
+        let (_, stats) = self
+            .topics
+            .entry(key.to_vec())
+            .or_insert_with(|| (topic.clone(), TopicStats::default()));
+        stats.messages += 1;
+        stats.bytes += length;
+        self.total.messages += 1;
+        self.total.bytes += length;
+    }
+
+    fn snapshot(&self) -> DirectionStats {
+        let mut direction = DirectionStats {
+            messages: self.total.messages,
+            bytes: self.total.bytes,
+            topics: HashMap::new(),
+        };
+        for (topic, stats) in self.topics.values() {
+            let name = LongUriSerializer::serialize(topic).unwrap_or_default();
+            let merged = direction.topics.entry(name).or_default();
+            merged.messages += stats.messages;
+            merged.bytes += stats.bytes;
+        }
+        direction
+    }
+}
+
+#[derive(Default)]
+pub struct TransportStats {
+    sent: Mutex<TopicCounters>,
+    received: Mutex<TopicCounters>,
+    parse_errors: AtomicU64,
+    listener_invocations: AtomicU64,
+    send_batch_bytes: AtomicUsize,
+}
+
+impl TransportStats {
+    pub(crate) fn record_sent(&self, key: &[u8], topic: &UUri, length: usize) {
+        if let Ok(mut sent) = self.sent.lock() {
+            sent.add(key, topic, length);
+        }
+    }
+
+    pub(crate) fn record_received(&self, key: &[u8], topic: &UUri, length: usize) {
+        if let Ok(mut received) = self.received.lock() {
+            received.add(key, topic, length);
+        }
+    }
+
+    pub(crate) fn record_parse_error(&self) {
+        self.parse_errors.fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub(crate) fn record_listener_invocations(&self, count: usize) {
+        self.listener_invocations
+            .fetch_add(count as u64, Ordering::Relaxed);
+    }
+
+    pub(crate) fn set_send_batch_bytes(&self, bytes: usize) {
+        self.send_batch_bytes.store(bytes, Ordering::Relaxed);
+    }
+
+    #[must_use]
+    pub fn snapshot(&self) -> StatsSnapshot {
+        StatsSnapshot {
+            sent: self
+                .sent
+                .lock()
+                .map(|sent| sent.snapshot())
+                .unwrap_or_default(),
+            received: self
+                .received
+                .lock()
+                .map(|received| received.snapshot())
+                .unwrap_or_default(),
+            parse_errors: self.parse_errors.load(Ordering::Relaxed),
+            listener_invocations: self.listener_invocations.load(Ordering::Relaxed),
+            rpc_timeouts: 0,
+            pending_rpc: 0,
+            queue_depths: HashMap::from([(
+                "send_batch_bytes".to_string(),
+                self.send_batch_bytes.load(Ordering::Relaxed) as u64,
+            )]),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{StatsSnapshot, TransportStats};
+    use protobuf::MessageField;
+    use up_rust::{UEntity, UUri};
+
+    fn topic(name: &str) -> UUri {
+        UUri {
+            entity: MessageField::some(UEntity {
+                name: name.to_string(),
+                ..Default::default()
+            }),
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn counts_per_topic_and_merges_connections() {
+        let stats = TransportStats::default();
+        stats.record_sent(&[1], &topic("door"), 10);
+        stats.record_sent(&[1], &topic("door"), 20);
+        stats.record_sent(&[2], &topic("window"), 5);
+        stats.record_parse_error();
+
+        let mut snapshot = StatsSnapshot::default();
+        snapshot.merge(stats.snapshot());
+        snapshot.merge(stats.snapshot());
+
+        assert_eq!(snapshot.sent.messages, 6);
+        assert_eq!(snapshot.sent.bytes, 70);
+        assert_eq!(snapshot.sent.topics.len(), 2);
+        assert_eq!(snapshot.received.messages, 0);
+        assert_eq!(snapshot.parse_errors, 2);
+    }
+}
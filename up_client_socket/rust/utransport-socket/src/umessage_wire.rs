@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http: *www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * SPDX-FileType: SOURCE
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//! Splits a serialized `UMessage` into its attributes and payload without decoding either,
+//! so that the payload is only decoded for messages that have a consumer.
+
+use std::borrow::Cow;
+
+use up_rust::{UCode, UStatus};
+
+// Field numbers of UMessage
+const UMESSAGE_ATTRIBUTES_FIELD: u64 = 1;
+const UMESSAGE_PAYLOAD_FIELD: u64 = 2;
+
+fn malformed() -> UStatus {
+    UStatus::fail_with_code(UCode::INVALID_ARGUMENT, "Malformed UMessage")
+}
+
+fn read_varint(data: &[u8], pos: &mut usize) -> Result<u64, UStatus> {
+    let mut result = 0;
+    for shift in (0..64).step_by(7) {
+        let byte = *data.get(*pos).ok_or_else(malformed)?;
+        *pos += 1;
+        result |= u64::from(byte & 0x7F) << shift;
+        if byte & 0x80 == 0 {
+            return Ok(result);
+        }
+    }
+    Err(malformed())
+}
+
+fn join<'a>(parts: &[&'a [u8]]) -> Cow<'a, [u8]> {
+    match parts {
+        [] => Cow::Borrowed(&[]),
+        [part] => Cow::Borrowed(part),
+        _ => Cow::Owned(parts.concat()),
+    }
+}
+
+/// Returns the serialized attributes and payload of a serialized `UMessage`.
+/// Occurrences of a field repeated on the wire are concatenated, which protobuf defines as merging them.
+///
+/// # Errors
+///
+/// Will return `Err` if data is not a well-formed protobuf message
+pub fn split_umessage(data: &[u8]) -> Result<(Cow<[u8]>, Cow<[u8]>), UStatus> {
+    let mut attributes = Vec::with_capacity(1);
+    let mut payload = Vec::with_capacity(1);
+    let mut pos = 0;
+    while pos < data.len() {
+        let tag = read_varint(data, &mut pos)?;
+        match tag & 0x7 {
+            0 => {
+                read_varint(data, &mut pos)?;
+            }
+            1 => pos += 8,
+            2 => {
+                let length =
+                    usize::try_from(read_varint(data, &mut pos)?).map_err(|_| malformed())?;
+                let end = pos
+                    .checked_add(length)
+                    .filter(|end| *end <= data.len())
+                    .ok_or_else(malformed)?;
+                match tag >> 3 {
+                    UMESSAGE_ATTRIBUTES_FIELD => attributes.push(&data[pos..end]),
+                    UMESSAGE_PAYLOAD_FIELD => payload.push(&data[pos..end]),
+                    _ => {}
+                }
+                pos = end;
+            }
+            5 => pos += 4,
+            _ => return Err(malformed()),
+        }
+    }
+    if pos > data.len() {
+        return Err(malformed());
+    }
+
+    Ok((join(&attributes), join(&payload)))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::split_umessage;
+
+    #[test]
+    fn test_split_umessage() {
+        let payload = vec![b'x'; 300];
+        let mut data = vec![0x0a, 0x02, 0x08, 0x01];
+        data.extend_from_slice(&[0x18, 0x96, 0x01]);
+        data.extend_from_slice(&[0x12, 0xac, 0x02]);
+        data.extend_from_slice(&payload);
+        data.extend_from_slice(&[0x0a, 0x02, 0x10, 0x05]);
+
+        let (attributes, split_payload) = split_umessage(&data).unwrap();
+        assert_eq!(&*attributes, &[0x08, 0x01, 0x10, 0x05]);
+        assert_eq!(&*split_payload, payload.as_slice());
+        assert!(split_umessage(&[0x12, 0x05, 0x00]).is_err());
+    }
+}